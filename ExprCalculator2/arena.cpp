@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "arena.h"
+
+Arena::Arena(size_t initial_chunk_size) : next_chunk_size(initial_chunk_size) {}
+
+Arena::~Arena() {
+    release();
+}
+
+Arena::Arena(Arena&& other) noexcept
+    : head(std::exchange(other.head, nullptr)),
+      cur(std::exchange(other.cur, nullptr)),
+      end(std::exchange(other.end, nullptr)),
+      next_chunk_size(other.next_chunk_size),
+      used(std::exchange(other.used, 0)),
+      reserved(std::exchange(other.reserved, 0)) {}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+    if (this != &other) {
+        release();
+        head = std::exchange(other.head, nullptr);
+        cur = std::exchange(other.cur, nullptr);
+        end = std::exchange(other.end, nullptr);
+        next_chunk_size = other.next_chunk_size;
+        used = std::exchange(other.used, 0);
+        reserved = std::exchange(other.reserved, 0);
+    }
+    return *this;
+}
+
+void Arena::release() {
+    // 只释放内存块，节点本身无需析构
+    while (head) {
+        Chunk* next = head->next;
+        ::operator delete(head);
+        head = next;
+    }
+    cur = end = nullptr;
+}
+
+void* Arena::allocateSlow(size_t size, size_t align) {
+    // 块按几何级数增长，超大的请求单独占一块
+    size_t header = (sizeof(Chunk) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+    size_t need = size + align;
+    size_t chunk_size = std::max(next_chunk_size, need);
+    next_chunk_size = std::min(next_chunk_size * 2, MAX_CHUNK_SIZE);
+
+    auto* chunk = static_cast<Chunk*>(::operator new(header + chunk_size));
+    chunk->next = head;
+    chunk->size = chunk_size;
+    head = chunk;
+    reserved += chunk_size;
+
+    cur = reinterpret_cast<char*>(chunk) + header;
+    end = cur + chunk_size;
+    return allocate(size, align);
+}
+
+std::string_view Arena::copy(std::string_view s) {
+    if (s.empty()) return {};
+    char* out = static_cast<char*>(allocate(s.size(), 1));
+    std::copy(s.begin(), s.end(), out);
+    return { out, s.size() };
+}
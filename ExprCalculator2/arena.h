@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// 单调（bump）分配器：AST 节点从这里分配，整棵树随 Arena 一次性释放。
+// 不会调用对象的析构函数，因此只能存放平凡可析构的类型。
+class Arena {
+    struct Chunk {
+        Chunk* next;
+        size_t size;
+    };
+
+    Chunk* head = nullptr;
+    char* cur = nullptr;
+    char* end = nullptr;
+    size_t next_chunk_size;
+    size_t used = 0;
+    size_t reserved = 0;
+
+    void* allocateSlow(size_t size, size_t align);
+    void release();
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 1024;
+    static constexpr size_t MAX_CHUNK_SIZE = 1 << 20;
+
+    explicit Arena(size_t initial_chunk_size = DEFAULT_CHUNK_SIZE);
+    ~Arena();
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align) {
+        size_t pad = (align - reinterpret_cast<uintptr_t>(cur) % align) % align;
+        if (cur && size + pad <= static_cast<size_t>(end - cur)) {
+            void* p = cur + pad;
+            cur += pad + size;
+            used += size;
+            return p;
+        }
+        return allocateSlow(size, align);
+    }
+
+    template <class T, class... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena never runs destructors");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // 复制一段连续元素到 Arena 中
+    template <class T>
+    std::span<const T> copy(std::span<const T> items) {
+        static_assert(std::is_trivially_copyable_v<T>, "Arena arrays must be trivially copyable");
+        if (items.empty()) return {};
+        T* out = static_cast<T*>(allocate(sizeof(T) * items.size(), alignof(T)));
+        for (size_t i = 0; i < items.size(); ++i) new (out + i) T(items[i]);
+        return { out, items.size() };
+    }
+
+    std::string_view copy(std::string_view s);
+
+    size_t bytes_used() const { return used; }
+    size_t bytes_reserved() const { return reserved; }
+};
@@ -1,27 +1,55 @@
 #include "evaluator.h" // 节点递归运算需要
 #include "assign_expr.h"
+#include "compiled_expr.h"
+#include "printer.h"
+#include "operators.h"
+#include "expr_dag.h"
+#include "differentiator.h"
 
 // 赋值表达式
-AssignExpr::AssignExpr(std::string name, std::unique_ptr<Expr> val)
-        : var_name(std::move(name)), value(std::move(val)) {
+AssignExpr::AssignExpr(std::string_view name, const Expr* val)
+        : var_name(name), value(val) {
     }
 
-std::string AssignExpr::to_string() const {
-    return var_name + " = " + value->to_string();
+void AssignExpr::print(Printer& p) const {
+    bool opened = p.open(operators::precedence(TokenType::ASSIGN));
+    p.text(var_name);
+    p.binary_op(TokenType::ASSIGN);
+    p.operand(value, 0);
+    p.close(opened);
 }
 
 
-Value AssignExpr::evaluate(Evaluator& eval) const {
-    Value val = value->evaluate(eval);
-    if (val.is_symbol()) {
-        throw std::runtime_error("Cannot assign undefined variable");
+EvalResult AssignExpr::try_evaluate(Evaluator& eval) const {
+    EvalResult val = value->try_evaluate(eval);
+    if (!val) return val;
+    if (val->is_symbol()) {
+        return EvalError{ EvalErrc::UNDEFINED_VARIABLE, this };
     }
-    eval.setVariable(var_name, val.num);
+    eval.setVariable(var_name, val->num);
     return val;
 }
 
 
-std::unique_ptr<Expr> AssignExpr::simplify() const {
-    auto new_value = value->simplify();
-    return std::make_unique<AssignExpr>(var_name, std::move(new_value));
-}
\ No newline at end of file
+const Expr* AssignExpr::simplify(ExprDag& dag) const {
+    const Expr* new_value = dag.simplify(value);
+    return dag.assign(var_name, new_value, new_value == value ? this : nullptr);
+}
+
+
+void AssignExpr::compile(Compiler& c) const {
+    c.operand(value);
+    c.emit(OpCode::STORE, c.slot(var_name));
+}
+
+
+const Expr* AssignExpr::share(ExprDag& dag) const {
+    return dag.assign(var_name, value->share(dag));
+}
+
+
+const Expr* AssignExpr::derive(Differentiator& d) const {
+    // 赋值的值就是右侧的值
+    d.note_assign(var_name);
+    return d.derive(value);
+}
@@ -1,14 +1,20 @@
 #pragma once
 
+#include <string_view>
+
 #include "expr.h"
 
 // 赋值表达式
-class AssignExpr : public Expr {
-    std::string var_name;
-    std::unique_ptr<Expr> value;
+class AssignExpr final : public Expr {
+    std::string_view var_name;
+    const Expr* value;
+    friend class ExprDag;
 public:
-    AssignExpr(std::string name, std::unique_ptr<Expr> val);
-    Value evaluate(Evaluator& eval) const override;
-    std::unique_ptr<Expr> simplify() const override;
-    std::string to_string() const override;
+    AssignExpr(std::string_view name, const Expr* val);
+    EvalResult try_evaluate(Evaluator& eval) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
 };
\ No newline at end of file
@@ -0,0 +1,447 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "evaluator.h"
+#include "batch_eval.h"
+#include "operators.h"
+#include "user_function.h"
+
+namespace {
+
+// 每块的行数：一个栈位置占 4 KiB，整个工作集留在 L1/L2 中
+constexpr size_t CHUNK = 512;
+constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+
+// GCC/Clang 在 x86 上为每个内核生成 AVX-512 / AVX2 / 通用三个版本，运行时按 CPU 选择。
+// 选择用的 ifunc 解析函数在 ThreadSanitizer 初始化之前运行，TSan 构建启动时就会崩溃，因此只保留通用版本
+#if defined(__SANITIZE_THREAD__)
+#define BATCH_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define BATCH_TSAN 1
+#endif
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(BATCH_TSAN)
+#define BATCH_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define BATCH_KERNEL
+#endif
+
+// 逐元素二元运算，语义与 operators.h 相同
+#define BINARY_KERNEL(name, expr)                                                    \
+    BATCH_KERNEL void name(double* out, const double* a, const double* b, size_t n) { \
+        for (size_t i = 0; i < n; ++i) {                                             \
+            double l = a[i], r = b[i];                                               \
+            out[i] = (expr);                                                         \
+        }                                                                            \
+    }
+
+BINARY_KERNEL(k_add, l + r)
+BINARY_KERNEL(k_sub, l - r)
+BINARY_KERNEL(k_mul, l * r)
+BINARY_KERNEL(k_gt, operators::gt(l, r))
+BINARY_KERNEL(k_lt, operators::lt(l, r))
+BINARY_KERNEL(k_ge, operators::ge(l, r))
+BINARY_KERNEL(k_le, operators::le(l, r))
+BINARY_KERNEL(k_eq, operators::eq(l, r))
+BINARY_KERNEL(k_ne, operators::ne(l, r))
+BINARY_KERNEL(k_and, operators::logical_and(l, r))
+BINARY_KERNEL(k_or, operators::logical_or(l, r))
+
+#undef BINARY_KERNEL
+
+// 除数过小的行在 err 中记错误（按位或），结果值随后会被屏蔽为 NaN
+BATCH_KERNEL void k_div(double* out, uint8_t* err, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        double r = b[i];
+        err[i] |= uint8_t(std::abs(r) < operators::EPS) * BATCH_DIVISION_BY_ZERO;
+        out[i] = a[i] / r;
+    }
+}
+
+// fmod / pow 没有向量版本，逐元素调用 libm
+void k_mod(double* out, uint8_t* err, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        double r = b[i];
+        err[i] |= uint8_t(std::abs(r) < operators::EPS) * BATCH_MODULO_BY_ZERO;
+        out[i] = std::fmod(a[i], r);
+    }
+}
+
+void k_pow(double* out, const double* a, const double* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = std::pow(a[i], b[i]);
+}
+
+BATCH_KERNEL void k_neg(double* out, const double* a, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = -a[i];
+}
+
+BATCH_KERNEL void k_not(double* out, const double* a, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = operators::logical_not(a[i]);
+}
+
+BATCH_KERNEL void k_truthy(uint8_t* mask, const double* c, size_t n) {
+    for (size_t i = 0; i < n; ++i) mask[i] = operators::truthy(c[i]) ? 1 : 0;
+}
+
+BATCH_KERNEL void k_blend(double* out, const uint8_t* mask, const double* t, const double* f, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = mask[i] ? t[i] : f[i];
+}
+
+BATCH_KERNEL void k_or_err(uint8_t* out, const uint8_t* a, const uint8_t* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = a[i] | b[i];
+}
+
+// 一个栈位置在当前块上的值
+struct Column {
+    const double* vals = nullptr;  // 当前值（可能直接指向输入列）
+    double* buf = nullptr;         // 该位置专用的暂存区
+    uint8_t* err = nullptr;        // 该位置专用的错误标志
+    bool has_err = false;          // 为 false 时 err 内容无意义
+    const Function* fn = nullptr;  // FUNC 压入的函数
+};
+
+// 条件表达式：条件掩码以及真分支结束后跳转到的位置
+struct Branch {
+    uint8_t* mask = nullptr;
+    uint8_t* cond_err = nullptr;
+    bool cond_has_err = false;
+    uint32_t end = UINT32_MAX;
+};
+
+} // namespace
+
+class BatchRunner {
+    const CompiledExpr& expr;
+    Evaluator& eval;
+    std::vector<const double*> own_inputs;
+    const std::vector<const double*>* slot_inputs; // 变量槽 → 输入列（没有则为 nullptr），函数体与外层共用
+    // 用户函数：按调用点下标保存函数体的执行器，参数列由调用处给出
+    std::vector<std::unique_ptr<BatchRunner>> nested;
+    std::vector<const double*> params;
+
+    std::vector<double> value_store;
+    std::vector<uint8_t> error_store;
+    std::vector<uint8_t> branch_store;
+    std::vector<Column> columns;
+    std::vector<Column> temps; // 共享子表达式的结果
+    std::vector<Branch> branches;
+    std::vector<double> row; // 可变参数函数一行的参数
+
+    size_t base = 0; // 当前块的起始行
+    size_t n = 0;    // 当前块的行数
+
+    void fill(Column& c, double v) {
+        std::fill_n(c.buf, n, v);
+        c.vals = c.buf;
+    }
+
+    void fail(Column& c, uint8_t code) {
+        fill(c, NaN);
+        std::fill_n(c.err, n, code);
+        c.has_err = true;
+        c.fn = nullptr;
+    }
+
+    // 把 b 的错误合并到 a（a 为结果所在的位置）；may_fail 表示运算本身还会写入新的错误
+    void mergeErrors(Column& a, const Column& b, bool may_fail) {
+        if (a.has_err && b.has_err) k_or_err(a.err, a.err, b.err, n);
+        else if (b.has_err) std::memcpy(a.err, b.err, n);
+        else if (!a.has_err && may_fail) std::memset(a.err, 0, n);
+        a.has_err = a.has_err || b.has_err || may_fail;
+    }
+
+    void blend(Column*& sp, Branch& br) {
+        Column& f = *--sp;
+        Column& t = sp[-1];
+        k_blend(t.buf, br.mask, t.vals, f.vals, n);
+        t.vals = t.buf;
+        if (t.has_err || f.has_err || br.cond_has_err) {
+            if (!t.has_err) std::memset(t.err, 0, n);
+            const uint8_t* fe = f.err;
+            if (!f.has_err) { std::memset(f.err, 0, n); }
+            for (size_t i = 0; i < n; ++i) {
+                uint8_t e = br.mask[i] ? t.err[i] : fe[i];
+                t.err[i] = e | (br.cond_has_err ? br.cond_err[i] : uint8_t(BATCH_OK));
+            }
+            t.has_err = true;
+        }
+    }
+
+    void prepare(std::vector<const UserFunction*>& active);
+    // 在当前块上执行字节码，结果在 columns[0]
+    const Column& execute();
+    void runChunk(double* out, uint8_t* errors, BatchStats& stats);
+public:
+    BatchRunner(const CompiledExpr& e, Evaluator& ev, std::span<const BatchColumn> inputs, size_t rows);
+    // 用户函数体：与 parent 共用输入列；active 为正在展开的函数，用来拒绝递归
+    BatchRunner(const CompiledExpr& body, Evaluator& ev, const BatchRunner& parent,
+        std::vector<const UserFunction*>& active);
+    // 求值 [first, first + out.size()) 行
+    BatchStats run(size_t first, std::span<double> out, std::span<uint8_t> errors);
+};
+
+BatchRunner::BatchRunner(const CompiledExpr& e, Evaluator& ev, std::span<const BatchColumn> inputs, size_t rows)
+    : expr(e), eval(ev), slot_inputs(&own_inputs) {
+    for (const auto& col : inputs) {
+        if (col.values.size() != rows)
+            throw std::invalid_argument("eval_batch: column '" + std::string(col.name) + "' has the wrong length");
+        VarSlot slot = eval.bind(col.name);
+        if (slot.index >= own_inputs.size()) own_inputs.resize(slot.index + 1, nullptr);
+        own_inputs[slot.index] = col.values.data();
+    }
+    own_inputs.resize(std::max(own_inputs.size(), eval.slot_count()), nullptr);
+    std::vector<const UserFunction*> active;
+    prepare(active);
+}
+
+BatchRunner::BatchRunner(const CompiledExpr& body, Evaluator& ev, const BatchRunner& parent,
+    std::vector<const UserFunction*>& active)
+    : expr(body), eval(ev), slot_inputs(parent.slot_inputs) {
+    prepare(active);
+}
+
+void BatchRunner::prepare(std::vector<const UserFunction*>& active) {
+    size_t branch_count = 0;
+    for (const Instr& in : expr.instructions()) {
+        if (in.op == OpCode::STORE) throw std::invalid_argument("eval_batch does not support assignments");
+        if (in.op == OpCode::JUMP_IF_FALSE) ++branch_count;
+        if (in.op == OpCode::LOAD_PARAM && in.arg >= params.size()) params.resize(in.arg + 1, nullptr);
+        if (in.op != OpCode::FUNC) continue;
+        const Function* fn = eval.functions.find(expr.name(in.arg));
+        if (!fn || fn->kind != Function::Kind::USER || !fn->accepts(expr.argc(in.arg))) continue;
+        if (in.arg < nested.size() && nested[in.arg]) continue;
+        // 条件表达式的两个分支都要计算，递归函数无法终止
+        if (std::find(active.begin(), active.end(), fn->user.get()) != active.end())
+            throw std::invalid_argument("eval_batch does not support recursive function " + fn->name);
+        if (in.arg >= nested.size()) nested.resize(in.arg + 1);
+        active.push_back(fn->user.get());
+        nested[in.arg] = std::make_unique<BatchRunner>(fn->user->bytecode(), eval, *this, active);
+        nested[in.arg]->params.resize(fn->min_args, nullptr); // 用不到的参数也要有位置
+        active.pop_back();
+    }
+
+    // 条件表达式的假分支从真分支结果之上开始压栈，因此每层嵌套多占一个位置
+    size_t positions = expr.stack_depth() + branch_count;
+    value_store.resize((positions + expr.temp_count()) * CHUNK);
+    error_store.resize((positions + expr.temp_count()) * CHUNK);
+    branch_store.resize(branch_count * 2 * CHUNK);
+    columns.resize(positions);
+    temps.resize(expr.temp_count());
+    for (size_t i = 0; i < positions + temps.size(); ++i) {
+        Column& c = i < positions ? columns[i] : temps[i - positions];
+        c.buf = value_store.data() + i * CHUNK;
+        c.err = error_store.data() + i * CHUNK;
+    }
+    branches.resize(branch_count);
+    for (size_t i = 0; i < branch_count; ++i) {
+        branches[i].mask = branch_store.data() + 2 * i * CHUNK;
+        branches[i].cond_err = branches[i].mask + CHUNK;
+    }
+}
+
+const Column& BatchRunner::execute() {
+    auto code = expr.instructions();
+    Column* sp = columns.data();
+    size_t depth = 0; // 当前嵌套的条件表达式层数
+
+    for (size_t pc = 0; pc <= code.size(); ++pc) {
+        while (depth > 0 && branches[depth - 1].end == pc) blend(sp, branches[--depth]);
+        if (pc == code.size()) break;
+
+        const Instr& in = code[pc];
+        switch (in.op) {
+        case OpCode::PUSH_CONST: {
+            Column& c = *sp++;
+            fill(c, expr.constant(in.arg));
+            c.has_err = false;
+            c.fn = nullptr;
+            break;
+        }
+        case OpCode::LOAD_VAR: {
+            Column& c = *sp++;
+            c.has_err = false;
+            c.fn = nullptr;
+            VarSlot slot{ in.arg };
+            if (const double* input = (*slot_inputs)[in.arg]) c.vals = input + base;
+            else if (eval.is_defined(slot)) fill(c, eval.get(slot));
+            else fail(c, BATCH_UNDEFINED_VARIABLE);
+            break;
+        }
+        case OpCode::LOAD_PARAM: {
+            Column& c = *sp++;
+            c.vals = params[in.arg]; // 只读引用调用处的参数列
+            c.has_err = false;
+            c.fn = nullptr;
+            break;
+        }
+        case OpCode::ADD: case OpCode::SUB: case OpCode::MUL: case OpCode::DIV: case OpCode::MOD: case OpCode::POW:
+        case OpCode::GT: case OpCode::LT: case OpCode::GE: case OpCode::LE: case OpCode::EQ: case OpCode::NE:
+        case OpCode::AND: case OpCode::OR: case OpCode::BINARY: {
+            Column& b = *--sp;
+            Column& a = sp[-1];
+            bool may_fail = in.op == OpCode::DIV || in.op == OpCode::MOD;
+            mergeErrors(a, b, may_fail);
+            double* r = a.buf;
+            switch (in.op) {
+            case OpCode::ADD: k_add(r, a.vals, b.vals, n); break;
+            case OpCode::SUB: k_sub(r, a.vals, b.vals, n); break;
+            case OpCode::MUL: k_mul(r, a.vals, b.vals, n); break;
+            case OpCode::DIV: k_div(r, a.err, a.vals, b.vals, n); break;
+            case OpCode::MOD: k_mod(r, a.err, a.vals, b.vals, n); break;
+            case OpCode::POW: k_pow(r, a.vals, b.vals, n); break;
+            case OpCode::GT: k_gt(r, a.vals, b.vals, n); break;
+            case OpCode::LT: k_lt(r, a.vals, b.vals, n); break;
+            case OpCode::GE: k_ge(r, a.vals, b.vals, n); break;
+            case OpCode::LE: k_le(r, a.vals, b.vals, n); break;
+            case OpCode::EQ: k_eq(r, a.vals, b.vals, n); break;
+            case OpCode::NE: k_ne(r, a.vals, b.vals, n); break;
+            case OpCode::AND: k_and(r, a.vals, b.vals, n); break;
+            case OpCode::OR: k_or(r, a.vals, b.vals, n); break;
+            default: fail(a, BATCH_UNHANDLED_OPERATOR); break;
+            }
+            a.vals = a.buf;
+            break;
+        }
+        case OpCode::NEG:
+        case OpCode::NOT: {
+            Column& a = sp[-1];
+            if (in.op == OpCode::NEG) k_neg(a.buf, a.vals, n);
+            else k_not(a.buf, a.vals, n);
+            a.vals = a.buf;
+            break;
+        }
+        case OpCode::JUMP_IF_FALSE: {
+            Column& c = *--sp;
+            Branch& br = branches[depth++];
+            k_truthy(br.mask, c.vals, n);
+            br.cond_has_err = c.has_err;
+            if (c.has_err) std::memcpy(br.cond_err, c.err, n);
+            br.end = UINT32_MAX;
+            break; // 不跳转：两个分支都要计算
+        }
+        case OpCode::JUMP:
+            branches[depth - 1].end = in.arg; // 真分支结束，继续计算假分支
+            break;
+        case OpCode::STORE:
+            break; // 构造时已拒绝
+        case OpCode::FUNC: {
+            Column& c = *sp++;
+            c.has_err = false;
+            const Function* fn = eval.functions.find(expr.name(in.arg));
+            if (!fn) fail(c, BATCH_UNDEFINED_FUNCTION);
+            else if (!fn->accepts(expr.argc(in.arg))) fail(c, BATCH_BAD_ARITY);
+            else c.fn = fn;
+            break;
+        }
+        case OpCode::TEMP_STORE: {
+            const Column& c = sp[-1];
+            Column& t = temps[in.arg];
+            std::memcpy(t.buf, c.vals, n * sizeof(double));
+            t.has_err = c.has_err;
+            if (c.has_err) std::memcpy(t.err, c.err, n);
+            break;
+        }
+        case OpCode::TEMP_LOAD: {
+            Column& c = *sp++;
+            const Column& t = temps[in.arg];
+            c.vals = t.buf; // 只读引用，结果总是写入 c.buf
+            c.has_err = t.has_err;
+            if (t.has_err) std::memcpy(c.err, t.err, n);
+            c.fn = nullptr;
+            break;
+        }
+        case OpCode::CALL: {
+            uint32_t argc = expr.argc(in.arg);
+            sp -= argc;
+            Column* args = sp;
+            Column& f = sp[-1];
+            if (!f.fn) break; // 函数不存在或参数个数不对：参数不参与求值，保留 FUNC 的错误
+            const Function& fn = *f.fn;
+            f.has_err = false;
+            if (fn.kind == Function::Kind::USER) {
+                BatchRunner& body = *nested[in.arg];
+                for (uint32_t j = 0; j < argc; ++j) body.params[j] = args[j].vals;
+                body.base = base;
+                body.n = n;
+                const Column& r = body.execute();
+                std::memcpy(f.buf, r.vals, n * sizeof(double));
+                f.has_err = r.has_err;
+                if (r.has_err) std::memcpy(f.err, r.err, n);
+            } else if (fn.kind == Function::Kind::UNARY) {
+                const double* a = args[0].vals;
+                for (size_t i = 0; i < n; ++i) f.buf[i] = fn.unary(a[i]);
+            } else if (fn.kind == Function::Kind::BINARY) {
+                const double* a = args[0].vals;
+                const double* b = args[1].vals;
+                for (size_t i = 0; i < n; ++i) f.buf[i] = fn.binary(a[i], b[i]);
+            } else {
+                row.resize(argc);
+                for (size_t i = 0; i < n; ++i) {
+                    for (uint32_t j = 0; j < argc; ++j) row[j] = args[j].vals[i];
+                    f.buf[i] = fn.variadic(row.data(), argc);
+                }
+            }
+            fn.count_calls(n);
+            f.vals = f.buf;
+            f.fn = nullptr;
+            for (uint32_t j = 0; j < argc; ++j) mergeErrors(f, args[j], false);
+            break;
+        }
+        }
+    }
+
+    return columns[0];
+}
+
+void BatchRunner::runChunk(double* out, uint8_t* errors, BatchStats& stats) {
+    const Column& result = execute();
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t e = result.has_err ? result.err[i] : uint8_t(BATCH_OK);
+        out[i] = e ? NaN : result.vals[i];
+        if (errors) errors[i] = e;
+        if (e) ++stats.error_rows;
+    }
+}
+
+BatchStats BatchRunner::run(size_t first, std::span<double> out, std::span<uint8_t> errors) {
+    BatchStats stats;
+    stats.rows = out.size();
+    for (size_t done = 0; done < out.size(); done += CHUNK) {
+        base = first + done;
+        n = std::min(CHUNK, out.size() - done);
+        runChunk(out.data() + done, errors.empty() ? nullptr : errors.data() + done, stats);
+    }
+    return stats;
+}
+
+BatchEvaluator::BatchEvaluator(const CompiledExpr& expr, Evaluator& eval, std::span<const BatchColumn> columns,
+    size_t rows)
+    : runner(std::make_unique<BatchRunner>(expr, eval, columns, rows)), rows(rows) {}
+
+BatchEvaluator::~BatchEvaluator() = default;
+
+BatchStats BatchEvaluator::run(size_t first, std::span<double> out, std::span<uint8_t> errors) {
+    if (first > rows || out.size() > rows - first) throw std::invalid_argument("eval_batch: row range out of bounds");
+    if (!errors.empty() && errors.size() != out.size())
+        throw std::invalid_argument("eval_batch: error mask has the wrong length");
+    return runner->run(first, out, errors);
+}
+
+BatchStats eval_batch(const CompiledExpr& expr, Evaluator& eval, std::span<const BatchColumn> columns,
+    std::span<double> out, std::span<uint8_t> errors) {
+    if (!errors.empty() && errors.size() != out.size())
+        throw std::invalid_argument("eval_batch: error mask has the wrong length");
+    BatchRunner runner(expr, eval, columns, out.size());
+    return runner.run(0, out, errors);
+}
+
+BatchStats eval_batch(const CompiledExpr& expr, Evaluator& eval, std::initializer_list<BatchColumn> columns,
+    std::span<double> out, std::span<uint8_t> errors) {
+    return eval_batch(expr, eval, std::span<const BatchColumn>(columns.begin(), columns.size()), out, errors);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include "compiled_expr.h"
+
+class Evaluator;
+class BatchRunner;
+
+// 一列输入：变量名 + 每行的值
+struct BatchColumn {
+    std::string_view name;
+    std::span<const double> values;
+};
+
+// 每行的错误标志（按位或），出错的行输出 NaN
+enum BatchError : uint8_t {
+    BATCH_OK = 0,
+    BATCH_DIVISION_BY_ZERO = 1 << 0,
+    BATCH_MODULO_BY_ZERO = 1 << 1,
+    BATCH_UNDEFINED_VARIABLE = 1 << 2,
+    BATCH_UNDEFINED_FUNCTION = 1 << 3,
+    BATCH_BAD_ARITY = 1 << 4,
+    BATCH_UNHANDLED_OPERATOR = 1 << 5,
+};
+
+struct BatchStats {
+    size_t rows = 0;
+    size_t error_rows = 0;
+};
+
+// 对多行输入批量求值同一个公式。
+// 按缓存大小的块逐条执行字节码，每条指令处理整块数据（AVX2/AVX-512 可用时自动选用，否则为标量循环）；
+// 条件表达式两个分支都计算后按条件掩码混合，未被选中分支中的错误不会计入。
+// 求值错误不抛异常，而是写入 errors（可为空）中对应的行；未以列给出的变量取 eval 中的当前值。
+// 用户函数的调用按块执行函数体的字节码（参数列直接传入）；递归的用户函数因两个分支都要计算而无法终止，
+// 与赋值表达式一样不支持（std::invalid_argument）。输入列长度必须与 out 相同。
+BatchStats eval_batch(const CompiledExpr& expr, Evaluator& eval, std::span<const BatchColumn> columns,
+    std::span<double> out, std::span<uint8_t> errors = {});
+
+BatchStats eval_batch(const CompiledExpr& expr, Evaluator& eval, std::initializer_list<BatchColumn> columns,
+    std::span<double> out, std::span<uint8_t> errors = {});
+
+// 同一公式在同一组输入列上按行区间多次求值：函数体的展开与缓冲区只准备一次，
+// 供 ParallelEvaluator 的每个线程在各块之间复用。语义与 eval_batch 相同，eval 须在本对象存续期间有效
+class BatchEvaluator {
+    std::unique_ptr<BatchRunner> runner;
+    size_t rows;
+public:
+    BatchEvaluator(const CompiledExpr& expr, Evaluator& eval, std::span<const BatchColumn> columns, size_t rows);
+    ~BatchEvaluator();
+    BatchEvaluator(const BatchEvaluator&) = delete;
+    BatchEvaluator& operator=(const BatchEvaluator&) = delete;
+
+    // 求值 [first, first + out.size()) 行，结果与错误写入 out、errors（可为空）
+    BatchStats run(size_t first, std::span<double> out, std::span<uint8_t> errors = {});
+};
@@ -5,17 +5,21 @@
 #include "token_type.h"
 
 // 二元运算
-class BinaryExpr : public Expr {
-    std::unique_ptr<Expr> lhs, rhs;
+class BinaryExpr final : public Expr {
+    const Expr* lhs;
+    const Expr* rhs;
     TokenType op;
 public:
-    BinaryExpr(std::unique_ptr<Expr> l, TokenType o, std::unique_ptr<Expr> r);
-    Value evaluate(Evaluator& eval) const override;
-    std::unique_ptr<Expr> simplify() const override;
-    std::string to_string() const override;
+    BinaryExpr(const Expr* l, TokenType o, const Expr* r);
+    EvalResult try_evaluate(Evaluator& eval) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
 
     // 辅助方法：获取操作数和运算符
-    Expr* get_lhs() const;
-    Expr* get_rhs() const;
+    const Expr* get_lhs() const;
+    const Expr* get_rhs() const;
     TokenType get_op() const;
 };
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "compiled_expr.h"
+#include "evaluator.h"
+#include "function_registry.h"
+#include "operators.h"
+
+// CompiledExpr 的解释器，Evaluator 上的求值（compiled_expr.cpp）与 Program::run（program.cpp）共用。
+// 变量、参数与函数从 Env 取得：
+//   bool is_defined(uint32_t slot) / double get(uint32_t slot) / void set(uint32_t slot, double v)
+//   double param(uint32_t index)
+//   uint32_t depth()                                    用户函数的嵌套层数
+//   const Function* function(uint32_t site)             调用点 site 的函数，未定义时为 nullptr
+//   bytecode::Slot call_user(uint32_t site, const Function* fn, const double* args)  执行用户函数体
+// 出错时抛出 std::runtime_error，信息与逐节点求值相同
+namespace bytecode {
+
+// 运行时栈槽：数值、符号（未定义变量）或待调用的函数
+struct Slot {
+    union {
+        double num;
+        const Function* fn;
+    };
+    int32_t sym; // 符号值对应的变量槽，-1 表示数值
+};
+
+constexpr size_t INLINE_STACK = 128;
+constexpr size_t INLINE_ARGS = 8;
+
+// 执行 code，返回栈顶（数值或未定义变量的槽）
+template <class Env>
+Slot run(const CompiledExpr& code, Env& env) {
+    // 临时槽放在栈之后
+    const uint32_t max_stack = code.stack_depth();
+    Slot inline_stack[INLINE_STACK];
+    std::vector<Slot> heap_stack;
+    Slot* stack = inline_stack;
+    if (max_stack + code.temp_count() > INLINE_STACK) {
+        heap_stack.resize(max_stack + code.temp_count());
+        stack = heap_stack.data();
+    }
+    Slot* temp = stack + max_stack;
+
+    Slot* sp = stack; // 指向下一个空槽
+    const auto instrs = code.instructions();
+    const size_t n = instrs.size();
+
+    auto push = [&](double v) { sp->num = v; sp->sym = -1; ++sp; };
+    // 二元运算：先检查符号值，再计算
+    auto operands = [&](double& l, double& r) {
+        Slot& b = *--sp;
+        Slot& a = sp[-1];
+        if (a.sym >= 0 || b.sym >= 0)
+            throw std::runtime_error("Cannot evaluate expression with undefined variables");
+        l = a.num;
+        r = b.num;
+    };
+    auto result = [&](double v) { sp[-1].num = v; };
+
+    for (size_t pc = 0; pc < n; ++pc) {
+        const Instr& in = instrs[pc];
+        double l, r;
+        switch (in.op) {
+        case OpCode::PUSH_CONST:
+            push(code.constant(in.arg));
+            break;
+        case OpCode::LOAD_VAR:
+            if (env.is_defined(in.arg)) push(env.get(in.arg));
+            else { sp->num = 0.0; sp->sym = static_cast<int32_t>(in.arg); ++sp; }
+            break;
+        case OpCode::LOAD_PARAM:
+            push(env.param(in.arg));
+            break;
+        case OpCode::ADD: operands(l, r); result(l + r); break;
+        case OpCode::SUB: operands(l, r); result(l - r); break;
+        case OpCode::MUL: operands(l, r); result(l * r); break;
+        case OpCode::DIV: operands(l, r); result(operators::divide(l, r)); break;
+        case OpCode::MOD: operands(l, r); result(operators::modulo(l, r)); break;
+        case OpCode::POW: operands(l, r); result(std::pow(l, r)); break;
+        case OpCode::GT: operands(l, r); result(operators::gt(l, r)); break;
+        case OpCode::LT: operands(l, r); result(operators::lt(l, r)); break;
+        case OpCode::GE: operands(l, r); result(operators::ge(l, r)); break;
+        case OpCode::LE: operands(l, r); result(operators::le(l, r)); break;
+        case OpCode::EQ: operands(l, r); result(operators::eq(l, r)); break;
+        case OpCode::NE: operands(l, r); result(operators::ne(l, r)); break;
+        case OpCode::AND: operands(l, r); result(operators::logical_and(l, r)); break;
+        case OpCode::OR: operands(l, r); result(operators::logical_or(l, r)); break;
+        case OpCode::BINARY:
+            operands(l, r);
+            result(operators::binary(static_cast<TokenType>(in.arg), l, r));
+            break;
+        case OpCode::NEG:
+        case OpCode::NOT:
+            if (sp[-1].sym >= 0) throw std::runtime_error("Cannot evaluate expression with undefined variables");
+            sp[-1].num = in.op == OpCode::NEG ? -sp[-1].num : operators::logical_not(sp[-1].num);
+            break;
+        case OpCode::JUMP:
+            pc = in.arg - 1;
+            break;
+        case OpCode::JUMP_IF_FALSE: {
+            Slot& c = *--sp;
+            if (c.sym >= 0) throw std::runtime_error("Cannot evaluate conditional with undefined variables");
+            if (!operators::truthy(c.num)) pc = in.arg - 1;
+            break;
+        }
+        case OpCode::STORE:
+            if (sp[-1].sym >= 0) throw std::runtime_error("Cannot assign undefined variable");
+            env.set(in.arg, sp[-1].num);
+            break;
+        case OpCode::FUNC: {
+            const Function* fn = env.function(in.arg);
+            if (!fn) throw std::runtime_error("Undefined function: " + code.name(in.arg));
+            if (!fn->accepts(code.argc(in.arg)))
+                throw std::runtime_error(arity_message(code.name(in.arg), fn->min_args, fn->max_args));
+            sp->fn = fn;
+            sp->sym = -1;
+            ++sp;
+            break;
+        }
+        case OpCode::CALL: {
+            uint32_t argc = code.argc(in.arg);
+            sp -= argc;
+            // 栈槽不是连续的 double，参数先复制出来
+            double inline_args[INLINE_ARGS];
+            std::vector<double> heap_args;
+            double* args = inline_args;
+            if (argc > INLINE_ARGS) {
+                heap_args.resize(argc);
+                args = heap_args.data();
+            }
+            for (uint32_t i = 0; i < argc; ++i) {
+                if (sp[i].sym >= 0) throw std::runtime_error("Cannot evaluate function with undefined variables");
+                args[i] = sp[i].num;
+            }
+            const Function* fn = sp[-1].fn;
+            if (fn->kind != Function::Kind::USER) {
+                sp[-1].num = fn->call(args, argc);
+                break;
+            }
+            // 用户函数：执行函数体的字节码
+            if (env.depth() >= Evaluator::MAX_CALL_DEPTH) throw std::runtime_error(call_depth_message(fn->name));
+            fn->count_calls(1);
+            sp[-1] = env.call_user(in.arg, fn, args);
+            break;
+        }
+        case OpCode::TEMP_STORE:
+            temp[in.arg] = sp[-1];
+            break;
+        case OpCode::TEMP_LOAD:
+            *sp++ = temp[in.arg];
+            break;
+        }
+    }
+    return sp[-1];
+}
+
+} // namespace bytecode
@@ -1,41 +1,198 @@
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
 #include "evaluator.h" // 节点递归运算需要
 #include "call_expr.h"
+#include "compiled_expr.h"
+#include "printer.h"
+#include "expr_dag.h"
+#include "number_expr.h"
+#include "user_function.h"
+#include "differentiator.h"
 
 // 函数调用
-CallExpr::CallExpr(std::string name, std::vector<std::unique_ptr<Expr>> a)
-        : func_name(std::move(name)), args(std::move(a)) {}
+CallExpr::CallExpr(std::string_view name, std::span<const Expr* const> a)
+        : func_name(name), args(a) {}
+
+void CallExpr::print(Printer& p) const {
+    p.text(func_name);
+    p.text("(");
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (i > 0) p.text(", ");
+        p.operand(args[i], 0);
+    }
+    p.text(")");
+}
+
+
+EvalResult CallExpr::try_evaluate(Evaluator& eval) const {
+    const Function* fn = eval.functions.find(func_name);
+    if (!fn)
+        return EvalError{ EvalErrc::UNDEFINED_FUNCTION, this };
+
+    if (!fn->accepts(args.size()))
+        return EvalError{ EvalErrc::BAD_ARITY, this, fn->min_args, fn->max_args };
+
+    // 参数个数很少，先放在栈上
+    constexpr size_t INLINE_ARGS = 8;
+    double inline_values[INLINE_ARGS];
+    std::vector<double> heap_values;
+    double* values = inline_values;
+    if (args.size() > INLINE_ARGS) {
+        heap_values.resize(args.size());
+        values = heap_values.data();
+    }
+    // 与字节码相同：参数全部求值之后才检查未定义变量
+    bool symbolic = false;
+    for (size_t i = 0; i < args.size(); ++i) {
+        EvalResult arg = args[i]->try_evaluate(eval);
+        if (!arg) return arg;
+        symbolic = symbolic || arg->is_symbol();
+        values[i] = arg->num;
+    }
+    if (symbolic) {
+        return EvalError{ EvalErrc::UNDEFINED_VARIABLE, this };
+    }
+    if (fn->kind == Function::Kind::USER) {
+        if (eval.depth() >= Evaluator::MAX_CALL_DEPTH)
+            return EvalError{ EvalErrc::CALL_DEPTH_EXCEEDED, this };
+        fn->count_calls(1);
+        CallFrame frame(eval, values);
+        return fn->user->body()->try_evaluate(eval);
+    }
+    return Value(fn->call(values, args.size()));
+}
 
-std::string CallExpr::to_string() const {
-    std::string s = func_name + "(";
+
+const Expr* CallExpr::simplify(ExprDag& dag) const {
+    // 参数个数很少，先放在栈上，dag 构造新节点时再复制进 arena
+    constexpr size_t INLINE_ARGS = 8;
+    const Expr* inline_args[INLINE_ARGS];
+    std::vector<const Expr*> heap_args;
+    const Expr** new_args = inline_args;
+    if (args.size() > INLINE_ARGS) {
+        heap_args.resize(args.size());
+        new_args = heap_args.data();
+    }
+    bool changed = false;
+    bool constant = true;
     for (size_t i = 0; i < args.size(); ++i) {
-        if (i > 0) s += ", ";
-        s += args[i]->to_string();
+        new_args[i] = dag.simplify(args[i]);
+        changed = changed || new_args[i] != args[i];
+        constant = constant && dynamic_cast<const NumberExpr*>(new_args[i]);
+    }
+
+    std::span<const Expr* const> simplified(new_args, args.size());
+    const Function* fn = dag.function_table().find(func_name);
+    if (fn && fn->accepts(args.size())) {
+        // 小的用户函数展开为函数体，之后与周围一起化简
+        if (const Expr* inlined = dag.inline_call(*fn, simplified)) return inlined;
+
+        // 纯函数的常数调用直接折叠；超出定义域或结果不是有限值时保留调用，求值时得到同样的结果
+        if (constant && fn->pure() && fn->kind != Function::Kind::USER) {
+            double inline_values[INLINE_ARGS];
+            std::vector<double> heap_values;
+            double* values = inline_values;
+            if (args.size() > INLINE_ARGS) {
+                heap_values.resize(args.size());
+                values = heap_values.data();
+            }
+            for (size_t i = 0; i < args.size(); ++i) values[i] = static_cast<const NumberExpr*>(new_args[i])->val;
+            if (fn->in_domain(values, args.size())) {
+                double result = fn->invoke(values, args.size());
+                if (std::isfinite(result)) return dag.number(result);
+            }
+        }
     }
-    s += ")";
-    return s;
+    return dag.call(func_name, simplified, changed ? nullptr : this);
 }
 
 
-Value CallExpr::evaluate(Evaluator& eval) const {
-    auto it = eval.builtin_funcs.find(func_name);
-    if (it == eval.builtin_funcs.end())
-        throw std::runtime_error("Undefined function: " + func_name);
+void CallExpr::compile(Compiler& c) const {
+    uint32_t site = c.call_site(func_name, static_cast<uint32_t>(args.size()));
+    // 与逐节点求值相同：FUNC 先查找函数、检查参数个数，再对参数求值
+    c.emit(OpCode::FUNC, site);
+    for (const Expr* arg : args) c.operand(arg);
+    c.emit(OpCode::CALL, site);
+    // 非纯函数的调用不能合并：之后的共享子表达式也要重新计算
+    const Function* fn = c.evaluator().functions.find(func_name);
+    if (!fn || !fn->pure()) c.side_effect();
+}
 
-    if (args.size() != 1)
-        throw std::runtime_error("Function " + func_name + " expects 1 argument");
 
-    Value arg = args[0]->evaluate(eval);
-    if (arg.is_symbol()) {
-        throw std::runtime_error("Cannot evaluate function with undefined variables");
+const Expr* CallExpr::share(ExprDag& dag) const {
+    constexpr size_t INLINE_ARGS = 8;
+    const Expr* inline_args[INLINE_ARGS];
+    std::vector<const Expr*> heap_args;
+    const Expr** new_args = inline_args;
+    if (args.size() > INLINE_ARGS) {
+        heap_args.resize(args.size());
+        new_args = heap_args.data();
+    }
+    for (size_t i = 0; i < args.size(); ++i) {
+        new_args[i] = args[i]->share(dag);
     }
-    return Value(it->second(arg.num));
+    return dag.call(func_name, std::span<const Expr* const>(new_args, args.size()));
 }
 
 
-std::unique_ptr<Expr> CallExpr::simplify() const {
-    std::vector<std::unique_ptr<Expr>> new_args;
-    for (auto& arg : args) {
-        new_args.push_back(arg->simplify());
+const Expr* CallExpr::derive(Differentiator& d) const {
+    const Function* fn = d.dag().function_table().find(func_name);
+    if (!fn) throw std::invalid_argument("Undefined function: " + std::string(func_name));
+    if (!fn->accepts(args.size())) throw std::invalid_argument(arity_message(func_name, fn->min_args, fn->max_args));
+    if (fn->kind == Function::Kind::USER) {
+        throw std::invalid_argument("Cannot differentiate call to " + std::string(func_name)
+            + " symbolically (it was not inlined); use gradient() instead");
     }
-    return std::make_unique<CallExpr>(func_name, std::move(new_args));
-}
\ No newline at end of file
+
+    std::string_view name = func_name;
+    if (name == "pow") return d.power(this, args[0], args[1]);
+    if (name == "atan2") {
+        // atan2(y, x)' = (x * y' - y * x') / (x ^ 2 + y ^ 2)
+        const Expr* y = args[0];
+        const Expr* x = args[1];
+        const Expr* num = d.sub(d.mul(x, d.derive(y)), d.mul(y, d.derive(x)));
+        if (Differentiator::is_zero(num)) return num;
+        const Expr* two = d.number(2.0);
+        return d.div(num, d.add(d.binary(x, TokenType::POW, two), d.binary(y, TokenType::POW, two)));
+    }
+    if (name == "hypot") {
+        // (a * a' + b * b' + ...) / hypot(a, b, ...)
+        const Expr* sum = d.number(0.0);
+        for (const Expr* a : args) sum = d.add(sum, d.mul(a, d.derive(a)));
+        return d.div(sum, this);
+    }
+    if (name == "min" || name == "max") {
+        if (args.size() == 1) return d.derive(args[0]);
+        // min(a, rest...)' = a <= min(rest...) ? a' : min(rest...)'
+        const Expr* rest = args.size() == 2 ? args[1] : d.dag().call(func_name, args.subspan(1));
+        const Expr* da = d.derive(args[0]);
+        const Expr* dr = d.derive(rest);
+        if (Differentiator::is_zero(da) && Differentiator::is_zero(dr)) return da;
+        TokenType op = name == "min" ? TokenType::LE : TokenType::GE;
+        return d.dag().conditional(d.binary(args[0], op, rest), da, dr);
+    }
+
+    // 一元函数：f(a)' = f'(a) * a'
+    const Expr* a = args[0];
+    const Expr* da = d.derive(a);
+    if (Differentiator::is_zero(da)) return da;
+    const Expr* outer;
+    if (name == "sin") outer = d.call("cos", a);
+    else if (name == "cos") outer = d.neg(d.call("sin", a));
+    else if (name == "tan") outer = d.add(d.number(1.0), d.binary(this, TokenType::POW, d.number(2.0)));
+    else if (name == "sqrt") outer = d.div(d.number(0.5), this);
+    else if (name == "log") outer = d.div(d.number(1.0), d.mul(a, d.number(std::log(10.0))));
+    else if (name == "ln") outer = d.div(d.number(1.0), a);
+    else if (name == "exp") outer = this;
+    else if (name == "abs") {
+        // 在 0 处取 0
+        const Expr* zero = d.number(0.0);
+        const Expr* negative = d.dag().conditional(d.binary(a, TokenType::LT, zero), d.number(-1.0), zero);
+        outer = d.dag().conditional(d.binary(a, TokenType::GT, zero), d.number(1.0), negative);
+    }
+    else throw std::invalid_argument("Cannot differentiate function " + std::string(func_name) + " symbolically");
+    return d.mul(outer, da);
+}
@@ -1,16 +1,23 @@
 #pragma once
 
-#include <vector>
+#include <span>
+#include <string_view>
 
 #include "expr.h"
 
 // 函数调用
-class CallExpr : public Expr {
-    std::string func_name;
-    std::vector<std::unique_ptr<Expr>> args;
+class CallExpr final : public Expr {
+    std::string_view func_name;
+    std::span<const Expr* const> args;
+    friend class ExprDag;
 public:
-    CallExpr(std::string name, std::vector<std::unique_ptr<Expr>> a);
-    Value evaluate(Evaluator& eval) const override;
-    std::unique_ptr<Expr> simplify() const override;
-    std::string to_string() const override;
+    CallExpr(std::string_view name, std::span<const Expr* const> a);
+    EvalResult try_evaluate(Evaluator& eval) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
+
+    std::string_view get_name() const { return func_name; }
 };
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include <sstream>
+
+#include "evaluator.h"
+#include "bytecode_vm.h"
+#include "compiled_expr.h"
+#include "operators.h"
+#include "user_function.h"
+
+namespace {
+
+// 每条指令对栈深度的影响
+int stack_effect(OpCode op) {
+    switch (op) {
+    case OpCode::PUSH_CONST: case OpCode::LOAD_VAR: case OpCode::LOAD_PARAM: case OpCode::FUNC:
+    case OpCode::TEMP_LOAD: return 1;
+    case OpCode::NEG: case OpCode::NOT: case OpCode::JUMP: case OpCode::STORE:
+    case OpCode::TEMP_STORE: return 0;
+    case OpCode::JUMP_IF_FALSE: return -1;
+    default: return -1; // 二元运算：弹出两个，压入一个（CALL 由调用方按参数个数计算）
+    }
+}
+
+const char* op_name(OpCode op) {
+    switch (op) {
+    case OpCode::PUSH_CONST: return "PUSH_CONST";
+    case OpCode::LOAD_VAR: return "LOAD_VAR";
+    case OpCode::LOAD_PARAM: return "LOAD_PARAM";
+    case OpCode::ADD: return "ADD";
+    case OpCode::SUB: return "SUB";
+    case OpCode::MUL: return "MUL";
+    case OpCode::DIV: return "DIV";
+    case OpCode::MOD: return "MOD";
+    case OpCode::POW: return "POW";
+    case OpCode::GT: return "GT";
+    case OpCode::LT: return "LT";
+    case OpCode::GE: return "GE";
+    case OpCode::LE: return "LE";
+    case OpCode::EQ: return "EQ";
+    case OpCode::NE: return "NE";
+    case OpCode::AND: return "AND";
+    case OpCode::OR: return "OR";
+    case OpCode::BINARY: return "BINARY";
+    case OpCode::NEG: return "NEG";
+    case OpCode::NOT: return "NOT";
+    case OpCode::JUMP: return "JUMP";
+    case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+    case OpCode::STORE: return "STORE";
+    case OpCode::FUNC: return "FUNC";
+    case OpCode::CALL: return "CALL";
+    case OpCode::TEMP_STORE: return "TEMP_STORE";
+    case OpCode::TEMP_LOAD: return "TEMP_LOAD";
+    }
+    return "?";
+}
+
+// 在 Evaluator 上求值：变量与参数取自 eval，函数在调用时按名字查找
+struct EvaluatorEnv {
+    Evaluator& eval;
+    const CompiledExpr& code;
+
+    bool is_defined(uint32_t slot) const { return eval.is_defined(VarSlot{ slot }); }
+    double get(uint32_t slot) const { return eval.get(VarSlot{ slot }); }
+    void set(uint32_t slot, double v) { eval.set(VarSlot{ slot }, v); }
+    double param(uint32_t index) const { return eval.param(index); }
+    uint32_t depth() const { return eval.depth(); }
+    const Function* function(uint32_t site) const { return eval.functions.find(code.name(site)); }
+    bytecode::Slot call_user(uint32_t site, const Function* fn, const double* args);
+};
+
+// 函数体在定义时的 Evaluator 上编译，与 eval 共用变量槽
+bytecode::Slot EvaluatorEnv::call_user(uint32_t, const Function* fn, const double* args) {
+    const CompiledExpr& body = fn->user->bytecode();
+    if (eval.slot_count() < body.slots_required())
+        throw std::logic_error("CompiledExpr evaluated with an Evaluator it was not compiled for");
+    CallFrame frame(eval, args);
+    EvaluatorEnv inner{ eval, body };
+    return bytecode::run(body, inner);
+}
+
+} // namespace
+
+size_t NodeTable::hash(const Expr* node) {
+    uint64_t h = reinterpret_cast<uintptr_t>(node);
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+}
+
+void NodeTable::grow() {
+    std::vector<Entry> old(table.empty() ? 64 : table.size() * 2);
+    old.swap(table);
+    size_t mask = table.size() - 1;
+    for (const auto& e : old) {
+        if (!e.node) continue;
+        size_t i = hash(e.node) & mask;
+        while (table[i].node) i = (i + 1) & mask;
+        table[i] = e;
+    }
+}
+
+NodeTable::Entry& NodeTable::at(const Expr* node) {
+    if ((used + 1) * 2 > table.size()) grow();
+    size_t mask = table.size() - 1;
+    size_t i = hash(node) & mask;
+    for (; table[i].node; i = (i + 1) & mask) {
+        if (table[i].node == node) return table[i];
+    }
+    ++used;
+    table[i].node = node;
+    return table[i];
+}
+
+void Compiler::compile(const Expr* root) {
+    counting = true;
+    operand(root);
+    counting = false;
+    operand(root);
+}
+
+void Compiler::operand(const Expr* e) {
+    // 只有 ExprDag 标记为共享的节点才可能被多次访问，其余节点不进表
+    if (!e->is_shared()) {
+        e->compile(*this);
+        return;
+    }
+    if (counting) {
+        if (nodes.at(e).uses++ == 0) e->compile(*this);
+        return;
+    }
+    // 共享节点在计数阶段都已入表，之后表不再扩容，表项地址不变
+    auto& entry = nodes.at(e);
+    if (entry.temp) {
+        emit(OpCode::TEMP_LOAD, entry.temp - 1);
+        return;
+    }
+    uint32_t start = here();
+    uint32_t effects_before = effects;
+    e->compile(*this);
+    // 叶节点（单条指令）不值得缓存；含赋值或非纯函数调用的子表达式每次都要重新执行
+    if (here() - start > 1 && effects == effects_before && entry.uses > 1) {
+        uint32_t temp = out.temps++;
+        emit(OpCode::TEMP_STORE, temp);
+        entry.temp = temp + 1;
+        available.emplace_back(&entry, branch_depth);
+    }
+}
+
+void Compiler::end_branch() {
+    while (!available.empty() && available.back().second == branch_depth) {
+        available.back().first->temp = 0;
+        available.pop_back();
+    }
+    --branch_depth;
+}
+
+void Compiler::emit(OpCode op, uint32_t arg) {
+    if (counting) return;
+    if (op == OpCode::STORE) {
+        // 赋值可能改变已缓存子表达式的值
+        ++effects;
+        for (auto& [entry, level] : available) entry->temp = 0;
+        available.clear();
+    }
+    out.code.push_back({ op, arg });
+    depth += op == OpCode::CALL ? -static_cast<int>(out.calls[arg].argc) : stack_effect(op);
+    if (depth > static_cast<int>(out.max_stack)) out.max_stack = depth;
+}
+
+uint32_t Compiler::constant(double v) {
+    if (counting) return 0;
+    out.constants.push_back(v);
+    return static_cast<uint32_t>(out.constants.size() - 1);
+}
+
+uint32_t Compiler::call_site(std::string_view n, uint32_t argc) {
+    if (counting) return 0;
+    for (size_t i = 0; i < out.calls.size(); ++i) {
+        if (out.calls[i].name == n && out.calls[i].argc == argc) return static_cast<uint32_t>(i);
+    }
+    out.calls.push_back({ std::string(n), argc });
+    return static_cast<uint32_t>(out.calls.size() - 1);
+}
+
+uint32_t Compiler::slot(std::string_view n) {
+    if (counting) return 0;
+    uint32_t index = eval.bind(n).index;
+    if (index >= out.slots_needed) out.slots_needed = index + 1;
+    return index;
+}
+
+CompiledExpr::CompiledExpr(const Expr* expr, Evaluator& eval) {
+    Compiler compiler(*this, eval);
+    compiler.compile(expr);
+}
+
+Value CompiledExpr::evaluate(Evaluator& eval) const {
+    if (eval.slot_count() < slots_needed)
+        throw std::logic_error("CompiledExpr evaluated with an Evaluator it was not compiled for");
+    EvaluatorEnv env{ eval, *this };
+    bytecode::Slot top = bytecode::run(*this, env);
+    if (top.sym >= 0) return Value::symbol(eval.name_of(VarSlot{ static_cast<uint32_t>(top.sym) }));
+    return Value(top.num);
+}
+
+std::string CompiledExpr::disassemble() const {
+    std::ostringstream oss;
+    for (size_t i = 0; i < code.size(); ++i) {
+        const Instr& in = code[i];
+        oss << i << ": " << op_name(in.op);
+        switch (in.op) {
+        case OpCode::PUSH_CONST: oss << " " << constants[in.arg]; break;
+        case OpCode::FUNC: case OpCode::CALL:
+            oss << " " << calls[in.arg].name << "/" << calls[in.arg].argc; break;
+        case OpCode::LOAD_VAR: case OpCode::STORE:
+            oss << " $" << in.arg; break;
+        case OpCode::LOAD_PARAM:
+            oss << " %" << in.arg; break;
+        case OpCode::JUMP: case OpCode::JUMP_IF_FALSE: case OpCode::BINARY:
+            oss << " " << in.arg; break;
+        case OpCode::TEMP_STORE: case OpCode::TEMP_LOAD:
+            oss << " t" << in.arg; break;
+        default: break;
+        }
+        oss << "\n";
+    }
+    return oss.str();
+}
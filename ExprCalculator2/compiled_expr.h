@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "value.h"
+#include "expr.h"
+#include "token_type.h"
+
+class Evaluator;
+
+// 字节码操作码（基于栈）
+enum class OpCode : uint8_t {
+    PUSH_CONST,     // 压入常量池中的常量 arg
+    LOAD_VAR,       // 压入变量槽 arg 的值，未定义时压入符号值
+    LOAD_PARAM,     // 压入当前用户函数的第 arg 个参数（只出现在函数体中）
+    ADD, SUB, MUL, DIV, MOD, POW,
+    GT, LT, GE, LE, EQ, NE,
+    AND, OR,
+    BINARY,         // 其他二元运算符（TokenType 为 arg），由 operators::binary 处理
+    NEG, NOT,
+    JUMP,           // 无条件跳转到 arg
+    JUMP_IF_FALSE,  // 弹出条件，为假时跳转到 arg
+    STORE,          // 把栈顶赋给变量槽 arg（不弹出）
+    FUNC,           // 查找调用点 arg 的函数、检查参数个数并压栈，参数求值之前执行
+    CALL,           // 弹出调用点 arg 的全部参数与函数，压入调用结果
+    TEMP_STORE,     // 把栈顶复制到临时槽 arg（不弹出），共享子表达式第一次计算后执行
+    TEMP_LOAD,      // 压入临时槽 arg 的值
+};
+
+struct Instr {
+    OpCode op;
+    uint32_t arg = 0;
+};
+
+// 编译后的表达式：一次编译，多次求值。
+// 结果与错误信息与 Evaluator::evaluate 逐节点求值完全一致，求值过程不分配内存。
+// 变量名在编译时解析为 Evaluator 的变量槽，之后只能在该 Evaluator（或编译后复制出的副本）上求值。
+// AST 中共享的子表达式（见 expr_dag.h）只计算一次，结果存入临时槽供后续引用。
+class CompiledExpr {
+    friend class Compiler;
+
+    std::vector<Instr> code;
+    std::vector<double> constants;
+    struct CallSite {
+        std::string name;
+        uint32_t argc;
+    };
+    std::vector<CallSite> calls; // 函数名与参数个数
+    uint32_t max_stack = 0;
+    uint32_t slots_needed = 0;
+    uint32_t temps = 0;
+public:
+    CompiledExpr(const Expr* expr, Evaluator& eval);
+
+    Value evaluate(Evaluator& eval) const;
+
+    size_t size() const { return code.size(); }
+    uint32_t stack_depth() const { return max_stack; }
+    // 求值所需的最少变量槽数
+    uint32_t slots_required() const { return slots_needed; }
+    // 共享子表达式使用的临时槽数
+    uint32_t temp_count() const { return temps; }
+
+    // 供其他后端（批量求值等）读取字节码
+    std::span<const Instr> instructions() const { return code; }
+    double constant(uint32_t index) const { return constants[index]; }
+    const std::string& name(uint32_t call) const { return calls[call].name; }
+    uint32_t argc(uint32_t call) const { return calls[call].argc; }
+    size_t call_sites() const { return calls.size(); }
+    // 反汇编，便于调试
+    std::string disassemble() const;
+};
+
+// 以节点地址为键的开放寻址表，记录共享节点的引用次数与所在临时槽，不为每个节点单独分配
+class NodeTable {
+public:
+    struct Entry {
+        const Expr* node = nullptr;
+        uint32_t uses = 0;
+        uint32_t temp = 0; // 临时槽下标 + 1，0 表示当前不可用
+    };
+private:
+    std::vector<Entry> table;
+    size_t used = 0;
+
+    static size_t hash(const Expr* node);
+    void grow();
+public:
+    // 查找节点，不存在时插入
+    Entry& at(const Expr* node);
+};
+
+// 由各 Expr 子类的 compile() 调用，向 CompiledExpr 追加指令。
+// 子节点通过 operand() 编译：先用一遍计数确定 DAG 中每个节点被引用的次数，
+// 第二遍时被多次引用的非叶节点第一次计算后存入临时槽，之后直接读取。
+class Compiler {
+    CompiledExpr& out;
+    Evaluator& eval;
+    int depth = 0;
+
+    bool counting = false; // 计数阶段：不生成指令
+    NodeTable nodes;
+    // 当前可用的临时槽；条件分支内产生的临时槽在分支结束后失效（另一条路径上没有计算）
+    std::vector<std::pair<NodeTable::Entry*, uint32_t>> available; // (表项, 所在的分支层数)
+    uint32_t branch_depth = 0;
+    uint32_t effects = 0; // 已生成的 STORE 与非纯函数调用数
+public:
+    Compiler(CompiledExpr& target, Evaluator& e) : out(target), eval(e) {}
+
+    // 编译整个表达式
+    void compile(const Expr* root);
+    // 编译子表达式
+    void operand(const Expr* e);
+
+    void emit(OpCode op, uint32_t arg = 0);
+    uint32_t constant(double v);
+    // 调用点：函数名 + 参数个数
+    uint32_t call_site(std::string_view n, uint32_t argc);
+    // 变量名 → Evaluator 中的槽
+    uint32_t slot(std::string_view n);
+
+    // 当前位置，用于跳转
+    uint32_t here() const { return static_cast<uint32_t>(out.code.size()); }
+    void patch(uint32_t at, uint32_t target) { if (!counting) out.code[at].arg = target; }
+    // 分支合并时修正栈深度（两个分支各压入一个值，只算一次）
+    void adjust_depth(int delta) { if (!counting) depth += delta; }
+    // 条件表达式的一个分支
+    void begin_branch() { ++branch_depth; }
+    void end_branch();
+    // 刚生成的代码有副作用（非纯函数调用），包含它的共享子表达式不缓存
+    void side_effect() { if (!counting) ++effects; }
+
+    Evaluator& evaluator() { return eval; }
+};
@@ -1,39 +1,88 @@
 #include "evaluator.h" // 节点递归运算需要
 #include "conditional_expr.h"
 #include "number_expr.h"
+#include "operators.h"
+#include "compiled_expr.h"
+#include "printer.h"
+#include "expr_dag.h"
+#include "differentiator.h"
 
 // 三元条件表达式
-ConditionalExpr::ConditionalExpr(std::unique_ptr<Expr> c, std::unique_ptr<Expr> t, std::unique_ptr<Expr> f)
-        : cond(std::move(c)), true_expr(std::move(t)), false_expr(std::move(f)) {
+ConditionalExpr::ConditionalExpr(const Expr* c, const Expr* t, const Expr* f)
+        : cond(c), true_expr(t), false_expr(f) {
     }
 
-std::string ConditionalExpr::to_string() const {
-    return cond->to_string() + " ? " + true_expr->to_string() + " : " + false_expr->to_string();
+void ConditionalExpr::print(Printer& p) const {
+    // 条件不能是另一个条件表达式；假分支按同级解析，因此 a ? b : c ? d : e 不加括号
+    int prec = operators::precedence(TokenType::QUESTION);
+    bool opened = p.open(prec);
+    p.operand(cond, prec + 1);
+    p.text(" ? ");
+    p.operand(true_expr, 0);
+    p.text(" : ");
+    p.operand(false_expr, prec);
+    p.close(opened);
 }
 
 
-Value ConditionalExpr::evaluate(Evaluator& eval) const {
-    Value cond_val = cond->evaluate(eval);
-    if (cond_val.is_symbol()) {
-        throw std::runtime_error("Cannot evaluate conditional with undefined variables");
+EvalResult ConditionalExpr::try_evaluate(Evaluator& eval) const {
+    EvalResult cond_val = cond->try_evaluate(eval);
+    if (!cond_val) return cond_val;
+    if (cond_val->is_symbol()) {
+        return EvalError{ EvalErrc::UNDEFINED_VARIABLE, this };
     }
-    return (std::abs(cond_val.num) > 1e-9) ? true_expr->evaluate(eval) : false_expr->evaluate(eval);
+    return operators::truthy(cond_val->num) ? true_expr->try_evaluate(eval) : false_expr->try_evaluate(eval);
 }
 
 
-std::unique_ptr<Expr> ConditionalExpr::simplify() const {
-    auto new_cond = cond->simplify();
-    auto new_true = true_expr->simplify();
-    auto new_false = false_expr->simplify();
+const Expr* ConditionalExpr::simplify(ExprDag& dag) const {
+    auto new_cond = dag.simplify(cond);
+    auto new_true = dag.simplify(true_expr);
+    auto new_false = dag.simplify(false_expr);
 
-    if (auto num_cond = dynamic_cast<const NumberExpr*>(new_cond.get())) {
+    if (auto num_cond = dynamic_cast<const NumberExpr*>(new_cond)) {
         if (std::abs(num_cond->val) > 1e-9) {
-            return std::move(new_true);
+            return new_true;
         }
         else {
-            return std::move(new_false);
+            return new_false;
         }
     }
 
-    return std::make_unique<ConditionalExpr>(std::move(new_cond), std::move(new_true), std::move(new_false));
-}
\ No newline at end of file
+    bool unchanged = new_cond == cond && new_true == true_expr && new_false == false_expr;
+    return dag.conditional(new_cond, new_true, new_false, unchanged ? this : nullptr);
+}
+
+
+void ConditionalExpr::compile(Compiler& c) const {
+    c.operand(cond);
+    uint32_t to_false = c.here();
+    c.emit(OpCode::JUMP_IF_FALSE);
+    c.begin_branch();
+    c.operand(true_expr);
+    c.end_branch();
+    uint32_t to_end = c.here();
+    c.emit(OpCode::JUMP);
+    c.adjust_depth(-1); // 两个分支只会有一个结果留在栈上
+    c.patch(to_false, c.here());
+    c.begin_branch();
+    c.operand(false_expr);
+    c.end_branch();
+    c.patch(to_end, c.here());
+}
+
+
+const Expr* ConditionalExpr::share(ExprDag& dag) const {
+    const Expr* c = cond->share(dag);
+    const Expr* t = true_expr->share(dag);
+    return dag.conditional(c, t, false_expr->share(dag));
+}
+
+
+const Expr* ConditionalExpr::derive(Differentiator& d) const {
+    // 条件本身的导数为 0，两个分支各自求导
+    const Expr* t = d.derive(true_expr);
+    const Expr* f = d.derive(false_expr);
+    if (Differentiator::is_zero(t) && Differentiator::is_zero(f)) return t;
+    return d.dag().conditional(cond, t, f);
+}
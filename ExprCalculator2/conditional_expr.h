@@ -3,11 +3,17 @@
 #include "expr.h"
 
 // 三元条件表达式
-class ConditionalExpr : public Expr {
-    std::unique_ptr<Expr> cond, true_expr, false_expr;
+class ConditionalExpr final : public Expr {
+    const Expr* cond;
+    const Expr* true_expr;
+    const Expr* false_expr;
+    friend class ExprDag;
 public:
-    ConditionalExpr(std::unique_ptr<Expr> c, std::unique_ptr<Expr> t, std::unique_ptr<Expr> f);
-    Value evaluate(Evaluator& eval) const override;
-    std::unique_ptr<Expr> simplify() const override;
-    std::string to_string() const override;
+    ConditionalExpr(const Expr* c, const Expr* t, const Expr* f);
+    EvalResult try_evaluate(Evaluator& eval) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
 };
\ No newline at end of file
@@ -1,5 +1,9 @@
 #pragma once
 
-// 常量
+// 常量（glibc 的 <cmath> 已经把 M_PI / M_E 定义成宏，这里只在缺失时补上）
+#ifndef M_PI
 constexpr double M_PI = 3.14159265358979323846;
-constexpr double M_E = 2.71828182845904523536;
\ No newline at end of file
+#endif
+#ifndef M_E
+constexpr double M_E = 2.71828182845904523536;
+#endif
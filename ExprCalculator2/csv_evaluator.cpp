@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "csv_evaluator.h"
+#include "batch_eval.h"
+#include "line_reader.h"
+#include "number_scan.h"
+#include "parser.h"
+#include "printer.h"
+
+namespace {
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+
+// 从 pos 开始拆出一个字段（去掉引号；引号内的 "" 不还原，这样的字段也不会是数值），
+// pos 移到下一个字段开头，最后一个字段之后为 line.size() + 1。引号没有闭合时返回 false
+bool next_field(std::string_view line, size_t& pos, std::string_view& field) {
+    size_t start = pos;
+    while (start < line.size() && (line[start] == ' ' || line[start] == '\t')) ++start;
+    if (start < line.size() && line[start] == '"') {
+        for (size_t i = start + 1;;) {
+            size_t q = line.find('"', i);
+            if (q == std::string_view::npos) {
+                field = line.substr(start);
+                pos = line.size() + 1;
+                return false;
+            }
+            if (q + 1 < line.size() && line[q + 1] == '"') {
+                i = q + 2;
+                continue;
+            }
+            size_t comma = line.find(',', q + 1);
+            pos = comma == std::string_view::npos ? line.size() + 1 : comma + 1;
+            field = line.substr(start + 1, q - start - 1);
+            return true;
+        }
+    }
+    size_t comma = line.find(',', pos);
+    if (comma == std::string_view::npos) comma = line.size();
+    field = line.substr(pos, comma - pos);
+    pos = comma + 1;
+    return true;
+}
+
+
+// 字段整体是一个数值字面量（可带正负号与两侧空白）
+bool parse_number(std::string_view s, double& value) {
+    s = trim(s);
+    bool negative = false;
+    if (!s.empty() && (s.front() == '-' || s.front() == '+')) {
+        negative = s.front() == '-';
+        s.remove_prefix(1);
+    }
+    if (s.empty() || !(std::isdigit(static_cast<unsigned char>(s.front())) || s.front() == '.')) return false;
+    NumberScan n = scan_number(s);
+    if (!n.ok() || n.length != s.size()) return false;
+    value = negative ? -n.value : n.value;
+    return true;
+}
+
+} // namespace
+
+CsvEvaluator::CsvEvaluator(Evaluator& e, std::string_view source, std::FILE* output, unsigned threads,
+    std::string column)
+    : eval(e), expr(Parser(source).parse().simplify(&e.functions)), code(expr.get(), e), sink(output),
+      column_name(std::move(column)) {
+    for (const Instr& in : code.instructions()) {
+        if (in.op != OpCode::LOAD_VAR) continue;
+        const std::string& name = eval.name_of(VarSlot{ in.arg });
+        if (std::find(reads.begin(), reads.end(), name) == reads.end()) reads.push_back(name);
+    }
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads > 1) {
+        parallel = std::make_unique<ParallelEvaluator>(threads);
+        counters.threads = parallel->threads();
+    }
+    bad.resize(BLOCK_ROWS);
+    missing.resize(BLOCK_ROWS);
+    errors.resize(BLOCK_ROWS);
+    results.resize(BLOCK_ROWS);
+}
+
+
+CsvEvaluator::Stats CsvEvaluator::run(LineReader& in) {
+    auto start = std::chrono::steady_clock::now();
+    std::string_view line;
+    bool found = false;
+    while ((found = in.next(line)) && line.empty()) {
+    }
+    if (!found) throw std::runtime_error("CSV input has no header");
+    header(line);
+    out.append(line);
+    out += ',';
+    out += column_name;
+    out += '\n';
+
+    // 映射的文件中各行直接引用映射的内存；按块读取时行在下一次读取后失效，复制到 text
+    const bool copy = !in.mapped();
+    if (copy) text.reserve(BLOCK_BYTES);
+    while (in.next(line)) {
+        if (line.empty()) continue;
+        if (copy) {
+            // 容量不够时先处理当前块，保证已复制的行不因扩容而移动
+            if (text.size() + line.size() > text.capacity()) {
+                evaluate_block();
+                text.reserve(line.size());
+            }
+            size_t at = text.size();
+            text += line;
+            line = std::string_view(text).substr(at);
+        }
+        size_t row = rows.size();
+        rows.push_back(line);
+        parse_row(line, row);
+        if (rows.size() == BLOCK_ROWS) evaluate_block();
+    }
+    evaluate_block();
+    flush();
+    std::fflush(sink);
+    counters.bytes = in.bytes();
+    counters.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return counters;
+}
+
+
+// 表头：找出公式读取的列；既不是列名也没有定义的变量无法求值
+void CsvEvaluator::header(std::string_view line) {
+    size_t pos = 0;
+    std::string_view field;
+    while (pos <= line.size()) {
+        if (!next_field(line, pos, field)) throw std::invalid_argument("Unterminated quoted field in CSV header");
+        std::string_view name = trim(field);
+        size_t index = NO_COLUMN;
+        bool read = std::find(reads.begin(), reads.end(), name) != reads.end();
+        bool seen = std::any_of(columns.begin(), columns.end(), [&](const Column& c) { return c.name == name; });
+        if (read && !seen) {
+            index = columns.size();
+            columns.push_back({ std::string(name), std::vector<double>(BLOCK_ROWS) });
+        }
+        field_column.push_back(index);
+    }
+    header_fields = field_column.size();
+    for (const std::string& name : reads) {
+        bool column = std::any_of(columns.begin(), columns.end(), [&](const Column& c) { return c.name == name; });
+        if (!column && !eval.findVariable(name)) throw std::invalid_argument("Unknown column or variable: " + name);
+    }
+    // 只需扫描到最后一个读取的字段
+    while (!field_column.empty() && field_column.back() == NO_COLUMN) field_column.pop_back();
+}
+
+
+// 只扫描读取的字段，直接从行的字节解析为数值写入各列的缓冲区
+void CsvEvaluator::parse_row(std::string_view line, size_t row) {
+    size_t parsed = 0;
+    size_t pos = 0;
+    std::string_view field;
+    size_t fields = 0;
+    for (; fields < field_column.size() && pos <= line.size(); ++fields) {
+        bool closed = next_field(line, pos, field);
+        size_t c = field_column[fields];
+        if (c != NO_COLUMN && closed && parse_number(field, columns[c].values[row])) ++parsed;
+    }
+    bad[row] = parsed != columns.size();
+    // 其余字段只数到表头的宽度为止，用来发现比表头短的行
+    for (; fields < header_fields && pos <= line.size(); ++fields) next_field(line, pos, field);
+    missing[row] = static_cast<uint32_t>(header_fields - fields);
+    // 比表头长的行只输出表头宽度的字段（去掉多出的字段和它们之前的逗号），结果仍在最后一列
+    if (pos <= line.size()) rows[row] = line.substr(0, pos - 1);
+}
+
+
+// 对当前块求值，把各行原文与结果追加到输出并写出
+void CsvEvaluator::evaluate_block() {
+    const size_t n = rows.size();
+    if (n == 0) return;
+    std::vector<BatchColumn> inputs;
+    inputs.reserve(columns.size());
+    for (const Column& c : columns) inputs.push_back({ c.name, std::span<const double>(c.values.data(), n) });
+    std::span<double> result(results.data(), n);
+    std::span<uint8_t> error(errors.data(), n);
+    if (parallel) parallel->evaluate(code, eval, inputs, result, error);
+    else eval_batch(code, eval, inputs, result, error);
+
+    for (size_t i = 0; i < n; ++i) {
+        out += rows[i];
+        out.append(missing[i] + 1, ',');
+        if (bad[i] || errors[i]) ++counters.error_rows;
+        else Printer(out).number(results[i]);
+        out += '\n';
+    }
+    counters.rows += n;
+    rows.clear();
+    text.clear();
+    flush();
+}
+
+
+void CsvEvaluator::flush() {
+    if (out.empty()) return;
+    size_t written = std::fwrite(out.data(), 1, out.size(), sink);
+    bool failed = written != out.size();
+    out.clear();
+    if (failed) throw std::runtime_error("Failed to write output");
+}
+
+
+std::string CsvEvaluator::summary(const Stats& s) {
+    double seconds = s.seconds > 0.0 ? s.seconds : 1e-9;
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+        "%llu rows, %llu error rows, %.2f MB in %.3f s (%.0f rows/s, %.1f MB/s, %u threads)",
+        static_cast<unsigned long long>(s.rows), static_cast<unsigned long long>(s.error_rows), s.bytes / 1e6,
+        s.seconds, s.rows / seconds, s.bytes / 1e6 / seconds, s.threads);
+    return buf;
+}
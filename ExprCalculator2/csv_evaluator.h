@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compiled_expr.h"
+#include "evaluator.h"
+#include "parallel_eval.h"
+#include "parse_result.h"
+
+class LineReader;
+
+// 对 CSV 的每一行求同一个公式，结果作为新的一列追加在行尾写出：
+//   expr_calculator --csv data.csv --expr "price * qty * (1 - disc)"
+// 表头中的列名即变量名，只解析公式读取的列：字段直接从读入的字节（普通文件为 mmap，行不复制）扫描为数值，
+// 写入按列连续的缓冲区后交给 eval_batch（多线程时为 ParallelEvaluator）按块求值，不为每行构造字符串。
+// 每块（BLOCK_ROWS 行）求值并写出后再读下一块，内存占用与文件大小无关。
+// 公式读取的变量既不是列名也未在 eval 中定义时抛出 std::invalid_argument；
+// 字段为空或不是数值、求值出错（除零等）的行，结果列留空并计入 error_rows。
+// 字段比表头少的行在结果列之前补上空字段，比表头多的行截去多出的字段，使结果总在表头的最后一列之后；缺少的字段按空字段处理。
+// 字段可以加引号，但不能跨行
+class CsvEvaluator {
+public:
+    struct Stats {
+        uint64_t rows = 0;
+        uint64_t error_rows = 0;
+        uint64_t bytes = 0;
+        double seconds = 0.0;
+        unsigned threads = 1;
+    };
+
+    // threads 为 0 时使用全部硬件线程
+    CsvEvaluator(Evaluator& eval, std::string_view expr, std::FILE* out, unsigned threads = 1,
+        std::string column = "result");
+    CsvEvaluator(const CsvEvaluator&) = delete;
+    CsvEvaluator& operator=(const CsvEvaluator&) = delete;
+
+    // 读取表头与全部行，返回后输出已全部写出；写出失败时抛出 std::runtime_error
+    Stats run(LineReader& in);
+
+    static std::string summary(const Stats& s);
+private:
+    static constexpr size_t BLOCK_ROWS = 16384;
+    static constexpr size_t BLOCK_BYTES = 4u << 20;
+    static constexpr size_t NO_COLUMN = SIZE_MAX;
+
+    // 公式读取的一列
+    struct Column {
+        std::string name;
+        std::vector<double> values; // 当前块，按行
+    };
+
+    Evaluator& eval;
+    ParseResult expr;
+    CompiledExpr code;
+    std::vector<std::string> reads; // 公式读取的变量名
+    std::unique_ptr<ParallelEvaluator> parallel;
+    std::FILE* sink;
+    std::string column_name;
+
+    std::vector<Column> columns;
+    std::vector<size_t> field_column; // 按字段序号：对应 columns 的下标，未读取的字段为 NO_COLUMN
+    size_t header_fields = 0;
+
+    // 当前块
+    std::string text;                   // 按块读取时复制的各行原文
+    std::vector<std::string_view> rows; // 各行原文（映射的文件中直接指向映射的内存），比表头长的行截到表头的宽度
+    std::vector<uint8_t> bad; // 字段缺失或不是数值
+    std::vector<uint32_t> missing; // 比表头少的字段数，输出时补上空字段
+    std::vector<uint8_t> errors;
+    std::vector<double> results;
+    std::string out;
+    Stats counters;
+
+    void header(std::string_view line);
+    void parse_row(std::string_view line, size_t row);
+    void evaluate_block();
+    void flush();
+};
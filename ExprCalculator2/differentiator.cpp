@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "differentiator.h"
+#include "expr_dag.h"
+#include "number_expr.h"
+
+namespace {
+
+bool is_one(const Expr* e) {
+    auto num = dynamic_cast<const NumberExpr*>(e);
+    return num && num->val == 1.0;
+}
+
+} // namespace
+
+const Expr* Differentiator::run(const Expr* root) {
+    const Expr* result = derive(root);
+    for (std::string_view name : assigned) {
+        if (std::find(read.begin(), read.end(), name) != read.end()) {
+            throw std::invalid_argument("Cannot differentiate " + std::string(name)
+                + " symbolically: it is assigned and read in the same expression; use gradient() instead");
+        }
+    }
+    return result;
+}
+
+
+const Expr* Differentiator::derive(const Expr* e) {
+    auto it = done.find(e);
+    if (it != done.end()) return it->second;
+    const Expr* d = e->derive(*this);
+    done.emplace(e, d);
+    return d;
+}
+
+
+bool Differentiator::is_zero(const Expr* e) {
+    auto num = dynamic_cast<const NumberExpr*>(e);
+    return num && num->val == 0.0;
+}
+
+
+const Expr* Differentiator::number(double v) {
+    return out.number(v);
+}
+
+
+const Expr* Differentiator::add(const Expr* l, const Expr* r) {
+    if (is_zero(l)) return r;
+    if (is_zero(r)) return l;
+    return out.binary(l, TokenType::PLUS, r);
+}
+
+
+const Expr* Differentiator::sub(const Expr* l, const Expr* r) {
+    if (is_zero(r)) return l;
+    if (is_zero(l)) return neg(r);
+    return out.binary(l, TokenType::MINUS, r);
+}
+
+
+const Expr* Differentiator::mul(const Expr* l, const Expr* r) {
+    if (is_zero(l) || is_zero(r)) return number(0.0);
+    if (is_one(l)) return r;
+    if (is_one(r)) return l;
+    return out.binary(l, TokenType::STAR, r);
+}
+
+
+const Expr* Differentiator::div(const Expr* l, const Expr* r) {
+    if (is_zero(l)) return l;
+    if (is_one(r)) return l;
+    return out.binary(l, TokenType::SLASH, r);
+}
+
+
+const Expr* Differentiator::neg(const Expr* e) {
+    if (is_zero(e)) return e;
+    return out.unary(TokenType::MINUS, e);
+}
+
+
+const Expr* Differentiator::binary(const Expr* l, TokenType op, const Expr* r) {
+    return out.binary(l, op, r);
+}
+
+
+const Expr* Differentiator::call(std::string_view name, const Expr* arg) {
+    const Expr* args[] = { arg };
+    return out.call(name, args);
+}
+
+
+const Expr* Differentiator::power(const Expr* node, const Expr* base, const Expr* exponent) {
+    const Expr* db = derive(base);
+    const Expr* de = derive(exponent);
+    // 指数与变量无关：e * b ^ (e - 1) * b'
+    if (is_zero(de)) {
+        if (is_zero(db)) return db;
+        return mul(mul(exponent, binary(base, TokenType::POW, sub(exponent, number(1.0)))), db);
+    }
+    // 一般情形：b ^ e * (e' * ln(b) + e * b' / b)
+    return mul(node, add(mul(de, call("ln", base)), div(mul(exponent, db), base)));
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "expr.h"
+#include "token_type.h"
+
+class ExprDag;
+
+// 符号求导：在 dag 中构造 d(e)/d(variable)，结果交给 ExprDag::simplify 化简（见 ParseResult::diff）。
+// 各节点的求导规则在其 derive() 中；共享的子表达式只求导一次。
+// 比较、逻辑运算的导数为 0，条件表达式对两个分支分别求导；赋值的导数是右侧的导数。
+// 同一个表达式中既赋值又读取的变量（之后的读取依赖赋值）不能符号求导，应改用 gradient()。
+// 用户函数需先内联（化简时给出函数表），未能内联的调用与函数定义不能求导（std::invalid_argument）
+class Differentiator {
+    ExprDag& out;
+    std::string_view var;
+    std::unordered_map<const Expr*, const Expr*> done;
+    std::vector<std::string_view> assigned;
+    std::vector<std::string_view> read;
+public:
+    Differentiator(ExprDag& dag, std::string_view variable) : out(dag), var(variable) {}
+
+    // 对整个表达式求导；不能求导时抛出 std::invalid_argument
+    const Expr* run(const Expr* root);
+    // 子表达式的导数（供各节点的 derive 使用）
+    const Expr* derive(const Expr* e);
+    // 记录赋值与读取的变量
+    void note_assign(std::string_view name) { assigned.push_back(name); }
+    void note_read(std::string_view name) { read.push_back(name); }
+
+    ExprDag& dag() { return out; }
+    std::string_view variable() const { return var; }
+
+    // 构造辅助：常数 0、1 参与时直接省去
+    static bool is_zero(const Expr* e);
+    const Expr* number(double v);
+    const Expr* add(const Expr* l, const Expr* r);
+    const Expr* sub(const Expr* l, const Expr* r);
+    const Expr* mul(const Expr* l, const Expr* r);
+    const Expr* div(const Expr* l, const Expr* r);
+    const Expr* neg(const Expr* e);
+    const Expr* binary(const Expr* l, TokenType op, const Expr* r);
+    const Expr* call(std::string_view name, const Expr* arg);
+
+    // node = base ^ exponent（运算符 ^ 与 pow 共用）
+    const Expr* power(const Expr* node, const Expr* base, const Expr* exponent);
+};
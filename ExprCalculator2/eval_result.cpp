@@ -0,0 +1,40 @@
+#include <stdexcept>
+
+#include "eval_result.h"
+#include "exprs.h"
+#include "function_registry.h"
+
+std::string EvalError::message() const {
+    switch (code) {
+    case EvalErrc::NONE: return {};
+    case EvalErrc::DIVISION_BY_ZERO: return "Division by zero";
+    case EvalErrc::MODULO_BY_ZERO: return "Modulo by zero";
+    case EvalErrc::UNDEFINED_VARIABLE:
+        if (dynamic_cast<const ConditionalExpr*>(node)) return "Cannot evaluate conditional with undefined variables";
+        if (dynamic_cast<const AssignExpr*>(node)) return "Cannot assign undefined variable";
+        if (dynamic_cast<const CallExpr*>(node)) return "Cannot evaluate function with undefined variables";
+        return "Cannot evaluate expression with undefined variables";
+    case EvalErrc::UNDEFINED_FUNCTION:
+        return "Undefined function: " + std::string(static_cast<const CallExpr*>(node)->get_name());
+    case EvalErrc::BAD_ARITY:
+        return arity_message(static_cast<const CallExpr*>(node)->get_name(), min_args, max_args);
+    case EvalErrc::UNHANDLED_OPERATOR:
+        if (dynamic_cast<const UnaryExpr*>(node)) return "Unhandled unary operator";
+        return "Unhandled binary operator";
+    case EvalErrc::CALL_DEPTH_EXCEEDED:
+        return call_depth_message(static_cast<const CallExpr*>(node)->get_name());
+    case EvalErrc::BUILTIN_REDEFINED:
+        return "Cannot redefine builtin function " + std::string(static_cast<const FunctionDefExpr*>(node)->get_name());
+    case EvalErrc::CYCLIC_BINDING: {
+        if (auto def = dynamic_cast<const FunctionDefExpr*>(node))
+            return "Cyclic reactive binding: redefining " + std::string(def->get_name()) + " would make a binding depend on itself";
+        std::string name(static_cast<const ReactiveAssignExpr*>(node)->get_name());
+        return "Cyclic reactive binding: " + name + " would depend on itself";
+    }
+    }
+    return "Unknown evaluation error";
+}
+
+void EvalResult::raise() const {
+    throw std::runtime_error(error().message());
+}
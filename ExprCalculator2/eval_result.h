@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "value.h"
+
+class Expr;
+
+// 求值错误的种类（与 batch_eval.h 中的 BatchError 对应）
+enum class EvalErrc : uint8_t {
+    NONE,
+    DIVISION_BY_ZERO,
+    MODULO_BY_ZERO,
+    UNDEFINED_VARIABLE, // 运算数、条件、赋值的值或函数参数为未定义变量
+    UNDEFINED_FUNCTION,
+    BAD_ARITY,
+    UNHANDLED_OPERATOR,
+    CALL_DEPTH_EXCEEDED, // 用户函数嵌套调用超过 Evaluator::MAX_CALL_DEPTH 层
+    BUILTIN_REDEFINED,   // 定义与内置函数同名的用户函数
+    CYCLIC_BINDING,      // 响应式绑定（或重新定义公式调用的函数）会形成循环依赖
+};
+
+struct EvalError {
+    EvalErrc code;
+    const Expr* node; // 出错的节点
+    uint8_t min_args = 0; // BAD_ARITY：函数接受的参数个数（见 Function）
+    uint8_t max_args = 0;
+
+    // 与抛出的异常相同的错误信息
+    std::string message() const;
+};
+
+// expected 风格的求值结果：成功时为 Value，失败时为 EvalError，出错路径上不抛异常。
+// 与 Value 一样占 16 字节、可平凡复制（按值返回时放在寄存器中）：
+// 出错时 Value 的存储改放错误，num 的位置存出错的节点，sym 的低 8 位存错误码、其上两个字节存参数个数，type 为 ERROR_TAG
+class EvalResult {
+    Value val;
+    static constexpr auto ERROR_TAG = static_cast<Value::Type>(0xFF);
+
+    [[noreturn]] void raise() const;
+public:
+    EvalResult(Value v) : val(v) {}
+    EvalResult(EvalError e) {
+        std::memcpy(&val.num, &e.node, sizeof(e.node));
+        val.sym = static_cast<uint32_t>(e.code) | uint32_t(e.min_args) << 8 | uint32_t(e.max_args) << 16;
+        val.type = ERROR_TAG;
+    }
+
+    bool has_value() const { return val.type != ERROR_TAG; }
+    explicit operator bool() const { return has_value(); }
+    // 失败时抛出 std::runtime_error（信息同 EvalError::message）
+    Value value() const {
+        if (!has_value()) raise();
+        return val;
+    }
+    // 只能在 has_value() 时使用
+    const Value& operator*() const { return val; }
+    const Value* operator->() const { return &val; }
+    EvalError error() const {
+        if (has_value()) return { EvalErrc::NONE, nullptr };
+        const Expr* node;
+        std::memcpy(&node, &val.num, sizeof(node));
+        return { static_cast<EvalErrc>(val.sym & 0xFF), node, static_cast<uint8_t>(val.sym >> 8),
+            static_cast<uint8_t>(val.sym >> 16) };
+    }
+};
+
+static_assert(sizeof(const Expr*) <= sizeof(double), "EvalResult stores the node pointer in place of the number");
+static_assert(sizeof(EvalResult) == sizeof(Value), "EvalResult should be returned in registers");
+static_assert(std::is_trivially_copyable_v<EvalResult>);
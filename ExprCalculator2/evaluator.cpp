@@ -1,36 +1,64 @@
 #include "evaluator.h"
+#include "user_function.h"
 
 void Evaluator::initConstants() {
-    variables["pi"] = M_PI;
-    variables["e"] = M_E;
-}
-
-void Evaluator::initFunctions() {
-    builtin_funcs["sin"] = [](double x) { return std::sin(x); };
-    builtin_funcs["cos"] = [](double x) { return std::cos(x); };
-    builtin_funcs["tan"] = [](double x) { return std::tan(x); };
-    builtin_funcs["sqrt"] = [](double x) { return std::sqrt(x); };
-    builtin_funcs["abs"] = [](double x) { return std::abs(x); };
-    builtin_funcs["log"] = [](double x) { return std::log10(x); };
-    builtin_funcs["ln"] = [](double x) { return std::log(x); };
-    builtin_funcs["exp"] = [](double x) { return std::exp(x); };
+    setVariable("pi", M_PI);
+    setVariable("e", M_E);
 }
 
 Evaluator::Evaluator() {
     initConstants();
-    initFunctions();
 }
 
-double Evaluator::getVariable(const std::string& name) const {
-    auto it = variables.find(name);
-    if (it == variables.end()) throw std::runtime_error("Undefined variable: " + name);
-    return it->second;
+VarSlot Evaluator::bind(std::string_view name) {
+    auto it = slot_index.find(name);
+    if (it != slot_index.end()) return { it->second };
+    uint32_t index = static_cast<uint32_t>(values.size());
+    slot_index.emplace(name, index);
+    slot_names.emplace_back(name);
+    values.push_back(0.0);
+    defined.push_back(0);
+    return { index };
 }
 
-void Evaluator::setVariable(const std::string& name, double value) {
-    variables[name] = value;
+const double* Evaluator::findVariable(std::string_view name) const {
+    auto it = slot_index.find(name);
+    if (it == slot_index.end() || !defined[it->second]) return nullptr;
+    return &values[it->second];
 }
 
-Value Evaluator::evaluate(const Expr* expr) {
-    return expr->evaluate(*this);
-}
\ No newline at end of file
+double Evaluator::getVariable(std::string_view name) const {
+    const double* v = findVariable(name);
+    if (!v) throw std::runtime_error("Undefined variable: " + std::string(name));
+    return *v;
+}
+
+void Evaluator::setVariable(std::string_view name, double value) {
+    set(bind(name), value);
+}
+
+bool Evaluator::define_reactive(std::string_view name, const Expr* formula) {
+    return reactive.define(*this, bind(name).index, formula);
+}
+
+bool Evaluator::define_function(std::string_view name, std::span<const std::string_view> params, const Expr* body) {
+    if (FunctionRegistry::builtins().find(name))
+        throw std::invalid_argument("Cannot redefine builtin function " + std::string(name));
+    std::shared_ptr<const Function> old = functions.share(name);
+    functions.define(std::make_shared<const UserFunction>(name, params, body, *this));
+    // 调用它的响应式公式重新收集依赖；不能接受时恢复原来的函数
+    auto undo = [&] {
+        if (old) functions.restore(std::move(old));
+        else functions.remove(name);
+    };
+    bool ok;
+    try {
+        ok = reactive.redefined(*this, name);
+    }
+    catch (...) {
+        undo();
+        throw;
+    }
+    if (!ok) undo();
+    return ok;
+}
@@ -1,26 +1,88 @@
 #pragma once
 
 #include <unordered_map>
+#include <vector>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <functional>
+#include <span>
 #include <stdexcept>
+#include <cmath>
 
 #include "value.h"
 #include "expr.h"
 #include "constants.h"
+#include "function_registry.h"
+#include "reactive_graph.h"
+#include "string_map.h"
+
+// 变量槽句柄：由 Evaluator::bind 返回，在该 Evaluator（及其副本）的生命周期内保持有效
+struct VarSlot {
+    uint32_t index = 0;
+};
 
 
 class Evaluator {
+    // 变量按槽存放，名字只在绑定时哈希一次；值连续存放，可直接交给 JIT 代码读取
+    StringMap<uint32_t> slot_index;
+    std::vector<std::string> slot_names;
+    std::vector<double> values;
+    std::vector<uint8_t> defined;
+
+    // 正在执行的用户函数的参数值与嵌套深度（由 CallFrame 设置）
+    const double* param_values = nullptr;
+    uint32_t call_depth = 0;
+    friend class CallFrame;
+
+    // 响应式绑定（b := ...）；重新计算时直接写入 values 与 defined
+    ReactiveGraph reactive;
+    friend class ReactiveGraph;
+
     void initConstants();
-    void initFunctions();
 public:
-    std::unordered_map<std::string, double> variables;
-    std::unordered_map<std::string, std::function<double(double)>> builtin_funcs;
+    static constexpr uint32_t MAX_CALL_DEPTH = 512;
+
+    // 可调用的函数（初始为内置函数），也可以注册自定义函数
+    FunctionRegistry functions = FunctionRegistry::with_builtins();
 
     Evaluator();
 
-    double getVariable(const std::string& name) const;
-    void setVariable(const std::string& name, double value);
+    // 按名字访问（REPL 使用）
+    double getVariable(std::string_view name) const;
+    void setVariable(std::string_view name, double value);
+    // 已定义时返回值的地址，否则返回 nullptr
+    const double* findVariable(std::string_view name) const;
+
+    // 按槽访问：bind 为名字分配（或返回已有的）槽，新槽在赋值前处于未定义状态。
+    // set 赋值后更新读取该变量的响应式公式；对绑定的变量赋值会解除其绑定
+    VarSlot bind(std::string_view name);
+    void set(VarSlot slot, double value) {
+        values[slot.index] = value;
+        defined[slot.index] = 1;
+        if (reactive.watched(slot.index)) [[unlikely]] reactive.assigned(*this, slot.index);
+    }
+    double get(VarSlot slot) const { return values[slot.index]; }
+    bool is_defined(VarSlot slot) const { return defined[slot.index] != 0; }
+    const std::string& name_of(VarSlot slot) const { return slot_names[slot.index]; }
+    size_t slot_count() const { return values.size(); }
+    // 按槽下标排列的变量值（未定义的槽为 0），bind 新槽后地址可能变化
+    const double* slot_values() const { return values.data(); }
+
+    // 定义（或替换）用户函数 name(params) = body，函数体会被复制；name 为内置函数时抛出 std::invalid_argument。
+    // 调用它的响应式公式随之重新计算；这会使绑定形成循环时不做任何修改并返回 false
+    bool define_function(std::string_view name, std::span<const std::string_view> params, const Expr* body);
+    // 响应式绑定 name := formula（公式会被复制）并立即计算：之后 formula 读取的变量变化时自动重新计算 name。
+    // 会形成循环依赖时不做任何修改并返回 false；公式中有赋值时抛出 std::invalid_argument
+    bool define_reactive(std::string_view name, const Expr* formula);
+    const ReactiveGraph& bindings() const { return reactive; }
+    // 当前用户函数的第 index 个参数（只在函数体求值期间有效）
+    double param(uint32_t index) const { return param_values[index]; }
+    // 用户函数的嵌套调用层数
+    uint32_t depth() const { return call_depth; }
 
-    Value evaluate(const Expr* expr);
+    // 出错时返回 EvalError（见 eval_result.h）
+    EvalResult try_evaluate(const Expr* expr) { return expr->try_evaluate(*this); }
+    // 出错时抛出 std::runtime_error
+    Value evaluate(const Expr* expr) { return try_evaluate(expr).value(); }
 };
\ No newline at end of file
@@ -1,14 +1,39 @@
 #pragma once
 
-#include <memory>
+#include <cstdint>
+#include <string>
 
 #include "value.h"
+#include "eval_result.h"
+#include "arena.h"
 
+// AST 节点全部分配在 Arena 中，子节点用裸指针引用，随 Arena 一起释放。
+// 析构函数非虚且平凡，派生类不得持有需要析构的成员（名字用 Arena::copy 得到的 string_view）。
 class Expr {
+    friend class ExprDag;
+    bool shared = false; // 由 ExprDag 设置：该节点被不止一处引用
+    bool stable = false; // 由 ExprDag 设置：化简结果就是自身
+    uint32_t serial = 0; // 由 ExprDag 设置：在 dag 中的构造序号
+protected:
+    ~Expr() = default;
 public:
-    virtual ~Expr() = default;
-    virtual Value evaluate(class Evaluator& eval) const = 0;
-    virtual std::unique_ptr<Expr> simplify() const = 0;
-    // 生成符号表达式字符串
-    virtual std::string to_string() const = 0;
+    bool is_shared() const { return shared; }
+    uint32_t dag_serial() const { return serial; }
+
+    // 求值；出错时返回错误码与出错的节点，不抛异常
+    virtual EvalResult try_evaluate(class Evaluator& eval) const = 0;
+    // 出错时抛出 std::runtime_error
+    Value evaluate(class Evaluator& eval) const { return try_evaluate(eval).value(); }
+    // 在 dag 中构造化简后的表达式（结果中相同的子树共享）；没有可化简之处时返回 dag 中与自身相同的节点。
+    // 子节点通过 ExprDag::simplify 化简，以便跳过已经化简到不动点的子树
+    virtual const Expr* simplify(class ExprDag& dag) const = 0;
+    // 以最少的括号输出符号表达式（见 printer.h）
+    virtual void print(class Printer& p) const = 0;
+    std::string to_string() const;
+    // 生成字节码（见 compiled_expr.h）
+    virtual void compile(class Compiler& c) const = 0;
+    // 在 dag 中构造结构相同的共享版本（见 expr_dag.h）
+    virtual const Expr* share(class ExprDag& dag) const = 0;
+    // 对 d.variable() 求导，结果构造在 d.dag() 中（见 differentiator.h）
+    virtual const Expr* derive(class Differentiator& d) const = 0;
 };
\ No newline at end of file
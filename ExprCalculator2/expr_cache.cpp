@@ -0,0 +1,116 @@
+#include <iterator>
+
+#include "expr_cache.h"
+#include "lexer.h"
+#include "parser.h"
+#include "function_registry.h"
+
+ExprCache::ExprCache(size_t bytes, size_t entries) : max_bytes(bytes), max_entries(entries) {}
+
+std::string ExprCache::normalize(std::string_view source) {
+    std::string key;
+    key.reserve(source.size());
+    Lexer lexer(source);
+    for (;;) {
+        Token t = lexer.nextToken();
+        if (t.type == TokenType::END) break;
+        if (t.type == TokenType::ERROR) return std::string(source);
+        if (!key.empty()) key += ' ';
+        key += t.lexeme;
+    }
+    return key;
+}
+
+ExprCache::Entry ExprCache::touch(List::iterator it) {
+    lru.splice(lru.begin(), lru, it);
+    return it->value;
+}
+
+void ExprCache::addSpelling(List::iterator it, std::string_view spelling) {
+    if (it->keys.size() > MAX_SPELLINGS || index.find(spelling) != index.end()) return;
+    it->keys.emplace_back(spelling);
+    index.emplace(it->keys.back(), it);
+    it->bytes += spelling.size();
+    counters.bytes += spelling.size();
+}
+
+void ExprCache::erase(List::iterator it) {
+    counters.bytes -= it->bytes;
+    --counters.entries;
+    for (const auto& key : it->keys) index.erase(key);
+    lru.erase(it);
+}
+
+ExprCache::Entry ExprCache::get(std::string_view source, const FunctionRegistry* functions) {
+    // 函数表变化后，按旧定义内联或折叠的项直接丢弃
+    uint64_t version = functions ? functions->version() : 0;
+    {
+        std::lock_guard<std::mutex> lock(m);
+        auto it = index.find(source);
+        if (it != index.end()) {
+            if (it->second->version == version) {
+                ++counters.hits;
+                return touch(it->second);
+            }
+            erase(it->second);
+        }
+    }
+
+    std::string key = normalize(source);
+    {
+        std::lock_guard<std::mutex> lock(m);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            if (it->second->version == version) {
+                ++counters.hits;
+                addSpelling(it->second, source);
+                return touch(it->second);
+            }
+            erase(it->second);
+        }
+        ++counters.misses;
+    }
+
+    // 在锁外解析，避免不同公式的解析互相阻塞
+    auto value = std::make_shared<const ParseResult>(Parser(source).parse().simplify(functions));
+
+    std::lock_guard<std::mutex> lock(m);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        // 其他线程已经放入了同一个公式
+        if (it->second->version == version) {
+            addSpelling(it->second, source);
+            return touch(it->second);
+        }
+        erase(it->second);
+    }
+    size_t bytes = value->bytes_reserved() + key.size();
+    lru.push_front({ { std::move(key) }, value, bytes, version });
+    index.emplace(lru.front().keys[0], lru.begin());
+    counters.bytes += bytes;
+    ++counters.entries;
+    if (source != lru.front().keys[0]) addSpelling(lru.begin(), source);
+    evict();
+    return value;
+}
+
+void ExprCache::evict() {
+    // 至少保留刚放入的一项
+    while (lru.size() > 1 && (counters.bytes > max_bytes || (max_entries && lru.size() > max_entries))) {
+        ++counters.evictions;
+        erase(std::prev(lru.end()));
+    }
+}
+
+ExprCache::Stats ExprCache::stats() const {
+    std::lock_guard<std::mutex> lock(m);
+    return counters;
+}
+
+void ExprCache::clear() {
+    std::lock_guard<std::mutex> lock(m);
+    index.clear();
+    lru.clear();
+    counters.entries = 0;
+    counters.bytes = 0;
+}
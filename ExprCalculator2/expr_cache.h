@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "evaluator.h"
+#include "parse_result.h"
+
+// 解析 + 化简结果的 LRU 缓存，可在多个线程间共享。
+// 键为规范化后的源码（按词法单元重新拼接，忽略多余空白），因此 "x+1" 与 "x + 1" 命中同一项；
+// 每项还记录最多 MAX_SPELLINGS 种原始写法，原样重复的输入不必重新做词法分析即可命中。
+// 按 AST 占用的字节数（及可选的条目数）限制容量，超出时淘汰最久未使用的项。
+// 返回的 shared_ptr 在项被淘汰后仍然有效；解析或化简失败时抛出异常且不缓存。
+class ExprCache {
+public:
+    using Entry = std::shared_ptr<const ParseResult>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    // max_entries 为 0 表示只按字节数限制
+    explicit ExprCache(size_t max_bytes = 64u << 20, size_t max_entries = 0);
+
+    // 返回 source 化简后的 AST，未命中时解析并化简后放入缓存。
+    // 给出函数表时按它内联用户函数、折叠常数调用：缓存项记录函数表的版本，函数重新注册或删除后旧的化简结果不再命中
+    Entry get(std::string_view source, const FunctionRegistry* functions = nullptr);
+
+    Stats stats() const;
+    void clear();
+
+    // 规范化的缓存键；词法错误时原样返回（随后解析会报告该错误）
+    static std::string normalize(std::string_view source);
+private:
+    static constexpr size_t MAX_SPELLINGS = 4;
+
+    struct Item {
+        std::vector<std::string> keys; // keys[0] 为规范化的键，其余为原始写法
+        Entry value;
+        size_t bytes;
+        uint64_t version; // 化简时函数表的版本（FunctionRegistry::version）
+    };
+    using List = std::list<Item>;
+
+    mutable std::mutex m;
+    List lru; // 队首为最近使用
+    StringMap<List::iterator> index; // 所有键 → 项
+    size_t max_bytes;
+    size_t max_entries;
+    Stats counters;
+
+    Entry touch(List::iterator it);
+    void erase(List::iterator it);
+    void addSpelling(List::iterator it, std::string_view spelling);
+    void evict();
+};
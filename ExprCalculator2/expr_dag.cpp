@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+#include "expr_dag.h"
+#include "exprs.h"
+#include "function_registry.h"
+#include "user_function.h"
+
+namespace {
+
+size_t mix(size_t h, size_t v) {
+    return (h ^ v) * 0x9E3779B97F4A7C15ull + (h >> 29);
+}
+
+size_t ptr(const Expr* e) { return reinterpret_cast<size_t>(e); }
+
+constexpr size_t INITIAL_TABLE = 64;
+
+} // namespace
+
+bool ExprDag::matches(const Entry& entry, const Key& key) {
+    if (entry.kind != key.kind) return false;
+    const Expr* node = entry.node;
+    switch (key.kind) {
+    case Kind::NUMBER: {
+        uint64_t bits;
+        double v = static_cast<const NumberExpr*>(node)->val;
+        std::memcpy(&bits, &v, sizeof(v));
+        return bits == key.bits;
+    }
+    case Kind::VARIABLE:
+        return static_cast<const VariableExpr*>(node)->name == key.name;
+    case Kind::UNARY: {
+        auto u = static_cast<const UnaryExpr*>(node);
+        return u->op == key.op && u->operand == key.kids[0];
+    }
+    case Kind::BINARY: {
+        auto b = static_cast<const BinaryExpr*>(node);
+        return b->get_op() == key.op && b->get_lhs() == key.kids[0] && b->get_rhs() == key.kids[1];
+    }
+    case Kind::CONDITIONAL: {
+        auto c = static_cast<const ConditionalExpr*>(node);
+        return c->cond == key.kids[0] && c->true_expr == key.kids[1] && c->false_expr == key.kids[2];
+    }
+    case Kind::CALL: {
+        auto c = static_cast<const CallExpr*>(node);
+        return c->func_name == key.name && std::equal(c->args.begin(), c->args.end(), key.args.begin(), key.args.end());
+    }
+    case Kind::ASSIGN: {
+        auto a = static_cast<const AssignExpr*>(node);
+        return a->var_name == key.name && a->value == key.kids[0];
+    }
+    case Kind::REACTIVE: {
+        auto r = static_cast<const ReactiveAssignExpr*>(node);
+        return r->var_name == key.name && r->formula == key.kids[0];
+    }
+    case Kind::PARAM: {
+        auto p = static_cast<const ParamExpr*>(node);
+        return p->index == key.bits && p->name == key.name;
+    }
+    case Kind::DEFINE: {
+        auto d = static_cast<const FunctionDefExpr*>(node);
+        return d->func_name == key.name && d->body == key.kids[0] &&
+            std::equal(d->params.begin(), d->params.end(), key.params.begin(), key.params.end());
+    }
+    }
+    return false;
+}
+
+size_t ExprDag::hash(const Key& key) {
+    size_t h = static_cast<size_t>(key.kind) * 31 + static_cast<size_t>(key.op);
+    h = mix(h, static_cast<size_t>(key.bits));
+    if (!key.name.empty()) h = mix(h, std::hash<std::string_view>{}(key.name));
+    for (const Expr* kid : key.kids) h = mix(h, ptr(kid));
+    for (const Expr* arg : key.args) h = mix(h, ptr(arg));
+    for (std::string_view p : key.params) h = mix(h, std::hash<std::string_view>{}(p));
+    // 乘法只向高位扩散，取低位做下标前再混合一次
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return h;
+}
+
+uint32_t ExprDag::shape_hash(const Key& key) const {
+    size_t h = static_cast<size_t>(key.kind) * 31 + static_cast<size_t>(key.op);
+    h = mix(h, static_cast<size_t>(key.bits));
+    if (!key.name.empty()) h = mix(h, std::hash<std::string_view>{}(key.name));
+    for (const Expr* kid : key.kids) h = mix(h, kid ? shape(kid) : 0);
+    for (const Expr* arg : key.args) h = mix(h, shape(arg));
+    for (std::string_view p : key.params) h = mix(h, std::hash<std::string_view>{}(p));
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    return static_cast<uint32_t>(h);
+}
+
+bool ExprDag::key_effects(const Key& key) const {
+    if (key.kind == Kind::ASSIGN || key.kind == Kind::DEFINE || key.kind == Kind::REACTIVE) return true;
+    if (key.kind == Kind::CALL && key.name != defining) {
+        const Function* fn = function_table().find(key.name);
+        if (!fn || !fn->pure()) return true;
+    }
+    for (const Expr* kid : key.kids) {
+        if (kid && has_effects(kid)) return true;
+    }
+    for (const Expr* arg : key.args) {
+        if (has_effects(arg)) return true;
+    }
+    return false;
+}
+
+ExprDag::ExprDag(Arena& arena, bool reuse_input, const FunctionRegistry* functions)
+    : nodes(arena), table(INITIAL_TABLE), reuse_input(reuse_input), functions(functions) {}
+
+void ExprDag::grow() {
+    std::vector<Entry> old(table.size() * 2);
+    old.swap(table);
+    size_t mask = table.size() - 1;
+    for (auto& e : old) {
+        if (!e.node) continue;
+        size_t i = e.hash & mask;
+        while (table[i].node) i = (i + 1) & mask;
+        table[i] = e;
+    }
+}
+
+template <class Make>
+const Expr* ExprDag::intern(const Key& key, const Expr* existing, Make&& make) {
+    ++lookups;
+    uint32_t h = static_cast<uint32_t>(hash(key));
+    size_t mask = table.size() - 1;
+    size_t i = h & mask;
+    for (; table[i].node; i = (i + 1) & mask) {
+        if (table[i].hash == h && matches(table[i], key)) {
+            // 节点由本 dag 构造或收入，标记不影响其值；重新化简同一个节点不算共享
+            if (track_sharing && table[i].node != existing) const_cast<Expr*>(table[i].node)->shared = true;
+            return table[i].node;
+        }
+    }
+    // 新节点：原地化简时直接收入结构相同的原节点，否则在 arena 中构造（名字与参数在 make 中复制进 arena）
+    bool adopt = existing && reuse_input && matches({ existing, h, key.kind }, key);
+    const Expr* node = adopt ? existing : make();
+    auto mutable_node = const_cast<Expr*>(node);
+    mutable_node->serial = static_cast<uint32_t>(count);
+    mutable_node->shared = false;
+    mutable_node->stable = false;
+    by_serial.push_back(node);
+    shapes.push_back(shape_hash(key));
+    effects.push_back(key_effects(key));
+    if (!binding.empty() && key.kind == Kind::CALL && std::find(called.begin(), called.end(), key.name) == called.end())
+        called.push_back(static_cast<const CallExpr*>(node)->func_name);
+    table[i] = { node, h, key.kind };
+    if (++count * 2 > table.size()) grow();
+    return node;
+}
+
+const Expr* ExprDag::simplify(const Expr* e) {
+    if (e->stable && owns(e)) return e;
+    const Expr* result = e->simplify(*this);
+    if (result == e && owns(e)) const_cast<Expr*>(e)->stable = true;
+    return result;
+}
+
+const Expr* ExprDag::simplify_to_fixpoint(const Expr* root) {
+    const Expr* current = simplify(root);
+    // 之后的轮次主要是重新确认已有的节点，命中不再视为共享
+    track_sharing = false;
+    for (int pass = 1; pass < MAX_PASSES; ++pass) {
+        const Expr* next = simplify(current);
+        if (next == current) break;
+        current = next;
+    }
+    track_sharing = true;
+    return current;
+}
+
+const Expr* ExprDag::number(double value, const Expr* existing) {
+    Key key;
+    key.kind = Kind::NUMBER;
+    std::memcpy(&key.bits, &value, sizeof(value));
+    return intern(key, existing, [&] { return nodes.make<NumberExpr>(value); });
+}
+
+const Expr* ExprDag::variable(std::string_view name, const Expr* existing) {
+    for (size_t i = 0; i < binding.size(); ++i) {
+        if (binding[i] == name) return param(static_cast<uint32_t>(i), binding[i]);
+    }
+    Key key;
+    key.kind = Kind::VARIABLE;
+    key.name = name;
+    return intern(key, existing, [&] { return nodes.make<VariableExpr>(nodes.copy(name)); });
+}
+
+const Expr* ExprDag::unary(TokenType op, const Expr* operand, const Expr* existing) {
+    Key key;
+    key.kind = Kind::UNARY;
+    key.op = op;
+    key.kids[0] = operand;
+    return intern(key, existing, [&] { return nodes.make<UnaryExpr>(op, operand); });
+}
+
+const Expr* ExprDag::binary(const Expr* lhs, TokenType op, const Expr* rhs, const Expr* existing) {
+    Key key;
+    key.kind = Kind::BINARY;
+    key.op = op;
+    key.kids[0] = lhs;
+    key.kids[1] = rhs;
+    return intern(key, existing, [&] { return nodes.make<BinaryExpr>(lhs, op, rhs); });
+}
+
+const Expr* ExprDag::conditional(const Expr* cond, const Expr* t, const Expr* f, const Expr* existing) {
+    Key key;
+    key.kind = Kind::CONDITIONAL;
+    key.kids[0] = cond;
+    key.kids[1] = t;
+    key.kids[2] = f;
+    return intern(key, existing, [&] { return nodes.make<ConditionalExpr>(cond, t, f); });
+}
+
+const Expr* ExprDag::call(std::string_view name, std::span<const Expr* const> args, const Expr* existing) {
+    Key key;
+    key.kind = Kind::CALL;
+    key.name = name;
+    key.args = args;
+    return intern(key, existing, [&] { return nodes.make<CallExpr>(nodes.copy(name), nodes.copy(args)); });
+}
+
+const Expr* ExprDag::assign(std::string_view name, const Expr* value, const Expr* existing) {
+    Key key;
+    key.kind = Kind::ASSIGN;
+    key.name = name;
+    key.kids[0] = value;
+    return intern(key, existing, [&] { return nodes.make<AssignExpr>(nodes.copy(name), value); });
+}
+
+const Expr* ExprDag::reactive_assign(std::string_view name, const Expr* formula, const Expr* existing) {
+    Key key;
+    key.kind = Kind::REACTIVE;
+    key.name = name;
+    key.kids[0] = formula;
+    return intern(key, existing, [&] { return nodes.make<ReactiveAssignExpr>(nodes.copy(name), formula); });
+}
+
+const Expr* ExprDag::param(uint32_t index, std::string_view name, const Expr* existing) {
+    if (index < params_seen.size()) params_seen[index] = 1;
+    Key key;
+    key.kind = Kind::PARAM;
+    key.bits = index;
+    key.name = name;
+    return intern(key, existing, [&] { return nodes.make<ParamExpr>(index, nodes.copy(name)); });
+}
+
+const Expr* ExprDag::define(std::string_view name, std::span<const std::string_view> params, const Expr* body,
+    const Expr* existing) {
+    Key key;
+    key.kind = Kind::DEFINE;
+    key.name = name;
+    key.params = params;
+    key.kids[0] = body;
+    return intern(key, existing, [&] {
+        std::vector<std::string_view> copied;
+        copied.reserve(params.size());
+        for (std::string_view p : params) copied.push_back(nodes.copy(p));
+        return nodes.make<FunctionDefExpr>(nodes.copy(name), nodes.copy(std::span<const std::string_view>(copied)), body);
+    });
+}
+
+const FunctionRegistry& ExprDag::function_table() const {
+    return functions ? *functions : FunctionRegistry::builtins();
+}
+
+bool ExprDag::set_inlining(bool on) {
+    bool old = inlining;
+    inlining = on;
+    return old;
+}
+
+bool ExprDag::is_recursive(const UserFunction& fn) {
+    for (const auto& [checked, result] : recursion) {
+        if (checked == &fn) return result;
+    }
+    // 沿调用的函数名在当前函数表中搜索，能回到 fn 即为递归
+    std::vector<const UserFunction*> seen{ &fn };
+    std::vector<const UserFunction*> pending{ &fn };
+    bool result = false;
+    while (!pending.empty() && !result) {
+        const UserFunction* current = pending.back();
+        pending.pop_back();
+        for (const std::string& name : current->callees()) {
+            const Function* callee = function_table().find(name);
+            if (!callee || callee->kind != Function::Kind::USER) continue;
+            if (callee->user.get() == &fn) {
+                result = true;
+                break;
+            }
+            if (std::find(seen.begin(), seen.end(), callee->user.get()) == seen.end()) {
+                seen.push_back(callee->user.get());
+                pending.push_back(callee->user.get());
+            }
+        }
+    }
+    recursion.emplace_back(&fn, result);
+    return result;
+}
+
+const Expr* ExprDag::inline_call(const Function& fn, std::span<const Expr* const> args) {
+    if (!functions || !inlining || fn.kind != Function::Kind::USER) return nullptr;
+    const UserFunction& user = *fn.user;
+    if (user.size() > INLINE_MAX_NODES || !user.uses_all_params() || args.size() != user.params().size()) return nullptr;
+    for (const Expr* arg : args) {
+        if (has_effects(arg)) return nullptr;
+    }
+    if (is_recursive(user)) return nullptr;
+
+    // 先把函数体复制进本 dag（参数换成实参），再与周围一起化简
+    auto saved = substitution;
+    substitution = args;
+    const Expr* body = user.body()->share(*this);
+    substitution = saved;
+    return simplify(body);
+}
+
+const Expr* ExprDag::substitute(uint32_t index, std::string_view name) {
+    if (index < substitution.size()) return substitution[index];
+    return param(index, name);
+}
+
+const Expr* ExprDag::bind_params(const Expr* body, std::span<const std::string_view> params, std::string_view self) {
+    binding = params;
+    defining = self;
+    params_seen.assign(params.size(), 0);
+    called.clear();
+    const Expr* root = body->share(*this);
+    binding = {};
+    defining = {};
+    return root;
+}
+
+size_t ExprDag::params_used() const {
+    return static_cast<size_t>(std::count(params_seen.begin(), params_seen.end(), 1));
+}
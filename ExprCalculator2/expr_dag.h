@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "arena.h"
+#include "expr.h"
+#include "token_type.h"
+
+struct Function;
+class FunctionRegistry;
+class UserFunction;
+
+// 结构哈希（hash-consing）：在同一个 Arena 中，结构相同的子树只构造一次，AST 成为共享节点的 DAG。
+// 子节点已经是共享的，因此比较只需看运算符/名字/数值以及子节点指针，每次构造为 O(1)。
+// 共享的节点在 CompiledExpr 中只计算一次（见 Compiler::operand）。
+// reuse_input 为 true 时输入的节点就在同一个 arena 中（原地化简）：工厂方法的 existing 参数给出同类型的原节点，
+// 表中还没有相同结构的节点、而原节点的结构与请求相同时直接收入原节点，不再复制。
+// 给出函数表时，化简会把小的用户函数内联到调用处（见 inline_call），常数折叠也按该表判断函数是否为纯函数。
+class ExprDag {
+    enum class Kind : uint8_t { NUMBER, VARIABLE, UNARY, BINARY, CONDITIONAL, CALL, ASSIGN, PARAM, DEFINE, REACTIVE };
+
+    // 待查找的节点结构；只在查找期间存在于栈上
+    struct Key {
+        Kind kind = Kind::NUMBER;
+        TokenType op = TokenType::END;
+        uint64_t bits = 0; // 数值按位比较（-0.0 与 0.0 不同，NaN 彼此相同）
+        std::string_view name;
+        const Expr* kids[3] = {};
+        std::span<const Expr* const> args;
+        std::span<const std::string_view> params;
+    };
+
+    // 表中只存节点指针与哈希，比较时直接读取节点的字段
+    struct Entry {
+        const Expr* node = nullptr;
+        uint32_t hash = 0;
+        Kind kind = Kind::NUMBER;
+    };
+
+    Arena& nodes;
+    std::vector<Entry> table; // 开放寻址，负载不超过 1/2
+    std::vector<const Expr*> by_serial; // 按构造序号排列，用于判断节点是否属于本 dag
+    std::vector<uint32_t> shapes;       // 按构造序号排列的结构哈希
+    std::vector<uint8_t> effects;       // 按构造序号排列：子树中有赋值、定义或非纯函数调用
+    size_t count = 0;
+    size_t lookups = 0;
+    bool reuse_input;
+    bool track_sharing = true;
+
+    // 用户函数
+    const FunctionRegistry* functions;
+    bool inlining = true;
+    std::span<const std::string_view> binding;  // 定义函数体时：同名变量构造为 ParamExpr
+    std::string_view defining;                  // 正在定义的函数，函数体对它的调用不算副作用
+    std::vector<uint8_t> params_seen;
+    std::vector<std::string_view> called;       // 定义函数体时遇到的函数名
+    std::span<const Expr* const> substitution;  // 内联时：ParamExpr 替换为对应的实参
+    std::vector<std::pair<const UserFunction*, bool>> recursion; // 已判断过是否递归的函数
+
+    static size_t hash(const Key& key);
+    uint32_t shape_hash(const Key& key) const;
+    bool key_effects(const Key& key) const;
+    bool is_recursive(const UserFunction& fn);
+    static bool matches(const Entry& entry, const Key& key);
+    void grow();
+    template <class Make>
+    const Expr* intern(const Key& key, const Expr* existing, Make&& make);
+public:
+    explicit ExprDag(Arena& arena, bool reuse_input = false, const FunctionRegistry* functions = nullptr);
+
+    const Expr* number(double value, const Expr* existing = nullptr);
+    const Expr* variable(std::string_view name, const Expr* existing = nullptr);
+    const Expr* unary(TokenType op, const Expr* operand, const Expr* existing = nullptr);
+    const Expr* binary(const Expr* lhs, TokenType op, const Expr* rhs, const Expr* existing = nullptr);
+    const Expr* conditional(const Expr* cond, const Expr* t, const Expr* f, const Expr* existing = nullptr);
+    const Expr* call(std::string_view name, std::span<const Expr* const> args, const Expr* existing = nullptr);
+    const Expr* assign(std::string_view name, const Expr* value, const Expr* existing = nullptr);
+    const Expr* reactive_assign(std::string_view name, const Expr* formula, const Expr* existing = nullptr);
+    const Expr* param(uint32_t index, std::string_view name, const Expr* existing = nullptr);
+    const Expr* define(std::string_view name, std::span<const std::string_view> params, const Expr* body,
+        const Expr* existing = nullptr);
+
+    // 化简 e；之前化简结果就是自身的节点（stable）直接返回，不再访问其子树
+    const Expr* simplify(const Expr* e);
+    // 反复化简直到结果不再变化（最多 MAX_PASSES 轮）
+    const Expr* simplify_to_fixpoint(const Expr* root);
+    static constexpr int MAX_PASSES = 8;
+
+    // 节点是否由本 dag 构造或收入
+    bool owns(const Expr* e) const { return e->serial < by_serial.size() && by_serial[e->serial] == e; }
+    // 只由结构决定的哈希（与构造顺序、所在的 dag 无关），用于给子表达式排出稳定的顺序
+    uint32_t shape(const Expr* e) const { return owns(e) ? shapes[e->serial] : 0; }
+
+    // 子树中是否有赋值、定义或非纯函数调用（不属于本 dag 的节点视为有）
+    bool has_effects(const Expr* e) const { return owns(e) ? effects[e->serial] != 0 : true; }
+
+    // 构造时给出的函数表，没有时为内置函数表
+    const FunctionRegistry& function_table() const;
+    // 开关内联，返回原来的设置
+    bool set_inlining(bool on);
+    // 小的用户函数体：不超过该节点数才内联
+    static constexpr size_t INLINE_MAX_NODES = 32;
+    // 把调用 fn(args) 替换为函数体（参数换成实参）并化简；不适合内联时返回 nullptr。
+    // 只在构造时给出了函数表时内联；递归（直接或经由其他用户函数）的函数、函数体过大、
+    // 有参数没用到（内联后该实参不再求值）或实参有副作用（内联后可能被计算多次或改变顺序）时不内联
+    const Expr* inline_call(const Function& fn, std::span<const Expr* const> args);
+    // ParamExpr::share：内联时返回对应的实参，否则构造参数节点
+    const Expr* substitute(uint32_t index, std::string_view name);
+
+    // 定义用户函数 self 时复制函数体：与 params 同名的变量绑定为参数
+    const Expr* bind_params(const Expr* body, std::span<const std::string_view> params, std::string_view self);
+    // bind_params 之后：用到的参数个数与函数体调用的函数名
+    size_t params_used() const;
+    std::span<const std::string_view> called_functions() const { return called; }
+
+    Arena& arena() { return nodes; }
+    // 实际构造的节点数 / 请求构造的节点数（两者之差即共享节省的节点）
+    size_t unique_nodes() const { return count; }
+    size_t requested_nodes() const { return lookups; }
+};
@@ -4,6 +4,9 @@
 #include "binary_expr.h"
 #include "call_expr.h"
 #include "conditional_expr.h"
+#include "function_def_expr.h"
 #include "number_expr.h"
+#include "param_expr.h"
+#include "reactive_assign_expr.h"
 #include "unary_expr.h"
 #include "variable_expr.h"
\ No newline at end of file
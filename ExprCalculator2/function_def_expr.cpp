@@ -0,0 +1,59 @@
+#include <stdexcept>
+
+#include "evaluator.h" // 节点递归运算需要
+#include "function_def_expr.h"
+#include "compiled_expr.h"
+#include "printer.h"
+#include "operators.h"
+#include "expr_dag.h"
+#include "differentiator.h"
+
+// 用户函数定义
+FunctionDefExpr::FunctionDefExpr(std::string_view name, std::span<const std::string_view> p, const Expr* b)
+        : func_name(name), params(p), body(b) {}
+
+void FunctionDefExpr::print(Printer& p) const {
+    bool opened = p.open(operators::precedence(TokenType::ASSIGN));
+    p.text(func_name);
+    p.text("(");
+    for (size_t i = 0; i < params.size(); ++i) {
+        if (i > 0) p.text(", ");
+        p.text(params[i]);
+    }
+    p.text(")");
+    p.binary_op(TokenType::ASSIGN);
+    p.operand(body, 0);
+    p.close(opened);
+}
+
+
+EvalResult FunctionDefExpr::try_evaluate(Evaluator& eval) const {
+    if (FunctionRegistry::builtins().find(func_name))
+        return EvalError{ EvalErrc::BUILTIN_REDEFINED, this };
+    if (!eval.define_function(func_name, params, body)) return EvalError{ EvalErrc::CYCLIC_BINDING, this };
+    return Value::symbol(func_name);
+}
+
+
+// 函数体只化简、不内联其中的调用：被调用的函数按名字在调用时查找，之后重新定义也能生效
+const Expr* FunctionDefExpr::simplify(ExprDag& dag) const {
+    bool inlining = dag.set_inlining(false);
+    const Expr* new_body = dag.simplify(body);
+    dag.set_inlining(inlining);
+    return dag.define(func_name, params, new_body, new_body == body ? this : nullptr);
+}
+
+
+void FunctionDefExpr::compile(Compiler&) const {
+    throw std::invalid_argument("Function definitions cannot be compiled; evaluate them instead");
+}
+
+
+const Expr* FunctionDefExpr::share(ExprDag& dag) const {
+    return dag.define(func_name, params, body->share(dag));
+}
+
+
+const Expr* FunctionDefExpr::derive(Differentiator&) const {
+    throw std::invalid_argument("Cannot differentiate a function definition");
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+
+#include "expr.h"
+
+// 用户函数定义 f(x, y) = body，只能出现在最外层。
+// 求值时把函数注册到 Evaluator::functions（同名的用户函数被替换），结果为函数名的符号值；不能编译为字节码
+class FunctionDefExpr final : public Expr {
+    std::string_view func_name;
+    std::span<const std::string_view> params;
+    const Expr* body;
+    friend class ExprDag;
+public:
+    FunctionDefExpr(std::string_view name, std::span<const std::string_view> p, const Expr* b);
+    EvalResult try_evaluate(Evaluator& eval) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
+
+    std::string_view get_name() const { return func_name; }
+    std::span<const std::string_view> get_params() const { return params; }
+    const Expr* get_body() const { return body; }
+};
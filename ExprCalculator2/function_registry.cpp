@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cmath>
+
+#include "function_registry.h"
+#include "user_function.h"
+
+namespace {
+
+double min_of(const double* args, size_t count) {
+    double r = args[0];
+    for (size_t i = 1; i < count; ++i) r = std::fmin(r, args[i]);
+    return r;
+}
+
+double max_of(const double* args, size_t count) {
+    double r = args[0];
+    for (size_t i = 1; i < count; ++i) r = std::fmax(r, args[i]);
+    return r;
+}
+
+// 逐个合并，避免平方和溢出
+double hypot_of(const double* args, size_t count) {
+    double r = std::fabs(args[0]);
+    for (size_t i = 1; i < count; ++i) r = std::hypot(r, args[i]);
+    return r;
+}
+
+// 内置函数的偏导数
+void d_sin(const double* a, size_t, double, double* out) { out[0] = std::cos(a[0]); }
+void d_cos(const double* a, size_t, double, double* out) { out[0] = -std::sin(a[0]); }
+void d_tan(const double*, size_t, double r, double* out) { out[0] = 1.0 + r * r; }
+void d_sqrt(const double*, size_t, double r, double* out) { out[0] = 0.5 / r; }
+// 在 0 处取 0
+void d_abs(const double* a, size_t, double, double* out) { out[0] = a[0] > 0.0 ? 1.0 : a[0] < 0.0 ? -1.0 : 0.0; }
+void d_log10(const double* a, size_t, double, double* out) { out[0] = 1.0 / (a[0] * std::log(10.0)); }
+void d_ln(const double* a, size_t, double, double* out) { out[0] = 1.0 / a[0]; }
+void d_exp(const double*, size_t, double r, double* out) { out[0] = r; }
+
+void d_atan2(const double* a, size_t, double, double* out) {
+    double n = a[0] * a[0] + a[1] * a[1];
+    out[0] = a[1] / n;
+    out[1] = -a[0] / n;
+}
+
+// 底数不为正时对指数的偏导数取 0
+void d_pow(const double* a, size_t, double r, double* out) {
+    out[0] = a[1] * std::pow(a[0], a[1] - 1.0);
+    out[1] = a[0] > 0.0 ? r * std::log(a[0]) : 0.0;
+}
+
+// 只对第一个取到结果的参数求导
+void d_select(const double* a, size_t count, double r, double* out) {
+    bool found = false;
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = !found && a[i] == r ? 1.0 : 0.0;
+        found = found || a[i] == r;
+    }
+}
+
+void d_hypot(const double* a, size_t count, double r, double* out) {
+    for (size_t i = 0; i < count; ++i) out[i] = r > 0.0 ? a[i] / r : 0.0;
+}
+
+std::atomic<uint64_t> next_version{ 1 };
+
+void add_builtins(FunctionRegistry& r) {
+    using MathFn = double (*)(double);
+    using MathFn2 = double (*)(double, double);
+    // 直接保存 libm 的函数指针，JIT 可以取出后直接调用
+    r.define("sin", MathFn(::sin), FN_PURE, d_sin);
+    r.define("cos", MathFn(::cos), FN_PURE, d_cos);
+    r.define("tan", MathFn(::tan), FN_PURE, d_tan);
+    r.define("sqrt", MathFn(::sqrt), FN_PURE | FN_DOMAIN_NONNEGATIVE, d_sqrt);
+    r.define("abs", MathFn(::fabs), FN_PURE, d_abs);
+    r.define("log", MathFn(::log10), FN_PURE | FN_DOMAIN_POSITIVE, d_log10);
+    r.define("ln", MathFn(::log), FN_PURE | FN_DOMAIN_POSITIVE, d_ln);
+    r.define("exp", MathFn(::exp), FN_PURE, d_exp);
+    r.define("atan2", MathFn2(::atan2), FN_PURE, d_atan2);
+    r.define("pow", MathFn2(::pow), FN_PURE, d_pow);
+    r.define("min", min_of, 1, Function::ANY, FN_PURE, d_select);
+    r.define("max", max_of, 1, Function::ANY, FN_PURE, d_select);
+    r.define("hypot", hypot_of, 1, Function::ANY, FN_PURE, d_hypot);
+}
+
+} // namespace
+
+Function::Function(std::string_view n, Unary fn, uint8_t f)
+    : name(n), kind(Kind::UNARY), unary(fn), min_args(1), max_args(1), flags(f) {}
+
+Function::Function(std::string_view n, Binary fn, uint8_t f)
+    : name(n), kind(Kind::BINARY), binary(fn), min_args(2), max_args(2), flags(f) {}
+
+Function::Function(std::string_view n, Variadic fn, uint8_t min, uint8_t max, uint8_t f)
+    : name(n), kind(Kind::VARIADIC), variadic(fn), min_args(min), max_args(max), flags(f) {}
+
+Function::Function(std::string_view n, std::shared_ptr<const UserFunction> body, uint8_t argc, uint8_t f)
+    : name(n), kind(Kind::USER), variadic(nullptr), min_args(argc), max_args(argc), flags(f), user(std::move(body)) {}
+
+bool Function::in_domain(const double* args, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+        if ((flags & FN_DOMAIN_NONNEGATIVE) && !(args[i] >= 0.0)) return false;
+        if ((flags & FN_DOMAIN_POSITIVE) && !(args[i] > 0.0)) return false;
+    }
+    return true;
+}
+
+std::string arity_message(std::string_view name, uint8_t min_args, uint8_t max_args) {
+    std::string s = "Function " + std::string(name) + " expects ";
+    uint8_t last = min_args;
+    if (max_args == Function::ANY) s += "at least ";
+    else if (max_args != min_args) {
+        s += std::to_string(min_args) + " to ";
+        last = max_args;
+    }
+    s += std::to_string(last);
+    s += last == 1 ? " argument" : " arguments";
+    return s;
+}
+
+std::string call_depth_message(std::string_view name) {
+    return "Maximum call depth exceeded in function " + std::string(name);
+}
+
+const FunctionRegistry& FunctionRegistry::builtins() {
+    static const FunctionRegistry table = with_builtins();
+    return table;
+}
+
+FunctionRegistry FunctionRegistry::with_builtins() {
+    FunctionRegistry r;
+    add_builtins(r);
+    r.table_version = 0;
+    return r;
+}
+
+void FunctionRegistry::add(std::shared_ptr<const Function> fn) {
+    auto it = table.find(fn->name);
+    if (it == table.end()) {
+        std::string key = fn->name;
+        table.emplace(std::move(key), std::move(fn));
+    } else {
+        it->second = std::move(fn);
+    }
+    changed();
+}
+
+void FunctionRegistry::changed() {
+    // 宿主注册的纯函数同样会在化简时被折叠为常数，任何修改都使旧的化简结果失效
+    table_version = next_version.fetch_add(1, std::memory_order_relaxed);
+}
+
+const Function* FunctionRegistry::find(std::string_view name) const {
+    auto it = table.find(name);
+    return it == table.end() ? nullptr : it->second.get();
+}
+
+std::shared_ptr<const Function> FunctionRegistry::share(std::string_view name) const {
+    auto it = table.find(name);
+    return it == table.end() ? nullptr : it->second;
+}
+
+void FunctionRegistry::add(std::shared_ptr<Function> fn, Function::Partials partials) {
+    fn->partials = partials;
+    add(std::shared_ptr<const Function>(std::move(fn)));
+}
+
+void FunctionRegistry::define(std::string_view name, Function::Unary fn, uint8_t flags, Function::Partials partials) {
+    add(std::make_shared<Function>(name, fn, flags), partials);
+}
+
+void FunctionRegistry::define(std::string_view name, Function::Binary fn, uint8_t flags, Function::Partials partials) {
+    add(std::make_shared<Function>(name, fn, flags), partials);
+}
+
+void FunctionRegistry::define(std::string_view name, Function::Variadic fn, uint8_t min_args, uint8_t max_args,
+    uint8_t flags, Function::Partials partials) {
+    add(std::make_shared<Function>(name, fn, min_args, max_args, flags), partials);
+}
+
+void FunctionRegistry::define(std::shared_ptr<const UserFunction> fn) {
+    uint8_t argc = static_cast<uint8_t>(fn->params().size());
+    uint8_t flags = fn->pure() ? FN_PURE : 0;
+    std::string_view name = fn->name();
+    add(std::make_shared<const Function>(name, std::move(fn), argc, flags));
+}
+
+bool FunctionRegistry::remove(std::string_view name) {
+    auto it = table.find(name);
+    if (it == table.end()) return false;
+    table.erase(it);
+    changed();
+    return true;
+}
+
+std::vector<FunctionRegistry::CallCount> FunctionRegistry::call_counts() const {
+    std::vector<CallCount> counts;
+    counts.reserve(table.size());
+    for (const auto& [name, fn] : table) counts.push_back({ fn->name, fn->calls.load(std::memory_order_relaxed) });
+    std::sort(counts.begin(), counts.end(), [](const CallCount& a, const CallCount& b) { return a.name < b.name; });
+    return counts;
+}
+
+void FunctionRegistry::reset_counts() {
+    for (const auto& [name, fn] : table) fn->calls.store(0, std::memory_order_relaxed);
+}
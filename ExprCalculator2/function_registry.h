@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "string_map.h"
+
+class UserFunction;
+
+// 函数的性质
+enum FunctionFlags : uint8_t {
+    FN_PURE = 1 << 0,               // 无副作用、结果只取决于参数：参数都是常数时化简期折叠，共享的调用只计算一次
+    FN_DOMAIN_NONNEGATIVE = 1 << 1, // 参数小于 0 时结果为 NaN（sqrt）
+    FN_DOMAIN_POSITIVE = 1 << 2,    // 参数不大于 0 时结果为 NaN 或无穷（ln、log）
+};
+
+// 一个可调用的函数：直接保存函数指针，按声明的参数个数选用一元、二元或可变参数的形式；
+// 或者是用户定义的函数（USER，函数体见 user_function.h）
+struct Function {
+    using Unary = double (*)(double);
+    using Binary = double (*)(double, double);
+    using Variadic = double (*)(const double* args, size_t count);
+    // 偏导数：out[i] = ∂f/∂args[i]，result 为函数值（自动微分使用，见 gradient.h）
+    using Partials = void (*)(const double* args, size_t count, double result, double* out);
+    enum class Kind : uint8_t { UNARY, BINARY, VARIADIC, USER };
+    static constexpr uint8_t ANY = 0xFF; // max_args：个数不限
+
+    std::string name;
+    Kind kind;
+    union {
+        Unary unary;
+        Binary binary;
+        Variadic variadic;
+    };
+    uint8_t min_args;
+    uint8_t max_args;
+    uint8_t flags;
+    std::shared_ptr<const UserFunction> user; // 只有 USER 使用
+    Partials partials = nullptr;              // 没有时不能求梯度
+    mutable std::atomic<uint64_t> calls{ 0 };
+
+    Function(std::string_view n, Unary fn, uint8_t f);
+    Function(std::string_view n, Binary fn, uint8_t f);
+    Function(std::string_view n, Variadic fn, uint8_t min, uint8_t max, uint8_t f);
+    Function(std::string_view n, std::shared_ptr<const UserFunction> body, uint8_t argc, uint8_t f);
+
+    bool accepts(size_t count) const { return count >= min_args && (max_args == ANY || count <= max_args); }
+    bool pure() const { return flags & FN_PURE; }
+    // 参数是否都在 domain 标志声明的定义域内
+    bool in_domain(const double* args, size_t count) const;
+
+    // 调用并计数；参数个数必须满足 accepts，不能用于 USER（函数体要在 Evaluator 中求值）
+    double call(const double* args, size_t count) const {
+        calls.fetch_add(1, std::memory_order_relaxed);
+        return invoke(args, count);
+    }
+    // 批量求值时一次记入 rows 次调用
+    void count_calls(uint64_t rows) const { calls.fetch_add(rows, std::memory_order_relaxed); }
+    // 调用但不计数（化简期折叠常数使用）
+    double invoke(const double* args, size_t count) const {
+        switch (kind) {
+        case Kind::UNARY: return unary(args[0]);
+        case Kind::BINARY: return binary(args[0], args[1]);
+        default: return variadic(args, count);
+        }
+    }
+};
+
+// 参数个数不对、用户函数嵌套过深时的错误信息，逐节点求值与字节码 VM 共用
+std::string arity_message(std::string_view name, uint8_t min_args, uint8_t max_args);
+std::string call_depth_message(std::string_view name);
+
+// 函数表：名字 → Function。
+// 复制得到的函数表与原表共享已有的函数项（调用计数累加到同一处，如 ParallelEvaluator 的各线程副本），
+// 之后各自注册或删除的函数互不影响。注册不是线程安全的，应在开始并发求值之前完成。
+class FunctionRegistry {
+    StringMap<std::shared_ptr<const Function>> table;
+    uint64_t table_version = 0;
+
+    void add(std::shared_ptr<const Function> fn);
+    void add(std::shared_ptr<Function> fn, Function::Partials partials);
+    void changed();
+public:
+    // 内置函数：sin cos tan sqrt abs log ln exp（一元）、atan2 pow（二元）、min max hypot（至少一个参数）。
+    // 化简期按这张表折叠常数调用；其调用计数不代表任何 Evaluator 的调用
+    static const FunctionRegistry& builtins();
+    // 新建一张只含内置函数的表（计数从 0 开始）
+    static FunctionRegistry with_builtins();
+
+    const Function* find(std::string_view name) const;
+    // 与 find 相同，但返回共享的函数项：之后替换或删除同名函数，已取得的函数项仍然有效（见 Program）
+    std::shared_ptr<const Function> share(std::string_view name) const;
+
+    // 注册或替换同名函数；给出 partials 时可以对其求梯度
+    void define(std::string_view name, Function::Unary fn, uint8_t flags = FN_PURE,
+        Function::Partials partials = nullptr);
+    void define(std::string_view name, Function::Binary fn, uint8_t flags = FN_PURE,
+        Function::Partials partials = nullptr);
+    void define(std::string_view name, Function::Variadic fn, uint8_t min_args, uint8_t max_args = Function::ANY,
+        uint8_t flags = FN_PURE, Function::Partials partials = nullptr);
+    // 注册或替换用户函数
+    void define(std::shared_ptr<const UserFunction> fn);
+    // 放回先前由 share 取得的函数项（撤销一次替换）
+    void restore(std::shared_ptr<const Function> fn) { add(std::move(fn)); }
+    bool remove(std::string_view name);
+
+    // 函数表的版本：与 builtins() 相同的表为 0，每次注册、替换或删除函数后变为一个新的全局唯一值。
+    // 化简会内联用户函数、折叠纯函数的常数调用，结果只在版本不变时有效（见 ExprCache）
+    uint64_t version() const { return table_version; }
+
+    struct CallCount {
+        std::string_view name;
+        uint64_t calls;
+    };
+    // 各函数的调用次数，按名字排序
+    std::vector<CallCount> call_counts() const;
+    void reset_counts();
+};
@@ -0,0 +1,239 @@
+#include <cmath>
+#include <stdexcept>
+
+#include "gradient.h"
+#include "operators.h"
+#include "user_function.h"
+
+GradientTape::GradientTape(const Expr* expr, Evaluator& eval, std::span<const std::string_view> vars)
+    : program(expr, eval) {
+    inputs.reserve(vars.size());
+    for (std::string_view name : vars) {
+        VarSlot slot = eval.bind(name);
+        for (VarSlot seen : inputs) {
+            if (seen.index == slot.index)
+                throw std::invalid_argument("gradient: duplicate variable " + std::string(name));
+        }
+        inputs.push_back(slot);
+    }
+}
+
+
+uint32_t GradientTape::record(std::initializer_list<Edge> in) {
+    size_t first = edges.size();
+    for (const Edge& e : in) {
+        if (e.from != NONE) edges.push_back(e);
+    }
+    if (edges.size() == first) return NONE;
+    edge_end.push_back(static_cast<uint32_t>(edges.size()));
+    return static_cast<uint32_t>(edge_end.size() - 1);
+}
+
+
+uint32_t GradientTape::record(std::span<const Dual> args, std::span<const double> weights) {
+    size_t first = edges.size();
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i].node != NONE) edges.push_back({ args[i].node, weights[i] });
+    }
+    if (edges.size() == first) return NONE;
+    edge_end.push_back(static_cast<uint32_t>(edges.size()));
+    return static_cast<uint32_t>(edge_end.size() - 1);
+}
+
+
+GradientTape::Dual GradientTape::run(const CompiledExpr& code, Evaluator& eval, size_t param_base, uint32_t depth) {
+    // 本层的栈与临时槽占 stack 的 [base, base + 栈深度 + 临时槽数)
+    const size_t base = stack.size();
+    const size_t temp = base + code.stack_depth();
+    stack.resize(temp + code.temp_count());
+    size_t sp = base; // 下一个空槽
+
+    auto push = [&](double v, uint32_t node) { stack[sp++] = { v, node }; };
+    auto pop = [&]() { return stack[--sp]; };
+
+    std::span<const Instr> instrs = code.instructions();
+    for (size_t pc = 0; pc < instrs.size(); ++pc) {
+        const Instr& in = instrs[pc];
+        if (in.op >= OpCode::ADD && in.op <= OpCode::BINARY) {
+            Dual b = pop();
+            Dual a = pop();
+            double l = a.value, r = b.value, v;
+            switch (in.op) {
+            case OpCode::ADD:
+                push(l + r, record({ { a.node, 1.0 }, { b.node, 1.0 } }));
+                break;
+            case OpCode::SUB:
+                push(l - r, record({ { a.node, 1.0 }, { b.node, -1.0 } }));
+                break;
+            case OpCode::MUL:
+                push(l * r, record({ { a.node, r }, { b.node, l } }));
+                break;
+            case OpCode::DIV:
+                v = operators::divide(l, r);
+                push(v, record({ { a.node, 1.0 / r }, { b.node, -v / r } }));
+                break;
+            case OpCode::MOD:
+                // fmod(l, r) = l - trunc(l / r) * r
+                push(operators::modulo(l, r), record({ { a.node, 1.0 }, { b.node, -std::trunc(l / r) } }));
+                break;
+            case OpCode::POW:
+                v = std::pow(l, r);
+                // 底数不为正时对指数的偏导数取 0
+                push(v, record({ { a.node, r * std::pow(l, r - 1.0) },
+                                 { b.node, l > 0.0 ? v * std::log(l) : 0.0 } }));
+                break;
+            // 比较与逻辑运算：分段常数，导数为 0
+            case OpCode::GT: push(operators::gt(l, r), NONE); break;
+            case OpCode::LT: push(operators::lt(l, r), NONE); break;
+            case OpCode::GE: push(operators::ge(l, r), NONE); break;
+            case OpCode::LE: push(operators::le(l, r), NONE); break;
+            case OpCode::EQ: push(operators::eq(l, r), NONE); break;
+            case OpCode::NE: push(operators::ne(l, r), NONE); break;
+            case OpCode::AND: push(operators::logical_and(l, r), NONE); break;
+            case OpCode::OR: push(operators::logical_or(l, r), NONE); break;
+            default: push(operators::binary(static_cast<TokenType>(in.arg), l, r), NONE); break;
+            }
+            continue;
+        }
+
+        switch (in.op) {
+        case OpCode::PUSH_CONST:
+            push(code.constant(in.arg), NONE);
+            break;
+        case OpCode::LOAD_VAR: {
+            VarSlot slot{ in.arg };
+            if (!eval.is_defined(slot)) throw std::runtime_error("Undefined variable: " + eval.name_of(slot));
+            push(eval.get(slot), in.arg < slot_nodes.size() ? slot_nodes[in.arg] : NONE);
+            break;
+        }
+        case OpCode::LOAD_PARAM:
+            push(params[param_base + in.arg].value, params[param_base + in.arg].node);
+            break;
+        case OpCode::NEG: {
+            Dual a = pop();
+            push(-a.value, record({ { a.node, -1.0 } }));
+            break;
+        }
+        case OpCode::NOT:
+            stack[sp - 1] = { operators::logical_not(stack[sp - 1].value), NONE };
+            break;
+        case OpCode::JUMP:
+            pc = in.arg - 1;
+            break;
+        case OpCode::JUMP_IF_FALSE:
+            // 只记录走到的分支；条件本身对结果的导数为 0
+            if (!operators::truthy(pop().value)) pc = in.arg - 1;
+            break;
+        case OpCode::STORE:
+            eval.set(VarSlot{ in.arg }, stack[sp - 1].value);
+            if (in.arg >= slot_nodes.size()) slot_nodes.resize(in.arg + 1, NONE);
+            slot_nodes[in.arg] = stack[sp - 1].node;
+            break;
+        case OpCode::FUNC: {
+            const std::string& name = code.name(in.arg);
+            const Function* fn = eval.functions.find(name);
+            if (!fn) throw std::runtime_error("Undefined function: " + name);
+            if (!fn->accepts(code.argc(in.arg)))
+                throw std::runtime_error(arity_message(name, fn->min_args, fn->max_args));
+            pending.push_back(fn);
+            push(0.0, NONE);
+            break;
+        }
+        case OpCode::CALL: {
+            uint32_t argc = code.argc(in.arg);
+            sp -= argc;
+            const Function* fn = pending.back();
+            pending.pop_back();
+            std::span<const Dual> args(stack.data() + sp, argc);
+            if (fn->kind != Function::Kind::USER) {
+                // scratch：参数值在前，偏导数在后
+                scratch.resize(2 * argc);
+                double* values = scratch.data();
+                double* weights = values + argc;
+                bool active = false;
+                for (uint32_t i = 0; i < argc; ++i) {
+                    values[i] = args[i].value;
+                    active = active || args[i].node != NONE;
+                }
+                double v = fn->call(values, argc);
+                uint32_t node = NONE;
+                if (active) {
+                    if (!fn->partials) throw std::runtime_error("Function " + fn->name + " has no derivative");
+                    fn->partials(values, argc, v, weights);
+                    node = record(args, std::span<const double>(weights, argc));
+                }
+                stack[sp - 1] = { v, node };
+                break;
+            }
+            // 用户函数：参数（连同节点）传给函数体，在同一条纸带上继续记录
+            if (depth >= Evaluator::MAX_CALL_DEPTH) throw std::runtime_error(call_depth_message(fn->name));
+            fn->count_calls(1);
+            size_t frame = params.size();
+            params.insert(params.end(), args.begin(), args.end());
+            Dual v = run(fn->user->bytecode(), eval, frame, depth + 1);
+            params.resize(frame);
+            stack[sp - 1] = v;
+            break;
+        }
+        case OpCode::TEMP_STORE:
+            stack[temp + in.arg] = stack[sp - 1];
+            break;
+        case OpCode::TEMP_LOAD:
+            stack[sp++] = stack[temp + in.arg];
+            break;
+        default:
+            break;
+        }
+    }
+
+    Dual result = stack[sp - 1];
+    stack.resize(base);
+    return result;
+}
+
+
+double GradientTape::evaluate(Evaluator& eval, std::span<double> grad) {
+    if (grad.size() != inputs.size()) throw std::invalid_argument("gradient: output has the wrong length");
+    if (eval.slot_count() < program.slots_required())
+        throw std::logic_error("GradientTape evaluated with an Evaluator it was not compiled for");
+
+    edge_end.clear();
+    edges.clear();
+    stack.clear();
+    params.clear();
+    pending.clear();
+    slot_nodes.assign(eval.slot_count(), NONE);
+    for (size_t k = 0; k < inputs.size(); ++k) {
+        slot_nodes[inputs[k].index] = static_cast<uint32_t>(k);
+        edge_end.push_back(0);
+    }
+
+    Dual out = run(program, eval, 0, eval.depth());
+
+    // 反向：节点按拓扑序记录，从输出倒序把伴随值沿入边累加到前驱
+    adjoint.assign(edge_end.size(), 0.0);
+    if (out.node != NONE) {
+        adjoint[out.node] = 1.0;
+        for (size_t i = out.node + 1; i-- > inputs.size();) {
+            double a = adjoint[i];
+            if (a == 0.0) continue;
+            for (size_t e = edge_end[i - 1]; e < edge_end[i]; ++e) adjoint[edges[e].from] += a * edges[e].weight;
+        }
+    }
+    for (size_t k = 0; k < inputs.size(); ++k) grad[k] = adjoint[k];
+    return out.value;
+}
+
+
+Gradient GradientTape::evaluate(Evaluator& eval) {
+    Gradient g;
+    g.partials.resize(inputs.size());
+    g.value = evaluate(eval, g.partials);
+    return g;
+}
+
+
+Gradient gradient(const Expr* expr, Evaluator& eval, std::span<const std::string_view> vars) {
+    GradientTape tape(expr, eval, vars);
+    return tape.evaluate(eval);
+}
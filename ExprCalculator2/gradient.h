@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "compiled_expr.h"
+#include "evaluator.h"
+
+// 函数值与对各变量的偏导数（与请求的变量同序）
+struct Gradient {
+    double value = 0.0;
+    std::vector<double> partials;
+};
+
+// 反向模式自动微分：一次编译，之后每个点只需一遍正向求值（记录纸带）加一遍反向累加伴随值，
+// 代价与变量个数无关。纸带按字节码记录实际执行的指令：条件表达式只记录走到的分支，
+// 共享子表达式与用户函数体的每次调用都按执行到的值记录。
+// 比较、逻辑运算的导数为 0（分段常数）；函数需要在注册时给出 partials（内置函数都有）。
+// 错误与 CompiledExpr::evaluate 相同，以 std::runtime_error 抛出；请求的变量必须已定义。
+// 表达式中的赋值照常写入 eval，之后对该变量的读取沿用赋值的导数。
+class GradientTape {
+    struct Dual {
+        double value;
+        uint32_t node; // 纸带上的节点，NONE 表示与所有输入无关
+    };
+    struct Edge {
+        uint32_t from;
+        double weight;
+    };
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    CompiledExpr program;
+    std::vector<VarSlot> inputs;
+
+    // 纸带：节点 i 的入边为 edges[edge_end[i - 1], edge_end[i])，前 inputs.size() 个节点是输入
+    std::vector<uint32_t> edge_end;
+    std::vector<Edge> edges;
+    std::vector<double> adjoint;
+    // 正向求值的状态，按下标访问（嵌套调用时可能扩容）
+    std::vector<Dual> stack;
+    std::vector<Dual> params;
+    std::vector<const Function*> pending; // FUNC 压入、CALL 弹出的函数
+    std::vector<uint32_t> slot_nodes;     // 变量槽 → 当前值的节点
+    std::vector<double> scratch;
+
+    uint32_t record(std::initializer_list<Edge> in);
+    uint32_t record(std::span<const Dual> args, std::span<const double> weights);
+    Dual run(const CompiledExpr& code, Evaluator& eval, size_t param_base, uint32_t depth);
+public:
+    GradientTape(const Expr* expr, Evaluator& eval, std::span<const std::string_view> vars);
+
+    // 在 eval 中变量的当前值处求值，偏导数写入 grad（长度与 vars 相同），返回函数值
+    double evaluate(Evaluator& eval, std::span<double> grad);
+    Gradient evaluate(Evaluator& eval);
+
+    size_t variables() const { return inputs.size(); }
+    // 上一次求值记录的节点数与边数
+    size_t tape_nodes() const { return edge_end.size(); }
+    size_t tape_edges() const { return edges.size(); }
+};
+
+// 只求一个点时的简便形式
+Gradient gradient(const Expr* expr, Evaluator& eval, std::span<const std::string_view> vars);
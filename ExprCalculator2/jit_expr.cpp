@@ -0,0 +1,530 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#include "evaluator.h"
+#include "jit_expr.h"
+#include "operators.h"
+
+#if defined(__x86_64__) && defined(__linux__) && !defined(EXPRCALC_NO_JIT)
+#define EXPRCALC_HAS_JIT 1
+#include <sys/mman.h>
+#endif
+
+#ifdef EXPRCALC_HAS_JIT
+namespace {
+
+using MathFn = double (*)(double);
+using MathFn2 = double (*)(double, double);
+
+// 常量池中固定的前几项，每项 16 字节对齐（andpd 等打包指令要求）
+enum PoolEntry : uint32_t { POOL_EPS, POOL_ONE, POOL_ABS_MASK, POOL_SIGN_MASK, POOL_NAN, POOL_FIXED };
+
+// 栈位置 0..REG_POSITIONS-1 放在 xmm2..xmm15，其余放在栈帧中；xmm0/xmm1 为临时寄存器
+constexpr int REG_POSITIONS = 14;
+constexpr int32_t SPILL_BYTES = REG_POSITIONS * 8; // 调用 libm 前保存寄存器的区域
+
+// cmpsd 的比较谓词
+constexpr int CMP_LT = 1;
+constexpr int CMP_LE = 2;
+
+// 指令操作数：xmm 寄存器、栈帧 [rsp+disp]、变量 [rbx+disp] 或常量池 [rip+disp]
+struct Operand {
+    enum Kind { XMM, FRAME, SLOT, POOL } kind;
+    uint32_t value;
+};
+
+Operand xmm(int n) { return { Operand::XMM, static_cast<uint32_t>(n) }; }
+Operand pool(uint32_t index) { return { Operand::POOL, index }; }
+
+class Emitter {
+    std::vector<uint8_t> code;
+    std::vector<uint64_t> pool_bits;
+
+    struct PoolFixup { size_t at; size_t next_ip; uint32_t index; };
+    struct JumpFixup { size_t at; uint32_t target_pc; };
+    std::vector<PoolFixup> pool_fixups;
+    std::vector<JumpFixup> jump_fixups;
+    std::vector<size_t> error_fixups;
+
+    void byte(uint8_t b) { code.push_back(b); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; ++i) byte(static_cast<uint8_t>(v >> (8 * i))); }
+    void u64(uint64_t v) { for (int i = 0; i < 8; ++i) byte(static_cast<uint8_t>(v >> (8 * i))); }
+
+public:
+    Emitter() {
+        pool_bits.resize(POOL_FIXED * 2);
+        auto bits = [](double d) { uint64_t u; std::memcpy(&u, &d, 8); return u; };
+        pool_bits[2 * POOL_EPS] = bits(operators::EPS);
+        pool_bits[2 * POOL_ONE] = bits(1.0);
+        pool_bits[2 * POOL_ABS_MASK] = 0x7FFFFFFFFFFFFFFFull;
+        pool_bits[2 * POOL_SIGN_MASK] = 0x8000000000000000ull;
+        pool_bits[2 * POOL_NAN] = bits(std::nan(""));
+    }
+
+    size_t here() const { return code.size(); }
+
+    uint32_t constant(double v) {
+        uint64_t u;
+        std::memcpy(&u, &v, 8);
+        pool_bits.push_back(u);
+        pool_bits.push_back(0);
+        return static_cast<uint32_t>(pool_bits.size() / 2 - 1);
+    }
+
+    // SSE 指令：[prefix] [REX] 0F op ModRM [SIB] [disp32] [imm8]
+    void sse(uint8_t prefix, uint8_t op, int reg, Operand rm, int imm = -1) {
+        byte(prefix);
+        uint8_t rex = 0x40;
+        if (reg >= 8) rex |= 0x04;
+        if (rm.kind == Operand::XMM && rm.value >= 8) rex |= 0x01;
+        if (rex != 0x40) byte(rex);
+        byte(0x0F);
+        byte(op);
+        uint8_t r = static_cast<uint8_t>((reg & 7) << 3);
+        switch (rm.kind) {
+        case Operand::XMM:
+            byte(0xC0 | r | (rm.value & 7));
+            break;
+        case Operand::FRAME: // [rsp + disp32]
+            byte(0x84 | r);
+            byte(0x24);
+            u32(rm.value);
+            break;
+        case Operand::SLOT: // [rbx + disp32]
+            byte(0x83 | r);
+            u32(rm.value);
+            break;
+        case Operand::POOL: // [rip + disp32]，在 finish 中回填
+            byte(0x05 | r);
+            pool_fixups.push_back({ here(), here() + 4 + (imm >= 0 ? 1 : 0), rm.value });
+            u32(0);
+            break;
+        }
+        if (imm >= 0) byte(static_cast<uint8_t>(imm));
+    }
+
+    void movsd_load(int reg, Operand src) { sse(0xF2, 0x10, reg, src); }
+    void movsd_store(Operand dst, int reg) { sse(0xF2, 0x11, reg, dst); }
+    void movapd(int dst, int src) { sse(0x66, 0x28, dst, xmm(src)); }
+
+    void load(int reg, Operand src) {
+        if (src.kind != Operand::XMM) movsd_load(reg, src);
+        else if (static_cast<int>(src.value) != reg) movapd(reg, src.value);
+    }
+    void store(Operand dst, int reg) {
+        if (dst.kind != Operand::XMM) movsd_store(dst, reg);
+        else if (static_cast<int>(dst.value) != reg) movapd(dst.value, reg);
+    }
+
+    void prologue(int32_t frame) {
+        byte(0x53);                          // push rbx
+        byte(0x48); byte(0x89); byte(0xFB);  // mov rbx, rdi
+        byte(0x48); byte(0x81); byte(0xEC); u32(frame); // sub rsp, frame
+    }
+    void epilogue(int32_t frame) {
+        byte(0x48); byte(0x81); byte(0xC4); u32(frame); // add rsp, frame
+        byte(0x5B);                          // pop rbx
+        byte(0xC3);                          // ret
+    }
+
+    void call(const void* target) {
+        byte(0x48); byte(0xB8); u64(reinterpret_cast<uint64_t>(target)); // mov rax, imm64
+        byte(0xFF); byte(0xD0);                                          // call rax
+    }
+
+    // 原子地给 *counter 加一（调用计数）
+    void count(const void* counter) {
+        byte(0x48); byte(0xB8); u64(reinterpret_cast<uint64_t>(counter)); // mov rax, imm64
+        byte(0xF0); byte(0x48); byte(0xFF); byte(0x00);                  // lock inc qword [rax]
+    }
+
+    void jump(uint32_t target_pc) {
+        byte(0xE9);
+        jump_fixups.push_back({ here(), target_pc });
+        u32(0);
+    }
+    // ucomisd 之后：低于或等于（含无序）时跳转
+    void jump_if_below_equal(uint32_t target_pc) {
+        byte(0x0F); byte(0x86);
+        jump_fixups.push_back({ here(), target_pc });
+        u32(0);
+    }
+    // ucomisd 之后：高于（有序）时跳到错误出口
+    void error_if_above() {
+        byte(0x0F); byte(0x87);
+        error_fixups.push_back(here());
+        u32(0);
+    }
+
+    // 回填跳转与常量池地址，返回代码长度（常量池紧随其后，16 字节对齐）
+    size_t finish(const std::vector<size_t>& pc_offsets, size_t error_offset) {
+        auto rel = [&](size_t at, size_t target) {
+            int32_t d = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+            std::memcpy(&code[at], &d, 4);
+        };
+        for (const auto& f : jump_fixups) rel(f.at, pc_offsets[f.target_pc]);
+        for (size_t at : error_fixups) rel(at, error_offset);
+
+        size_t pool_offset = (code.size() + 15) & ~size_t(15);
+        for (const auto& f : pool_fixups) {
+            int32_t d = static_cast<int32_t>(static_cast<int64_t>(pool_offset + 16 * f.index) - static_cast<int64_t>(f.next_ip));
+            std::memcpy(&code[f.at], &d, 4);
+        }
+        size_t code_size = code.size();
+        code.resize(pool_offset + pool_bits.size() * 8);
+        std::memcpy(code.data() + pool_offset, pool_bits.data(), pool_bits.size() * 8);
+        return code_size;
+    }
+
+    const std::vector<uint8_t>& bytes() const { return code; }
+};
+
+// 把字节码的栈机器翻译为寄存器代码：栈位置在编译期即可确定，运行时没有栈指针
+class Translator {
+    const CompiledExpr& program;
+    Evaluator& eval;
+    Emitter e;
+    std::vector<uint32_t>& used_slots;
+    std::vector<std::shared_ptr<const Function>>& functions;
+    std::vector<const Function*> pending_calls; // FUNC 取出的函数，等待对应的 CALL
+    int32_t frame = 0;
+
+    Operand pos(int p) const {
+        if (p < REG_POSITIONS) return xmm(2 + p);
+        return { Operand::FRAME, static_cast<uint32_t>(SPILL_BYTES + 8 * (p - REG_POSITIONS)) };
+    }
+
+    // 共享子表达式的临时槽，位于栈帧中栈位置之后
+    Operand temp(uint32_t index) const {
+        int extra = static_cast<int>(program.stack_depth()) - REG_POSITIONS;
+        return { Operand::FRAME, static_cast<uint32_t>(SPILL_BYTES + 8 * ((extra > 0 ? extra : 0) + index)) };
+    }
+
+    // 结果写入 a 的二元算术运算
+    void arith(uint8_t op, Operand a, Operand b) {
+        if (a.kind == Operand::XMM) {
+            e.sse(0xF2, op, a.value, b);
+        } else {
+            e.load(0, a);
+            e.sse(0xF2, op, 0, b);
+            e.store(a, 0);
+        }
+    }
+
+    // |b| < EPS 时跳到错误出口
+    void check_divisor(Operand b) {
+        e.load(1, b);
+        e.sse(0x66, 0x54, 1, pool(POOL_ABS_MASK)); // andpd
+        e.movsd_load(0, pool(POOL_EPS));
+        e.sse(0x66, 0x2E, 0, xmm(1));              // ucomisd EPS, |b|
+        e.error_if_above();
+    }
+
+    // xmm(reg) = EPS < |v| 的掩码，占用 xmm0
+    void truthy_mask(int reg, Operand v) {
+        e.load(0, v);
+        e.sse(0x66, 0x54, 0, pool(POOL_ABS_MASK));
+        e.movsd_load(reg, pool(POOL_EPS));
+        e.sse(0xF2, 0xC2, reg, xmm(0), CMP_LT);
+    }
+
+    // 把比较掩码转换为 1.0 / 0.0 并写入 dst
+    void mask_result(Operand dst, int reg) {
+        e.sse(0x66, 0x54, reg, pool(POOL_ONE));
+        e.store(dst, reg);
+    }
+
+    // 调用 libm：位于 result 之下的寄存器位置在调用前后保存/恢复（xmm 均为调用者保存）
+    void call(const void* target, int result, Operand a0, const Operand* a1) {
+        int live = result < REG_POSITIONS ? result : REG_POSITIONS;
+        for (int i = 0; i < live; ++i) e.movsd_store({ Operand::FRAME, static_cast<uint32_t>(8 * i) }, 2 + i);
+        // 参数位置都在 xmm2 以上或栈帧中，装入 xmm0/xmm1 不会互相覆盖
+        e.load(0, a0);
+        if (a1) e.load(1, *a1);
+        e.call(target);
+        e.store(pos(result), 0);
+        for (int i = 0; i < live; ++i) e.movsd_load(2 + i, { Operand::FRAME, static_cast<uint32_t>(8 * i) });
+    }
+
+    bool translate(const Instr& in, int& depth) {
+        switch (in.op) {
+        case OpCode::PUSH_CONST: {
+            Operand dst = pos(depth++);
+            uint32_t c = e.constant(program.constant(in.arg));
+            if (dst.kind == Operand::XMM) e.movsd_load(dst.value, pool(c));
+            else { e.movsd_load(0, pool(c)); e.store(dst, 0); }
+            return true;
+        }
+        case OpCode::LOAD_VAR: {
+            Operand dst = pos(depth++);
+            Operand src{ Operand::SLOT, in.arg * 8 };
+            used_slots.push_back(in.arg);
+            if (dst.kind == Operand::XMM) e.movsd_load(dst.value, src);
+            else { e.movsd_load(0, src); e.store(dst, 0); }
+            return true;
+        }
+        case OpCode::NEG: case OpCode::NOT: {
+            Operand a = pos(depth - 1);
+            if (in.op == OpCode::NEG) {
+                e.load(0, a);
+                e.sse(0x66, 0x57, 0, pool(POOL_SIGN_MASK)); // xorpd
+                e.store(a, 0);
+            } else {
+                // |v| < EPS
+                e.load(0, a);
+                e.sse(0x66, 0x54, 0, pool(POOL_ABS_MASK));
+                e.sse(0xF2, 0xC2, 0, pool(POOL_EPS), CMP_LT);
+                mask_result(a, 0);
+            }
+            return true;
+        }
+        case OpCode::JUMP:
+            // 真分支结束；假分支从同一个位置开始压栈
+            e.jump(in.arg);
+            --depth;
+            return true;
+        case OpCode::JUMP_IF_FALSE: {
+            Operand c = pos(--depth);
+            e.load(0, c);
+            e.sse(0x66, 0x54, 0, pool(POOL_ABS_MASK));
+            e.sse(0x66, 0x2E, 0, pool(POOL_EPS)); // ucomisd |c|, EPS：不大于（或 NaN）即为假
+            e.jump_if_below_equal(in.arg);
+            return true;
+        }
+        case OpCode::FUNC: {
+            // 一元、二元函数的参数正好放进 xmm0/xmm1；可变参数函数、用户函数与参数个数错误交给解释器
+            // 函数的地址与计数器写进代码，须持有该函数直到 JitExpr 销毁
+            std::shared_ptr<const Function> fn = eval.functions.share(program.name(in.arg));
+            if (!fn || !fn->accepts(program.argc(in.arg))) return false;
+            if (fn->kind != Function::Kind::UNARY && fn->kind != Function::Kind::BINARY) return false;
+            pending_calls.push_back(fn.get());
+            functions.push_back(std::move(fn));
+            ++depth; // 与字节码保持相同的栈布局，该位置用于存放调用结果
+            return true;
+        }
+        case OpCode::CALL: {
+            const Function* fn = pending_calls.back();
+            pending_calls.pop_back();
+            e.count(&fn->calls);
+            if (fn->kind == Function::Kind::BINARY) {
+                Operand b = pos(--depth);
+                Operand a = pos(--depth);
+                call(reinterpret_cast<const void*>(fn->binary), depth - 1, a, &b);
+                return true;
+            }
+            Operand arg = pos(--depth);
+            int result = depth - 1;
+            Operand dst = pos(result);
+            if (fn->unary == MathFn(::sqrt)) {
+                e.sse(0xF2, 0x51, dst.kind == Operand::XMM ? dst.value : 0, arg); // sqrtsd
+                if (dst.kind != Operand::XMM) e.store(dst, 0);
+            } else if (fn->unary == MathFn(::fabs)) {
+                e.load(0, arg);
+                e.sse(0x66, 0x54, 0, pool(POOL_ABS_MASK));
+                e.store(dst, 0);
+            } else {
+                call(reinterpret_cast<const void*>(fn->unary), result, arg, nullptr);
+            }
+            return true;
+        }
+        case OpCode::TEMP_STORE: {
+            Operand src = pos(depth - 1);
+            if (src.kind != Operand::XMM) e.movsd_load(0, src);
+            e.movsd_store(temp(in.arg), src.kind == Operand::XMM ? src.value : 0);
+            return true;
+        }
+        case OpCode::TEMP_LOAD: {
+            Operand dst = pos(depth++);
+            if (dst.kind == Operand::XMM) e.movsd_load(dst.value, temp(in.arg));
+            else { e.movsd_load(0, temp(in.arg)); e.store(dst, 0); }
+            return true;
+        }
+        case OpCode::STORE: case OpCode::BINARY: case OpCode::LOAD_PARAM:
+            return false;
+        default:
+            break;
+        }
+
+        // 二元运算：a 为结果位置
+        Operand b = pos(--depth);
+        int ai = depth - 1;
+        Operand a = pos(ai);
+        switch (in.op) {
+        case OpCode::ADD: arith(0x58, a, b); break;
+        case OpCode::SUB: arith(0x5C, a, b); break;
+        case OpCode::MUL: arith(0x59, a, b); break;
+        case OpCode::DIV: check_divisor(b); arith(0x5E, a, b); break;
+        case OpCode::MOD:
+            check_divisor(b);
+            call(reinterpret_cast<const void*>(MathFn2(::fmod)), ai, a, &b);
+            break;
+        case OpCode::POW:
+            call(reinterpret_cast<const void*>(MathFn2(::pow)), ai, a, &b);
+            break;
+        case OpCode::GT: // r + EPS < l
+            e.load(0, b);
+            e.sse(0xF2, 0x58, 0, pool(POOL_EPS));
+            e.sse(0xF2, 0xC2, 0, a, CMP_LT);
+            mask_result(a, 0);
+            break;
+        case OpCode::LT: // l < r - EPS
+            e.load(0, b);
+            e.sse(0xF2, 0x5C, 0, pool(POOL_EPS));
+            e.load(1, a);
+            e.sse(0xF2, 0xC2, 1, xmm(0), CMP_LT);
+            mask_result(a, 1);
+            break;
+        case OpCode::GE: // r - EPS <= l
+            e.load(0, b);
+            e.sse(0xF2, 0x5C, 0, pool(POOL_EPS));
+            e.sse(0xF2, 0xC2, 0, a, CMP_LE);
+            mask_result(a, 0);
+            break;
+        case OpCode::LE: // l <= r + EPS
+            e.load(0, b);
+            e.sse(0xF2, 0x58, 0, pool(POOL_EPS));
+            e.load(1, a);
+            e.sse(0xF2, 0xC2, 1, xmm(0), CMP_LE);
+            mask_result(a, 1);
+            break;
+        case OpCode::EQ: // |l - r| < EPS
+            e.load(0, a);
+            e.sse(0xF2, 0x5C, 0, b);
+            e.sse(0x66, 0x54, 0, pool(POOL_ABS_MASK));
+            e.sse(0xF2, 0xC2, 0, pool(POOL_EPS), CMP_LT);
+            mask_result(a, 0);
+            break;
+        case OpCode::NE: // EPS <= |l - r|（NaN 时为假）
+            e.load(0, a);
+            e.sse(0xF2, 0x5C, 0, b);
+            e.sse(0x66, 0x54, 0, pool(POOL_ABS_MASK));
+            e.movsd_load(1, pool(POOL_EPS));
+            e.sse(0xF2, 0xC2, 1, xmm(0), CMP_LE);
+            mask_result(a, 1);
+            break;
+        case OpCode::AND: case OpCode::OR:
+            // 左操作数的掩码先存回 a，再与右操作数的掩码合并
+            truthy_mask(1, a);
+            e.store(a, 1);
+            truthy_mask(1, b);
+            e.load(0, a);
+            e.sse(0x66, in.op == OpCode::AND ? 0x54 : 0x56, 1, xmm(0)); // andpd / orpd
+            mask_result(a, 1);
+            break;
+        default:
+            return false;
+        }
+        return true;
+    }
+
+public:
+    Translator(const CompiledExpr& p, Evaluator& ev, std::vector<uint32_t>& slots,
+        std::vector<std::shared_ptr<const Function>>& fns)
+        : program(p), eval(ev), used_slots(slots), functions(fns) {}
+
+    // 成功时返回代码与常量池，失败（有不支持的指令）时返回空
+    std::vector<uint8_t> run() {
+        int extra = static_cast<int>(program.stack_depth()) - REG_POSITIONS;
+        frame = SPILL_BYTES + 8 * ((extra > 0 ? extra : 0) + static_cast<int>(program.temp_count()));
+        frame = (frame + 15) & ~15; // push rbx 之后 rsp 已 16 字节对齐
+
+        auto code = program.instructions();
+        std::vector<size_t> pc_offsets(code.size() + 1);
+        int depth = 0;
+        e.prologue(frame);
+        for (size_t pc = 0; pc < code.size(); ++pc) {
+            pc_offsets[pc] = e.here();
+            if (!translate(code[pc], depth)) return {};
+        }
+        pc_offsets[code.size()] = e.here();
+        e.load(0, pos(0));
+        e.epilogue(frame);
+
+        size_t error_offset = e.here();
+        e.movsd_load(0, pool(POOL_NAN));
+        e.epilogue(frame);
+
+        e.finish(pc_offsets, error_offset);
+        return e.bytes();
+    }
+};
+
+} // namespace
+#endif
+
+JitExpr::JitExpr(const Expr* expr, Evaluator& eval) : program(expr, eval) {
+#ifdef EXPRCALC_HAS_JIT
+    std::vector<uint8_t> bytes = Translator(program, eval, used_slots, functions).run();
+    if (bytes.empty()) {
+        used_slots.clear();
+        functions.clear();
+        return;
+    }
+    void* page = mmap(nullptr, bytes.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page == MAP_FAILED) {
+        used_slots.clear();
+        functions.clear();
+        return;
+    }
+    std::memcpy(page, bytes.data(), bytes.size());
+    // 写入完成后再设为可执行，页面不会同时可写可执行
+    if (mprotect(page, bytes.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(page, bytes.size());
+        used_slots.clear();
+        functions.clear();
+        return;
+    }
+    memory = page;
+    memory_size = bytes.size();
+    fn = reinterpret_cast<NativeFn>(page);
+
+    std::sort(used_slots.begin(), used_slots.end());
+    used_slots.erase(std::unique(used_slots.begin(), used_slots.end()), used_slots.end());
+#else
+    (void)eval;
+#endif
+}
+
+void JitExpr::release() {
+#ifdef EXPRCALC_HAS_JIT
+    if (memory) munmap(memory, memory_size);
+#endif
+    memory = nullptr;
+    memory_size = 0;
+    fn = nullptr;
+}
+
+JitExpr::~JitExpr() {
+    release();
+}
+
+JitExpr::JitExpr(JitExpr&& other) noexcept
+    : program(std::move(other.program)), used_slots(std::move(other.used_slots)),
+      functions(std::move(other.functions)), memory(std::exchange(other.memory, nullptr)), memory_size(std::exchange(other.memory_size, 0)),
+      fn(std::exchange(other.fn, nullptr)) {}
+
+JitExpr& JitExpr::operator=(JitExpr&& other) noexcept {
+    if (this != &other) {
+        release();
+        program = std::move(other.program);
+        used_slots = std::move(other.used_slots);
+        functions = std::move(other.functions);
+        memory = std::exchange(other.memory, nullptr);
+        memory_size = std::exchange(other.memory_size, 0);
+        fn = std::exchange(other.fn, nullptr);
+    }
+    return *this;
+}
+
+Value JitExpr::evaluate(Evaluator& eval) const {
+    if (!fn || eval.slot_count() < program.slots_required()) return program.evaluate(eval);
+    for (uint32_t slot : used_slots) {
+        if (!eval.is_defined(VarSlot{ slot })) return program.evaluate(eval);
+    }
+    double v = fn(eval.slot_values());
+    // NaN 可能是错误（除零等），也可能是真实结果：交给解释器得到一致的值或异常
+    if (std::isnan(v)) return program.evaluate(eval);
+    return Value(v);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "value.h"
+#include "expr.h"
+#include "compiled_expr.h"
+
+class Evaluator;
+struct Function;
+
+// 把表达式翻译为 x86-64 机器码（SSE2），放在 mmap 出的可执行页中，不依赖外部 JIT 库。
+// 生成的函数直接读取 Evaluator::slot_values()，运算语义（EPS 比较等）与 operators.h 一致；
+// 一元、二元函数在编译时从 Evaluator::functions 取出函数指针直接调用（sqrt、abs 内联为指令），
+// 用到的 Function 由 JitExpr 持有：之后删除或重新注册同名函数时，机器码仍调用编译时的函数并给它计数
+// （回退到解释器时按调用时的函数表执行）；调用计数用原子加一累加到同一个 Function。
+// 遇到不支持的指令（赋值、参数个数错误、可变参数函数、没有内联的用户函数）或在非 x86-64 Linux 平台上不生成代码，
+// evaluate 退回字节码解释器，结果与错误信息不变。
+class JitExpr {
+public:
+    // 参数为按槽下标排列的变量值；除零等错误时返回 NaN
+    using NativeFn = double (*)(const double* slots);
+private:
+    CompiledExpr program;          // 回退用的字节码
+    std::vector<uint32_t> used_slots; // 生成的代码读取的变量槽
+    std::vector<std::shared_ptr<const Function>> functions; // 生成的代码调用的函数（地址写在代码中）
+    void* memory = nullptr;
+    size_t memory_size = 0;
+    NativeFn fn = nullptr;
+
+    void release();
+public:
+    JitExpr(const Expr* expr, Evaluator& eval);
+    ~JitExpr();
+    JitExpr(JitExpr&& other) noexcept;
+    JitExpr& operator=(JitExpr&& other) noexcept;
+    JitExpr(const JitExpr&) = delete;
+    JitExpr& operator=(const JitExpr&) = delete;
+
+    // 变量都已定义且结果不是 NaN 时直接返回机器码的结果，否则交给解释器（得到相同的值或异常；
+    // 机器码算出 NaN 后回退时，这次求值中的函数调用会被计数两次）
+    Value evaluate(Evaluator& eval) const;
+
+    // 生成的机器码；没有生成时为 nullptr
+    NativeFn native() const { return fn; }
+    size_t code_size() const { return memory_size; }
+    const CompiledExpr& bytecode() const { return program; }
+};
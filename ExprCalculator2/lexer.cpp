@@ -1,74 +1,67 @@
+#include <cctype>
+
 #include "lexer.h"
+#include "number_scan.h"
 
 // 词法分析器
-Lexer::Lexer(const std::string& src) : source(src) {}
+Lexer::Lexer(std::string_view src) : source(src) {}
+
+Token Lexer::make(TokenType type, size_t start) const {
+    return { type, source.substr(start, pos - start) };
+}
+
+Token Lexer::error(const char* msg, size_t start) const {
+    Token tok = make(TokenType::ERROR, start);
+    tok.error = msg;
+    return tok;
+}
 
 Token Lexer::nextToken() {
-    while (pos < source.size() && std::isspace(source[pos])) pos++;
-    if (pos >= source.size()) return { TokenType::END, "" };
+    auto at = [&](size_t i) { return static_cast<unsigned char>(source[i]); };
+
+    while (pos < source.size() && std::isspace(at(pos))) pos++;
+    if (pos >= source.size()) return { TokenType::END, source.substr(pos, 0) };
 
-    char c = source[pos];
-    // 处理数字（含小数）
+    size_t start = pos;
+    unsigned char c = at(pos);
+    // 数值字面量（小数、科学计数法、十六进制、数字分隔符）
     if (std::isdigit(c) || c == '.') {
-        size_t start = pos;
-        bool has_dot = false;
-        while (pos < source.size() && (std::isdigit(source[pos]) || source[pos] == '.')) {
-            if (source[pos] == '.') {
-                if (has_dot) break;
-                has_dot = true;
-            }
-            pos++;
-        }
-        std::string num_str = source.substr(start, pos - start);
-        try {
-            double val = std::stod(num_str);
-            return { TokenType::NUMBER, num_str, val };
-        }
-        catch (...) {
-            return { TokenType::ERROR, "Invalid number" };
-        }
+        NumberScan num = scan_number(source.substr(pos));
+        pos += num.length;
+        if (!num.ok()) return error(num.message(), start);
+        Token tok = make(TokenType::NUMBER, start);
+        tok.number_value = num.value;
+        return tok;
     }
     // 标识符/关键字
     if (std::isalpha(c) || c == '_') {
-        size_t start = pos;
-        while (pos < source.size() && (std::isalnum(source[pos]) || source[pos] == '_')) pos++;
-        std::string id = source.substr(start, pos - start);
-        return { TokenType::IDENTIFIER, id };
+        while (pos < source.size() && (std::isalnum(at(pos)) || source[pos] == '_')) pos++;
+        return make(TokenType::IDENTIFIER, start);
     }
     // 运算符（按长度优先匹配）
     pos++;
+    auto follows = [&](char next) {
+        if (pos < source.size() && source[pos] == next) { pos++; return true; }
+        return false;
+    };
     switch (c) {
-    case '+': return { TokenType::PLUS, "+" };
-    case '-': return { TokenType::MINUS, "-" };
-    case '*':
-        if (pos < source.size() && source[pos] == '*') { pos++; return { TokenType::POW, "**" }; }
-        return { TokenType::STAR, "*" };
-    case '/': return { TokenType::SLASH, "/" };
-    case '%': return { TokenType::MOD, "%" };
-    case '^': return { TokenType::POW, "^" };
-    case '(': return { TokenType::LPAREN, "(" };
-    case ')': return { TokenType::RPAREN, ")" };
-    case '=':
-        if (pos < source.size() && source[pos] == '=') { pos++; return { TokenType::EQ, "==" }; }
-        return { TokenType::ASSIGN, "=" };
-    case '>':
-        if (pos < source.size() && source[pos] == '=') { pos++; return { TokenType::GE, ">=" }; }
-        return { TokenType::GT, ">" };
-    case '<':
-        if (pos < source.size() && source[pos] == '=') { pos++; return { TokenType::LE, "<=" }; }
-        return { TokenType::LT, "<" };
-    case '!':
-        if (pos < source.size() && source[pos] == '=') { pos++; return { TokenType::NE, "!=" }; }
-        return { TokenType::LOG_NOT, "!" };
-    case '&':
-        if (pos < source.size() && source[pos] == '&') { pos++; return { TokenType::LOG_AND, "&&" }; }
-        return { TokenType::ERROR, "&" };
-    case '|':
-        if (pos < source.size() && source[pos] == '|') { pos++; return { TokenType::LOG_OR, "||" }; }
-        return { TokenType::ERROR, "|" };
-    case '?': return { TokenType::QUESTION, "?" };
-    case ':': return { TokenType::COLON, ":" };
-    case ',': return { TokenType::COMMA, "," };
-    default: return { TokenType::ERROR, std::string("Unexpected char: ") + c };
+    case '+': return make(TokenType::PLUS, start);
+    case '-': return make(TokenType::MINUS, start);
+    case '*': return make(follows('*') ? TokenType::POW : TokenType::STAR, start);
+    case '/': return make(TokenType::SLASH, start);
+    case '%': return make(TokenType::MOD, start);
+    case '^': return make(TokenType::POW, start);
+    case '(': return make(TokenType::LPAREN, start);
+    case ')': return make(TokenType::RPAREN, start);
+    case '=': return make(follows('=') ? TokenType::EQ : TokenType::ASSIGN, start);
+    case '>': return make(follows('=') ? TokenType::GE : TokenType::GT, start);
+    case '<': return make(follows('=') ? TokenType::LE : TokenType::LT, start);
+    case '!': return make(follows('=') ? TokenType::NE : TokenType::LOG_NOT, start);
+    case '&': return follows('&') ? make(TokenType::LOG_AND, start) : error("Unexpected char", start);
+    case '|': return follows('|') ? make(TokenType::LOG_OR, start) : error("Unexpected char", start);
+    case '?': return make(TokenType::QUESTION, start);
+    case ':': return make(follows('=') ? TokenType::REACTIVE_ASSIGN : TokenType::COLON, start);
+    case ',': return make(TokenType::COMMA, start);
+    default: return error("Unexpected char", start);
     }
-}
\ No newline at end of file
+}
@@ -1,14 +1,17 @@
 #pragma once
 
-#include <iostream>
+#include <string_view>
 
 #include "token.h"
 
-// 词法分析器
+// 词法分析器：借用调用方的缓冲区，按需逐个产生 Token
 class Lexer {
-    std::string source;
+    std::string_view source;
     size_t pos = 0;
+
+    Token make(TokenType type, size_t start) const;
+    Token error(const char* msg, size_t start) const;
 public:
-    Lexer(const std::string& src);
+    explicit Lexer(std::string_view src);
     Token nextToken();
-};
\ No newline at end of file
+};
@@ -0,0 +1,125 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "line_reader.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define EXPRCALC_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+LineReader::LineReader(const std::string& file_path) : path(file_path) {
+    if (path == "-") {
+        open_buffered(stdin, false);
+        return;
+    }
+#ifdef EXPRCALC_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            ::close(fd);
+            return;
+        }
+        void* p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ::close(fd);
+            ::madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            mapping = p;
+            mapping_size = static_cast<size_t>(st.st_size);
+            data = static_cast<const char*>(p);
+            size = mapping_size;
+            consumed = mapping_size;
+            return;
+        }
+    }
+    // 不是普通文件（FIFO 等）或映射失败：按块读取
+    std::FILE* f = ::fdopen(fd, "rb");
+    if (!f) {
+        ::close(fd);
+        throw std::runtime_error("Cannot open " + path);
+    }
+    open_buffered(f, true);
+#else
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) throw std::runtime_error("Cannot open " + path);
+    open_buffered(f, true);
+#endif
+}
+
+
+LineReader::~LineReader() {
+#ifdef EXPRCALC_HAS_MMAP
+    if (mapping) ::munmap(mapping, mapping_size);
+#endif
+    if (owns_file) std::fclose(file);
+}
+
+
+void LineReader::open_buffered(std::FILE* f, bool owns) {
+    file = f;
+    owns_file = owns;
+    buffer.resize(CHUNK);
+    data = buffer.data();
+}
+
+
+// 把未读完的部分移到缓冲区开头再读入一块；缓冲区装不下一整行时加倍。没有读到新数据时返回 false
+bool LineReader::fill() {
+    if (!file || eof) return false;
+    size_t tail = size - pos;
+    std::memmove(buffer.data(), buffer.data() + pos, tail);
+    if (tail == buffer.size()) buffer.resize(buffer.size() * 2);
+    size_t want = buffer.size() - tail;
+    size_t n = std::fread(buffer.data() + tail, 1, want, file);
+    if (n < want) {
+        if (std::ferror(file)) throw std::runtime_error("Failed to read " + (path == "-" ? "stdin" : path));
+        eof = true;
+    }
+    data = buffer.data();
+    pos = 0;
+    size = tail + n;
+    consumed += n;
+    return n > 0;
+}
+
+
+// 释放映射中当前位置之前至少 RELEASE_STEP 字节的部分（保留最近的 RELEASE_STEP 字节，调用方可能仍在使用）
+void LineReader::release() {
+#ifdef EXPRCALC_HAS_MMAP
+    if (pos < released + 2 * RELEASE_STEP) return;
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t end = (pos - RELEASE_STEP) / page * page;
+    ::madvise(static_cast<char*>(mapping) + released, end - released, MADV_DONTNEED);
+    released = end;
+#endif
+}
+
+
+bool LineReader::next(std::string_view& line) {
+    if (mapping) release();
+    size_t scanned = pos; // 已确认没有换行符的位置，读入新块后从这里继续找
+    while (true) {
+        const void* nl = scanned < size ? std::memchr(data + scanned, '\n', size - scanned) : nullptr;
+        if (nl) {
+            size_t end = static_cast<const char*>(nl) - data;
+            line = std::string_view(data + pos, end - pos);
+            pos = end + 1;
+            break;
+        }
+        scanned = size - pos; // fill 会把 [pos, size) 移到开头
+        if (!fill()) {
+            if (pos == size) return false;
+            line = std::string_view(data + pos, size - pos);
+            pos = size;
+            break;
+        }
+    }
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 按行读取大文件：普通文件（POSIX 下）整体 mmap，返回的行直接指向映射的内存；
+// 标准输入、管道等按 CHUNK 大小的块读入缓冲区，行跨越块边界时把剩余部分移到缓冲区开头再读。
+// 行不含换行符（"\r\n" 的 '\r' 也去掉），最后一行没有换行符时照常返回。
+// 返回的 string_view 只在下一次调用 next 之前有效；mapped() 时在 LineReader 存续期间一直有效。
+// 映射的文件中已读过的部分每 RELEASE_STEP 字节释放一次（只读的私有映射再次访问时从文件重新读入），
+// 常驻内存不随文件增大。打开或读取失败时抛出 std::runtime_error
+class LineReader {
+    const char* data = nullptr; // 当前可用的数据 [data + pos, data + size)
+    size_t size = 0;
+    size_t pos = 0;
+    uint64_t consumed = 0; // 已读入的字节数
+
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    size_t released = 0; // 映射中 [0, released) 已释放
+
+    std::FILE* file = nullptr;
+    bool owns_file = false;
+    bool eof = false;
+    std::vector<char> buffer;
+    std::string path;
+
+    void open_buffered(std::FILE* f, bool owns);
+    bool fill();
+    void release();
+public:
+    static constexpr size_t CHUNK = 1u << 20;
+    static constexpr size_t RELEASE_STEP = 16u << 20;
+
+    // path 为 "-" 时读标准输入
+    explicit LineReader(const std::string& path);
+    ~LineReader();
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    // 读取下一行，没有更多行时返回 false
+    bool next(std::string_view& line);
+
+    uint64_t bytes() const { return consumed; }
+    bool mapped() const { return mapping != nullptr; }
+};
@@ -1,4 +1,6 @@
-﻿#include <iomanip>
+﻿#include <charconv>
+#include <iostream>
+#include <iomanip>
 
 #include "value.h"
 #include "token.h"
@@ -6,12 +8,75 @@
 #include "lexer.h"
 #include "parser.h"
 #include "evaluator.h"
+#include "expr_cache.h"
+#include "printer.h"
+#include "line_reader.h"
+#include "script_runner.h"
+#include "csv_evaluator.h"
+
+#ifdef _WIN32
+#include <io.h>
+#define EXPRCALC_ISATTY(fd) _isatty(fd)
+#else
+#include <unistd.h>
+#define EXPRCALC_ISATTY(fd) isatty(fd)
+#endif
 
 // 其实这个是半成品，不过由于工程量太大就做这么多吧
 
+namespace {
+
+void usage(std::ostream& os) {
+    os << "Usage: expr_calculator [--interactive] [--batch FILE] [--format plain|csv|jsonl] [--threads N] [--quiet]\n"
+          "  --batch FILE   evaluate FILE line by line (\"-\" for stdin); the default when stdin is not a terminal\n"
+          "  --format F     batch output format (default: plain)\n"
+          "  --threads N    batch worker threads (default: all hardware threads; 1 = sequential)\n"
+          "  --quiet        do not print the throughput summary to stderr\n"
+          "  --interactive  always start the REPL\n"
+          "   or: expr_calculator --csv FILE --expr EXPR [--column NAME] [--threads N] [--quiet]\n"
+          "  --csv FILE     evaluate EXPR on every row of FILE (\"-\" for stdin); header names are variables\n"
+          "  --column NAME  name of the appended result column (default: result)\n";
+}
+
+
+// ==================== 批处理 ====================
+int run_batch(const std::string& path, OutputFormat format, unsigned threads, bool quiet) {
+    Evaluator evaluator;
+    try {
+        LineReader in(path);
+        ScriptRunner runner(evaluator, stdout, format, threads);
+        ScriptRunner::Stats stats = runner.run(in);
+        if (!quiet) std::cerr << ScriptRunner::summary(stats) << '\n';
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+
+// ==================== CSV 逐行求值 ====================
+int run_csv(const std::string& path, std::string_view expr, std::string column, unsigned threads, bool quiet) {
+    Evaluator evaluator;
+    try {
+        CsvEvaluator csv(evaluator, expr, stdout, threads, std::move(column));
+        LineReader in(path);
+        CsvEvaluator::Stats stats = csv.run(in);
+        if (!quiet) std::cerr << CsvEvaluator::summary(stats) << '\n';
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+
 // ==================== REPL 主循环 ====================
-int main() {
+int run_repl() {
     Evaluator evaluator;
+    ExprCache cache; // 重复输入的公式不再重新解析、化简
     std::string line;
 
     std::cout << "Calculator v1.3 \n";
@@ -23,29 +88,23 @@ int main() {
         if (line == "exit") break;
 
         try {
-            // 将输入转化为tokens
-            Parser parser(line);
-
-            // 将tokens转为AST
-            auto ast = parser.parse();
-
-            // 将AST转化为最简形式的AST
-            auto simplified_ast = ast->simplify();
+            // 解析并化简为最简形式的AST（命中缓存时直接复用），小的用户函数内联到调用处
+            auto simplified_ast = cache.get(line, &evaluator.functions);
 
             // 输出化简后的符号表达式
-            std::cout << "Simplified: " << simplified_ast->to_string() << std::endl;
+            std::cout << "Simplified: " << **simplified_ast << std::endl;
 
             // 尝试求值（仅当无未定义变量时）
-            try {
-                Value result = evaluator.evaluate(simplified_ast.get());
-                if (result.is_number()) {
-                    std::cout << "Result: " << std::fixed << std::setprecision(10) << result.num << std::endl;
+            EvalResult result = evaluator.try_evaluate(simplified_ast->get());
+            if (result) {
+                if (result->is_number()) {
+                    std::cout << "Result: " << std::fixed << std::setprecision(10) << result->num << std::endl;
                 }
                 std::cout.unsetf(std::ios::fixed);
             }
-            catch (const std::runtime_error& e) {
+            else {
                 // 求值失败（含未定义变量），仅提示
-                std::cout << "Note: " << e.what() << " (only symbolic simplification available)\n";
+                std::cout << "Note: " << result.error().message() << " (only symbolic simplification available)\n";
             }
             std::cout << std::endl;
 
@@ -57,4 +116,62 @@ int main() {
 
     std::cout << "Goodbye!\n";
     return 0;
-}
\ No newline at end of file
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string batch;
+    std::string csv;
+    std::string expr;
+    std::string column = "result";
+    OutputFormat format = OutputFormat::PLAIN;
+    unsigned threads = 0;
+    bool interactive = false;
+    bool quiet = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            if (arg == "--interactive") interactive = true;
+            else if (arg == "--quiet") quiet = true;
+            else if (arg == "--batch" && i + 1 < argc) batch = argv[++i];
+            else if (arg == "--csv" && i + 1 < argc) csv = argv[++i];
+            else if (arg == "--expr" && i + 1 < argc) expr = argv[++i];
+            else if (arg == "--column" && i + 1 < argc) column = argv[++i];
+            else if (arg == "--format" && i + 1 < argc) format = parse_output_format(argv[++i]);
+            else if (arg == "--threads" && i + 1 < argc) {
+                std::string_view n = argv[++i];
+                auto [end, ec] = std::from_chars(n.data(), n.data() + n.size(), threads);
+                if (ec != std::errc() || end != n.data() + n.size()) {
+                    usage(std::cerr);
+                    return 2;
+                }
+            }
+            else if (arg == "--help") {
+                usage(std::cout);
+                return 0;
+            }
+            else {
+                usage(std::cerr);
+                return 2;
+            }
+        }
+    }
+    catch (const std::invalid_argument& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 2;
+    }
+
+    if (!csv.empty() || !expr.empty()) {
+        if (csv.empty() || expr.empty()) {
+            usage(std::cerr);
+            return 2;
+        }
+        return run_csv(csv, expr, std::move(column), threads, quiet);
+    }
+
+    // 未指定文件且标准输入不是终端（管道、重定向）时按批处理读取标准输入
+    if (batch.empty() && !interactive && !EXPRCALC_ISATTY(0)) batch = "-";
+    if (!batch.empty() && !interactive) return run_batch(batch, format, threads, quiet);
+    return run_repl();
+}
@@ -1,21 +1,36 @@
 #include "evaluator.h" // 节点递归运算需要
-#include <sstream>
-
 #include "number_expr.h"
+#include "compiled_expr.h"
+#include "printer.h"
+#include "expr_dag.h"
+#include "differentiator.h"
 
 NumberExpr::NumberExpr(double v) : val(v) {}
 
-Value NumberExpr::evaluate(Evaluator&) const {
+EvalResult NumberExpr::try_evaluate(Evaluator&) const {
     return Value(val);
 }
 
-std::string NumberExpr::to_string() const {
-    std::ostringstream oss;
-    oss << val;
-    return oss.str();
+void NumberExpr::print(Printer& p) const {
+    p.number(val);
+}
+
+
+const Expr* NumberExpr::simplify(ExprDag& dag) const {
+    return dag.number(val, this);
 }
 
 
-std::unique_ptr<Expr> NumberExpr::simplify() const {
-    return std::make_unique<NumberExpr>(val);
-}
\ No newline at end of file
+void NumberExpr::compile(Compiler& c) const {
+    c.emit(OpCode::PUSH_CONST, c.constant(val));
+}
+
+
+const Expr* NumberExpr::share(ExprDag& dag) const {
+    return dag.number(val);
+}
+
+
+const Expr* NumberExpr::derive(Differentiator& d) const {
+    return d.number(0.0);
+}
@@ -3,11 +3,14 @@
 #include "expr.h"
 
 // 字面量
-class NumberExpr : public Expr {
+class NumberExpr final : public Expr {
 public:
     double val;
     NumberExpr(double v);
-    Value evaluate(Evaluator&) const override;
-    std::unique_ptr<Expr> simplify() const override;
-    std::string to_string() const override;
+    EvalResult try_evaluate(Evaluator&) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
 };
\ No newline at end of file
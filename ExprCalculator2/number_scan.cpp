@@ -0,0 +1,86 @@
+#include <charconv>
+#include <string>
+
+#include "number_scan.h"
+
+namespace {
+
+bool is_dec(char c) { return c >= '0' && c <= '9'; }
+bool is_hex(char c) { return is_dec(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+bool is_sep(char c) { return c == '_' || c == '\''; }
+
+// 扫描一串数字（允许数字之间出现分隔符），返回结束位置
+template <class IsDigit>
+size_t scan_digits(std::string_view s, size_t i, IsDigit is_digit, bool& has_sep) {
+    while (i < s.size()) {
+        if (is_digit(s[i])) { ++i; continue; }
+        if (is_sep(s[i]) && i > 0 && is_digit(s[i - 1]) && i + 1 < s.size() && is_digit(s[i + 1])) {
+            has_sep = true;
+            ++i;
+            continue;
+        }
+        break;
+    }
+    return i;
+}
+
+// 指数部分：标记字母 + 可选符号 + 至少一位十进制数字；不完整时不消费（如 2e 表示 2 后接变量 e）
+size_t scan_exponent(std::string_view s, size_t i, char lower, char upper, bool& has_sep) {
+    if (i >= s.size() || (s[i] != lower && s[i] != upper)) return i;
+    size_t j = i + 1;
+    if (j < s.size() && (s[j] == '+' || s[j] == '-')) ++j;
+    if (j >= s.size() || !is_dec(s[j])) return i;
+    return scan_digits(s, j, is_dec, has_sep);
+}
+
+} // namespace
+
+const char* NumberScan::message() const {
+    switch (status) {
+    case Status::OK: return "OK";
+    case Status::OUT_OF_RANGE: return "Number out of range";
+    default: return "Invalid number";
+    }
+}
+
+NumberScan scan_number(std::string_view text) {
+    NumberScan result;
+    bool has_sep = false;
+    bool hex = text.size() > 1 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+
+    size_t body = hex ? 2 : 0; // from_chars 不接受 0x 前缀
+    size_t end;
+    if (hex) {
+        end = scan_digits(text, body, is_hex, has_sep);
+        if (end < text.size() && text[end] == '.') end = scan_digits(text, end + 1, is_hex, has_sep);
+        end = scan_exponent(text, end, 'p', 'P', has_sep);
+    }
+    else {
+        end = scan_digits(text, body, is_dec, has_sep);
+        if (end < text.size() && text[end] == '.') end = scan_digits(text, end + 1, is_dec, has_sep);
+        end = scan_exponent(text, end, 'e', 'E', has_sep);
+    }
+    result.length = end;
+
+    std::string_view digits = text.substr(body, end - body);
+    // 含分隔符时先去掉分隔符；常见的短字面量放在栈上
+    char small[64];
+    std::string large;
+    if (has_sep) {
+        char* out = small;
+        if (digits.size() > sizeof(small)) {
+            large.resize(digits.size());
+            out = large.data();
+        }
+        size_t n = 0;
+        for (char c : digits) if (!is_sep(c)) out[n++] = c;
+        digits = std::string_view(out, n);
+    }
+
+    auto fmt = hex ? std::chars_format::hex : std::chars_format::general;
+    auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), result.value, fmt);
+    if (ec == std::errc::result_out_of_range) result.status = NumberScan::Status::OUT_OF_RANGE;
+    else if (ec != std::errc() || ptr != digits.data() + digits.size()) result.status = NumberScan::Status::INVALID;
+    else result.status = NumberScan::Status::OK;
+    return result;
+}
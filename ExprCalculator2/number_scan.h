@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string_view>
+
+// 数值字面量扫描（不抛异常，不依赖 locale）
+//   十进制：123  1.5  .5  6.02e23  1e-9
+//   十六进制：0xFF  0x1.8p3
+//   数字分隔符：1_000_000  1'000'000（只能出现在两个数字之间）
+// 转换基于 std::from_chars，结果与最近舍入的精确值一致，可以无损往返。
+struct NumberScan {
+    enum class Status { OK, INVALID, OUT_OF_RANGE };
+
+    Status status = Status::INVALID;
+    size_t length = 0;   // 从起点开始属于该字面量的字符数
+    double value = 0.0;
+
+    bool ok() const { return status == Status::OK; }
+    const char* message() const;
+};
+
+// 从 text 开头扫描一个数值字面量，text 需以数字或 '.' 开头
+NumberScan scan_number(std::string_view text);
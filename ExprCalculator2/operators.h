@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+
+#include "token_type.h"
+
+// 运算符的数值语义：树求值与字节码 VM 等后端共用，保证结果和错误信息完全一致
+namespace operators {
+
+// 二元运算符的优先级（数值越大结合越紧），Parser 与 Printer 共用；0 表示不是二元运算符
+constexpr int precedence(TokenType op) {
+    switch (op) {
+    case TokenType::ASSIGN: case TokenType::REACTIVE_ASSIGN: return 1;
+    case TokenType::QUESTION: return 2;
+    case TokenType::LOG_OR: return 3;
+    case TokenType::LOG_AND: return 4;
+    case TokenType::EQ: case TokenType::NE: return 5;
+    case TokenType::GT: case TokenType::LT: case TokenType::GE: case TokenType::LE: return 6;
+    case TokenType::PLUS: case TokenType::MINUS: return 7;
+    case TokenType::STAR: case TokenType::SLASH: case TokenType::MOD: return 8;
+    case TokenType::POW: return 9;
+    default: return 0;
+    }
+}
+
+// 一元运算、字面量、变量、函数调用与括号：比任何二元运算符结合得都紧
+constexpr int PRIMARY = 10;
+
+// 右结合的运算符：a ^ b ^ c = a ^ (b ^ c)
+constexpr bool right_assoc(TokenType op) { return op == TokenType::POW || op == TokenType::ASSIGN; }
+
+constexpr std::string_view symbol(TokenType op) {
+    switch (op) {
+    case TokenType::PLUS: return "+";
+    case TokenType::MINUS: return "-";
+    case TokenType::STAR: return "*";
+    case TokenType::SLASH: return "/";
+    case TokenType::MOD: return "%";
+    case TokenType::POW: return "^";
+    case TokenType::GT: return ">";
+    case TokenType::LT: return "<";
+    case TokenType::GE: return ">=";
+    case TokenType::LE: return "<=";
+    case TokenType::EQ: return "==";
+    case TokenType::NE: return "!=";
+    case TokenType::LOG_AND: return "&&";
+    case TokenType::LOG_OR: return "||";
+    case TokenType::LOG_NOT: return "!";
+    case TokenType::ASSIGN: return "=";
+    case TokenType::REACTIVE_ASSIGN: return ":=";
+    default: return "?";
+    }
+}
+
+constexpr double EPS = 1e-9;
+
+// 条件表达式、逻辑运算中的真值判断
+inline bool truthy(double v) { return std::abs(v) > EPS; }
+
+inline double divide(double l, double r) {
+    if (std::abs(r) < EPS) throw std::runtime_error("Division by zero");
+    return l / r;
+}
+
+inline double modulo(double l, double r) {
+    if (std::abs(r) < EPS) throw std::runtime_error("Modulo by zero");
+    return std::fmod(l, r);
+}
+
+inline double gt(double l, double r) { return l > r + EPS ? 1.0 : 0.0; }
+inline double lt(double l, double r) { return l < r - EPS ? 1.0 : 0.0; }
+inline double ge(double l, double r) { return l >= r - EPS ? 1.0 : 0.0; }
+inline double le(double l, double r) { return l <= r + EPS ? 1.0 : 0.0; }
+inline double eq(double l, double r) { return std::abs(l - r) < EPS ? 1.0 : 0.0; }
+inline double ne(double l, double r) { return std::abs(l - r) >= EPS ? 1.0 : 0.0; }
+inline double logical_and(double l, double r) { return (truthy(l) && truthy(r)) ? 1.0 : 0.0; }
+inline double logical_or(double l, double r) { return (truthy(l) || truthy(r)) ? 1.0 : 0.0; }
+inline double logical_not(double v) { return std::abs(v) < EPS ? 1.0 : 0.0; }
+
+// binary 能计算的运算符（赋值等需要由调用方处理）
+constexpr bool has_binary(TokenType op) {
+    switch (op) {
+    case TokenType::PLUS: case TokenType::MINUS: case TokenType::STAR: case TokenType::SLASH:
+    case TokenType::MOD: case TokenType::POW:
+    case TokenType::GT: case TokenType::LT: case TokenType::GE: case TokenType::LE:
+    case TokenType::EQ: case TokenType::NE: case TokenType::LOG_AND: case TokenType::LOG_OR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline double binary(TokenType op, double l, double r) {
+    switch (op) {
+    case TokenType::PLUS: return l + r;
+    case TokenType::MINUS: return l - r;
+    case TokenType::STAR: return l * r;
+    case TokenType::SLASH: return divide(l, r);
+    case TokenType::MOD: return modulo(l, r);
+    case TokenType::POW: return std::pow(l, r);
+    case TokenType::GT: return gt(l, r);
+    case TokenType::LT: return lt(l, r);
+    case TokenType::GE: return ge(l, r);
+    case TokenType::LE: return le(l, r);
+    case TokenType::EQ: return eq(l, r);
+    case TokenType::NE: return ne(l, r);
+    case TokenType::LOG_AND: return logical_and(l, r);
+    case TokenType::LOG_OR: return logical_or(l, r);
+    default: throw std::runtime_error("Unhandled binary operator");
+    }
+}
+
+inline double unary(TokenType op, double v) {
+    switch (op) {
+    case TokenType::MINUS: return -v;
+    case TokenType::LOG_NOT: return logical_not(v);
+    default: throw std::runtime_error("Unhandled unary operator");
+    }
+}
+
+} // namespace operators
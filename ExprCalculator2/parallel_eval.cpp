@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#include "parallel_eval.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t elapsed_ns(Clock::time_point since) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count());
+}
+
+// 一个线程待处理的块区间：所有者从队首取，窃取者从队尾取走一半
+struct alignas(64) WorkRange {
+    std::mutex m;
+    size_t begin = 0;
+    size_t end = 0;
+
+    bool pop(size_t& chunk) {
+        std::lock_guard<std::mutex> lock(m);
+        if (begin == end) return false;
+        chunk = begin++;
+        return true;
+    }
+
+    bool stealHalf(size_t& from, size_t& to) {
+        std::lock_guard<std::mutex> lock(m);
+        size_t left = end - begin;
+        if (left == 0) return false;
+        size_t take = (left + 1) / 2;
+        to = end;
+        from = end - take;
+        end = from;
+        return true;
+    }
+
+    void assign(size_t from, size_t to) {
+        std::lock_guard<std::mutex> lock(m);
+        begin = from;
+        end = to;
+    }
+};
+
+} // namespace
+
+ParallelEvaluator::ParallelEvaluator(unsigned threads, size_t rows_per_chunk)
+    : pool(threads), frames(pool.size()), chunk_rows(rows_per_chunk ? rows_per_chunk : 1) {}
+
+ParallelStats ParallelEvaluator::evaluate(const CompiledExpr& expr, const Evaluator& base,
+    std::span<const BatchColumn> columns, std::span<double> out, std::span<uint8_t> errors) {
+    if (!errors.empty() && errors.size() != out.size())
+        throw std::invalid_argument("eval_batch: error mask has the wrong length");
+    for (const auto& col : columns) {
+        if (col.values.size() != out.size())
+            throw std::invalid_argument("eval_batch: column '" + std::string(col.name) + "' has the wrong length");
+    }
+
+    const size_t rows = out.size();
+    const size_t chunks = (rows + chunk_rows - 1) / chunk_rows;
+    const unsigned workers = pool.size();
+
+    std::unique_ptr<WorkRange[]> ranges(new WorkRange[workers]);
+    for (unsigned w = 0; w < workers; ++w) ranges[w].assign(chunks * w / workers, chunks * (w + 1) / workers);
+
+    ParallelStats stats;
+    stats.rows = rows;
+    stats.workers.resize(workers);
+    std::vector<size_t> error_rows(workers, 0);
+
+    pool.run([&](unsigned w) {
+        // 变量帧与执行器每个线程一份，在各块之间复用；统计先记在局部变量中，结束时写回一次，避免相邻计数器的伪共享
+        Evaluator& frame = frames[w];
+        frame = base;
+        BatchEvaluator runner(expr, frame, columns, rows);
+        WorkerStats ws;
+        size_t errs = 0;
+
+        auto process = [&](size_t chunk) {
+            auto start = Clock::now();
+            size_t first = chunk * chunk_rows;
+            size_t count = std::min(chunk_rows, rows - first);
+            BatchStats bs = runner.run(first, out.subspan(first, count),
+                errors.empty() ? errors : errors.subspan(first, count));
+            errs += bs.error_rows;
+            ws.rows += count;
+            ++ws.chunks;
+            ws.busy_ns += elapsed_ns(start);
+        };
+
+        for (;;) {
+            size_t chunk;
+            while (ranges[w].pop(chunk)) process(chunk);
+
+            // 本地为空：从下一个线程开始轮流尝试窃取
+            auto start = Clock::now();
+            size_t from = 0, to = 0;
+            bool stolen = false;
+            for (unsigned i = 1; i < workers && !stolen; ++i) stolen = ranges[(w + i) % workers].stealHalf(from, to);
+            ws.steal_ns += elapsed_ns(start);
+            if (!stolen) break; // 区间只会缩小，其他线程手中的块由其自己完成
+            ws.stolen_chunks += to - from;
+            ranges[w].assign(from, to);
+        }
+        stats.workers[w] = ws;
+        error_rows[w] = errs;
+    });
+
+    for (size_t n : error_rows) stats.error_rows += n;
+    return stats;
+}
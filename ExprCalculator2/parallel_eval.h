@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "batch_eval.h"
+#include "evaluator.h"
+#include "thread_pool.h"
+
+// 每个工作线程的统计
+struct WorkerStats {
+    size_t rows = 0;          // 处理的行数
+    size_t chunks = 0;        // 处理的块数
+    size_t stolen_chunks = 0; // 其中从其他线程偷来的块数
+    uint64_t busy_ns = 0;     // 求值耗时
+    uint64_t steal_ns = 0;    // 本地队列为空后寻找/窃取任务的耗时
+};
+
+struct ParallelStats {
+    size_t rows = 0;
+    size_t error_rows = 0;
+    std::vector<WorkerStats> workers;
+};
+
+// 多线程按行并行求值：行按块切分，初始平均分给各线程，线程做完自己的块后从其他线程的队尾窃取一半。
+// 每个线程有自己的变量帧（base 的副本），表达式本身只读共享；每块写入 out 中固定的区间，因此结果与线程数、调度无关，
+// 与单线程 eval_batch 完全相同。错误处理与 eval_batch 相同。
+class ParallelEvaluator {
+    ThreadPool pool;
+    std::vector<Evaluator> frames;
+    size_t chunk_rows;
+public:
+    // threads 为 0 时使用全部硬件线程
+    explicit ParallelEvaluator(unsigned threads = 0, size_t chunk_rows = 4096);
+
+    unsigned threads() const { return pool.size(); }
+
+    // expr 必须是在 base（或其副本）上编译的；未以列给出的变量取 base 中的当前值
+    ParallelStats evaluate(const CompiledExpr& expr, const Evaluator& base, std::span<const BatchColumn> columns,
+        std::span<double> out, std::span<uint8_t> errors = {});
+};
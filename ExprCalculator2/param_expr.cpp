@@ -0,0 +1,42 @@
+#include <stdexcept>
+#include <string>
+
+#include "evaluator.h" // 节点递归运算需要
+#include "param_expr.h"
+#include "compiled_expr.h"
+#include "printer.h"
+#include "expr_dag.h"
+#include "differentiator.h"
+
+ParamExpr::ParamExpr(uint32_t i, std::string_view n) : index(i), name(n) {}
+
+void ParamExpr::print(Printer& p) const {
+    p.text(name);
+}
+
+
+EvalResult ParamExpr::try_evaluate(Evaluator& eval) const {
+    return Value(eval.param(index));
+}
+
+
+const Expr* ParamExpr::simplify(ExprDag& dag) const {
+    return dag.param(index, name, this);
+}
+
+
+void ParamExpr::compile(Compiler& c) const {
+    c.emit(OpCode::LOAD_PARAM, index);
+}
+
+
+// 内联时替换为调用处的实参
+const Expr* ParamExpr::share(ExprDag& dag) const {
+    return dag.substitute(index, name);
+}
+
+
+const Expr* ParamExpr::derive(Differentiator&) const {
+    // 只出现在函数体中，函数体不单独求导
+    throw std::invalid_argument("Cannot differentiate parameter " + std::string(name) + " outside its function");
+}
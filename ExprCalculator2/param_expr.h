@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "expr.h"
+
+// 用户函数体中对第 index 个参数的引用（定义函数时由同名变量绑定而来，见 user_function.h）
+class ParamExpr final : public Expr {
+public:
+    uint32_t index;
+    std::string_view name;
+    ParamExpr(uint32_t i, std::string_view n);
+    EvalResult try_evaluate(Evaluator& eval) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
+};
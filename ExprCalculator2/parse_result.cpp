@@ -0,0 +1,37 @@
+#include <algorithm>
+
+#include "parse_result.h"
+#include "expr_dag.h"
+#include "differentiator.h"
+
+ParseResult::ParseResult(Arena a, const Expr* r) : arena(std::move(a)), root(r) {}
+
+ParseResult ParseResult::simplify(const FunctionRegistry* functions) const& {
+    // 化简结果通常不大于原树，按原树的大小预留第一块；结果直接在 dag 中构造，相同子树共享
+    Arena out(std::max(arena.bytes_used(), Arena::DEFAULT_CHUNK_SIZE));
+    ExprDag dag(out, false, functions);
+    const Expr* simplified = dag.simplify_to_fixpoint(root);
+    return ParseResult(std::move(out), simplified);
+}
+
+ParseResult ParseResult::simplify(const FunctionRegistry* functions) && {
+    ExprDag dag(arena, true, functions);
+    root = dag.simplify_to_fixpoint(root);
+    return std::move(*this);
+}
+
+ParseResult ParseResult::diff(std::string_view variable, const FunctionRegistry* functions) const {
+    Arena out(std::max(arena.bytes_used(), Arena::DEFAULT_CHUNK_SIZE));
+    ExprDag dag(out, false, functions);
+    const Expr* simplified = dag.simplify_to_fixpoint(root);
+    Differentiator d(dag, variable);
+    const Expr* derivative = d.run(simplified);
+    return ParseResult(std::move(out), dag.simplify_to_fixpoint(derivative));
+}
+
+ParseResult ParseResult::share() const {
+    Arena out(std::max(arena.bytes_used(), Arena::DEFAULT_CHUNK_SIZE));
+    ExprDag dag(out);
+    const Expr* shared = root->share(dag);
+    return ParseResult(std::move(out), shared);
+}
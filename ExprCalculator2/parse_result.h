@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string_view>
+
+#include "arena.h"
+#include "expr.h"
+
+class FunctionRegistry;
+
+// 解析结果：持有 AST 所在的 Arena，析构时整棵树一次性释放
+class ParseResult {
+    Arena arena;
+    const Expr* root = nullptr;
+public:
+    ParseResult() = default;
+    ParseResult(Arena a, const Expr* r);
+
+    const Expr* get() const { return root; }
+    const Expr* operator->() const { return root; }
+    const Expr& operator*() const { return *root; }
+    explicit operator bool() const { return root != nullptr; }
+
+    // 化简到不动点（相同子树共享，见 expr_dag.h）。
+    // 左值：在新的 Arena 中构造，原结果保持不变；
+    // 右值：原地化简，沿用本结果的 Arena，结构未变的子树直接复用而不复制（丢弃的节点随 Arena 一起释放）。
+    // 给出函数表时小的用户函数内联到调用处、纯函数的常数调用按它折叠（结果只在 functions.version() 不变时有效），否则只认识内置函数
+    ParseResult simplify(const FunctionRegistry* functions = nullptr) const&;
+    ParseResult simplify(const FunctionRegistry* functions = nullptr) &&;
+    // 对 variable 的导数，化简后返回（见 differentiator.h）。先按 functions 化简，以便内联小的用户函数；
+    // 不能求导时抛出 std::invalid_argument
+    ParseResult diff(std::string_view variable, const FunctionRegistry* functions = nullptr) const;
+    // 不化简，只把相同的子树合并为共享节点
+    ParseResult share() const;
+
+    // AST 占用的内存
+    size_t bytes_used() const { return arena.bytes_used(); }
+    size_t bytes_reserved() const { return arena.bytes_reserved(); }
+};
\ No newline at end of file
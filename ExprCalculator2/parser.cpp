@@ -1,24 +1,23 @@
+#include <algorithm>
 #include <stdexcept>
+#include <string>
 
 #include "parser.h"
-#include "lexer.h"
+#include "operators.h"
+#include "function_registry.h"
 
-Token Parser::current() const { return pos < tokens.size() ? tokens[pos] : Token{ TokenType::END, "" }; }
-void Parser::consume() { if (pos < tokens.size()) pos++; }
+const Token& Parser::current() const { return lookahead; }
+
+void Parser::advance() {
+    lookahead = lexer.nextToken();
+    if (lookahead.type == TokenType::ERROR)
+        throw std::runtime_error(std::string("Lexer error: ") + lookahead.error + ": " + std::string(lookahead.lexeme));
+}
+
+void Parser::consume() { if (lookahead.type != TokenType::END) advance(); }
 
 int Parser::getPrecedence(TokenType op) const {
-    switch (op) {
-    case TokenType::ASSIGN: return 1;
-    case TokenType::QUESTION: return 2;
-    case TokenType::LOG_OR: return 3;
-    case TokenType::LOG_AND: return 4;
-    case TokenType::EQ: case TokenType::NE: return 5;
-    case TokenType::GT: case TokenType::LT: case TokenType::GE: case TokenType::LE: return 6;
-    case TokenType::PLUS: case TokenType::MINUS: return 7;
-    case TokenType::STAR: case TokenType::SLASH: case TokenType::MOD: return 8;
-    case TokenType::POW: return 9;
-    default: return 0;
-    }
+    return operators::precedence(op);
 }
 
 bool Parser::isBinaryOp(TokenType t) const {
@@ -30,7 +29,7 @@ bool Parser::isBinaryOp(TokenType t) const {
         t == TokenType::ASSIGN;
 }
 
-std::unique_ptr<Expr> Parser::parseExpression(int min_precedence) {
+const Expr* Parser::parseExpression(int min_precedence) {
     auto lhs = parsePrimary();
     while (isBinaryOp(current().type)) {
         auto op = current().type;
@@ -42,42 +41,56 @@ std::unique_ptr<Expr> Parser::parseExpression(int min_precedence) {
             if (current().type != TokenType::COLON) throw std::runtime_error("Expected ':' in ternary");
             consume();
             auto false_expr = parseExpression(prec);
-            lhs = std::make_unique<ConditionalExpr>(std::move(lhs), std::move(true_expr), std::move(false_expr));
+            lhs = arena->make<ConditionalExpr>(lhs, true_expr, false_expr);
             continue;
         }
-        int next_prec = (op == TokenType::ASSIGN || op == TokenType::POW) ? prec : prec + 1;
+        int next_prec = operators::right_assoc(op) ? prec : prec + 1;
         auto rhs = parseExpression(next_prec);
-        lhs = std::make_unique<BinaryExpr>(std::move(lhs), op, std::move(rhs));
+        lhs = arena->make<BinaryExpr>(lhs, op, rhs);
     }
     return lhs;
 }
 
-std::unique_ptr<Expr> Parser::parsePrimary() {
+const Expr* Parser::parsePrimary() {
+    bool statement = at_start;
+    at_start = false;
     auto tok = current(); consume();
     switch (tok.type) {
     case TokenType::NUMBER:
-        return std::make_unique<NumberExpr>(tok.number_value);
+        return arena->make<NumberExpr>(tok.number_value);
     case TokenType::IDENTIFIER: {
         if (current().type == TokenType::LPAREN) {
             consume();
-            std::vector<std::unique_ptr<Expr>> args;
+            size_t base = arg_stack.size();
             if (current().type != TokenType::RPAREN) {
-                args.push_back(parseExpression());
+                arg_stack.push_back(parseExpression());
                 while (current().type == TokenType::COMMA) {
                     consume();
-                    args.push_back(parseExpression());
+                    arg_stack.push_back(parseExpression());
                 }
             }
             if (current().type != TokenType::RPAREN) throw std::runtime_error("Expected ')'");
             consume();
-            return std::make_unique<CallExpr>(tok.lexeme, std::move(args));
+            auto args = arena->copy(std::span<const Expr* const>(arg_stack.data() + base, arg_stack.size() - base));
+            arg_stack.resize(base);
+            if (current().type == TokenType::ASSIGN) {
+                if (!statement) throw std::runtime_error("Function definitions are only allowed at the top level");
+                return parseDefinition(tok.lexeme, args);
+            }
+            return arena->make<CallExpr>(arena->copy(tok.lexeme), args);
         }
         if (current().type == TokenType::ASSIGN) {
             consume();
             auto val = parseExpression();
-            return std::make_unique<AssignExpr>(tok.lexeme, std::move(val));
+            return arena->make<AssignExpr>(arena->copy(tok.lexeme), val);
         }
-        return std::make_unique<VariableExpr>(tok.lexeme);
+        if (current().type == TokenType::REACTIVE_ASSIGN) {
+            if (!statement) throw std::runtime_error("Reactive bindings are only allowed at the top level");
+            consume();
+            auto formula = parseExpression();
+            return arena->make<ReactiveAssignExpr>(arena->copy(tok.lexeme), formula);
+        }
+        return arena->make<VariableExpr>(arena->copy(tok.lexeme));
     }
     case TokenType::LPAREN: {
         auto expr = parseExpression();
@@ -86,29 +99,46 @@ std::unique_ptr<Expr> Parser::parsePrimary() {
         return expr;
     }
     case TokenType::MINUS:
-        return std::make_unique<UnaryExpr>(TokenType::MINUS, parsePrimary());
+        return arena->make<UnaryExpr>(TokenType::MINUS, parsePrimary());
     case TokenType::LOG_NOT:
-        return std::make_unique<UnaryExpr>(TokenType::LOG_NOT, parsePrimary());
+        return arena->make<UnaryExpr>(TokenType::LOG_NOT, parsePrimary());
     case TokenType::QUESTION:
         throw std::runtime_error("Ternary handled in binary parsing");
     default:
-        throw std::runtime_error("Unexpected token in primary: " + tok.lexeme);
+        throw std::runtime_error("Unexpected token in primary: " + std::string(tok.lexeme));
     }
 }
 
 
-Parser::Parser(const std::string& input) {
-    Lexer lexer(input);
-    Token tok;
-    while ((tok = lexer.nextToken()).type != TokenType::END) {
-        if (tok.type == TokenType::ERROR) throw std::runtime_error("Lexer error: " + tok.lexeme);
-        tokens.push_back(tok);
+const Expr* Parser::parseDefinition(std::string_view name, std::span<const Expr* const> params) {
+    consume(); // '='
+    if (params.size() >= Function::ANY) throw std::runtime_error("Too many parameters in definition of " + std::string(name));
+    std::vector<std::string_view> names;
+    names.reserve(params.size());
+    for (const Expr* p : params) {
+        auto var = dynamic_cast<const VariableExpr*>(p);
+        if (!var) throw std::runtime_error("Parameters of " + std::string(name) + " must be plain names");
+        if (std::find(names.begin(), names.end(), var->name) != names.end())
+            throw std::runtime_error("Duplicate parameter " + std::string(var->name) + " in definition of " + std::string(name));
+        names.push_back(var->name); // 名字已在 arena 中
     }
+    auto body = parseExpression();
+    return arena->make<FunctionDefExpr>(arena->copy(name), arena->copy(std::span<const std::string_view>(names)), body);
 }
 
-std::unique_ptr<Expr> Parser::parse() {
-    if (tokens.empty()) throw std::runtime_error("Empty expression");
+
+Parser::Parser(std::string_view input) : lexer(input) {
+    advance(); // 预读第一个 Token
+}
+
+ParseResult Parser::parse() {
+    if (current().type == TokenType::END) throw std::runtime_error("Empty expression");
+    Arena nodes;
+    arena = &nodes;
+    arg_stack.clear();
+    at_start = true;
     auto expr = parseExpression();
-    if (pos < tokens.size()) throw std::runtime_error("Unexpected token after expression");
-    return expr;
-}
\ No newline at end of file
+    if (current().type != TokenType::END) throw std::runtime_error("Unexpected token after expression");
+    arena = nullptr;
+    return ParseResult(std::move(nodes), expr);
+}
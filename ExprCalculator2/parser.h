@@ -2,22 +2,35 @@
 
 #include <vector>
 #include <memory>
+#include <span>
+#include <string_view>
 
 #include "token.h"
+#include "lexer.h"
 #include "exprs.h"
+#include "parse_result.h"
 
+// 语法分析器：从 Lexer 按需拉取 Token，只保留一个前瞻 Token。
+// 以 f(x, y) = ... 开头的输入是函数定义（FunctionDefExpr），以 b := ... 开头的是响应式绑定（ReactiveAssignExpr），
+// 两者都只能出现在最外层。
+// 输入缓冲区由调用方持有，必须在 parse() 返回前保持有效；AST 中的名字会复制进 Arena。
 class Parser {
-    std::vector<Token> tokens;
-    size_t pos = 0;
-    Token current() const;
+    Lexer lexer;
+    Token lookahead;
+    Arena* arena = nullptr;
+    std::vector<const Expr*> arg_stack; // 嵌套调用共用的参数栈，避免每次调用单独分配
+    bool at_start = false; // 下一个 primary 是整个输入的开头（只有这里允许函数定义与响应式绑定）
+    const Token& current() const;
+    void advance();
     void consume();
 
     int getPrecedence(TokenType op) const;
     bool isBinaryOp(TokenType t) const;
 
-    std::unique_ptr<Expr> parseExpression(int min_precedence = 0);
-    std::unique_ptr<Expr> parsePrimary();
+    const Expr* parseExpression(int min_precedence = 0);
+    const Expr* parsePrimary();
+    const Expr* parseDefinition(std::string_view name, std::span<const Expr* const> params);
 public:
-    Parser(const std::string& input);
-    std::unique_ptr<Expr> parse();
-};
\ No newline at end of file
+    explicit Parser(std::string_view input);
+    ParseResult parse();
+};
@@ -0,0 +1,479 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "polynomial.h"
+#include "expr_dag.h"
+#include "exprs.h"
+
+namespace {
+
+using Factor = Polynomial::Factor;
+
+uint32_t hash_factors(const Factor* f, uint32_t count) {
+    uint64_t h = count;
+    for (uint32_t i = 0; i < count; ++i) {
+        uint64_t bits;
+        std::memcpy(&bits, &f[i].exp, sizeof(bits));
+        h = (h ^ reinterpret_cast<uintptr_t>(f[i].base)) * 0x9E3779B97F4A7C15ull;
+        h = (h ^ bits) * 0x9E3779B97F4A7C15ull;
+    }
+    h ^= h >> 29;
+    return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+bool same_factor(const Factor& a, const Factor& b) {
+    return a.base == b.base && a.exp == b.exp;
+}
+
+// 变量按名字排在前面，其余因子按结构哈希，哈希相同时才看构造顺序
+bool factor_less(const Factor& a, const Factor& b) {
+    if (a.base == b.base) return false;
+    bool a_var = !a.name.empty();
+    bool b_var = !b.name.empty();
+    if (a_var != b_var) return a_var;
+    if (a_var) return a.name < b.name;
+    if (a.shape != b.shape) return a.shape < b.shape;
+    return a.base->dag_serial() < b.base->dag_serial();
+}
+
+// 按因子的字典序，同一底数指数高的在前，x*y 排在 x 之前
+bool term_less(std::span<const Factor> a, std::span<const Factor> b) {
+    size_t n = std::min(a.size(), b.size());
+    for (size_t i = 0; i < n; ++i) {
+        if (a[i].base != b[i].base) return factor_less(a[i], b[i]);
+        if (a[i].exp != b[i].exp) return a[i].exp > b[i].exp;
+    }
+    return a.size() > b.size();
+}
+
+// 能精确表示的非负整数；只有这样的指数才能相加、相乘而不改变结果
+// （y^0.5 * y^0.5 在 y < 0 时是 NaN 而 y 不是，x^-1 * x 在 x = 0 时不是 1）
+bool whole_exponent(double k) {
+    return k >= 0 && k <= 9007199254740992.0 && std::trunc(k) == k;
+}
+
+// 排序并合并同底数的因子，返回剩下的因子数
+uint32_t normalize(std::span<Factor> f) {
+    std::sort(f.begin(), f.end(), factor_less);
+    size_t n = 0;
+    for (const Factor& x : f) {
+        if (n > 0 && f[n - 1].base == x.base && whole_exponent(f[n - 1].exp + x.exp)) f[n - 1].exp += x.exp;
+        else f[n++] = x;
+    }
+    return static_cast<uint32_t>(n);
+}
+
+// hint 为原地化简时的原节点（BinaryExpr），结构相同的那一层直接收入原节点
+const Expr* monomial(ExprDag& dag, double coeff, std::span<const Factor> f, const Expr* hint) {
+    const Expr* product = nullptr;
+    for (const Factor& x : f) {
+        const Expr* p = x.exp == 1 ? x.base : dag.binary(x.base, TokenType::POW, dag.number(x.exp), hint);
+        product = product ? dag.binary(product, TokenType::STAR, p, hint) : p;
+    }
+    if (coeff == 1) return product;
+    if (coeff == -1) return dag.unary(TokenType::MINUS, product);
+    return dag.binary(dag.number(coeff), TokenType::STAR, product, hint);
+}
+
+bool is_polynomial_node(const Expr* e) {
+    if (auto bin = dynamic_cast<const BinaryExpr*>(e)) {
+        switch (bin->get_op()) {
+        case TokenType::PLUS:
+        case TokenType::MINUS:
+        case TokenType::STAR:
+        case TokenType::POW:
+            return true;
+        default:
+            return false;
+        }
+    }
+    auto un = dynamic_cast<const UnaryExpr*>(e);
+    return un && un->get_op() == TokenType::MINUS;
+}
+
+// 遍历原始（未化简的）树，把 +、-、* 链上的叶子收集为单项式
+class Collector {
+    struct Monomial {
+        double coeff;
+        size_t first; // 因子在 scratch 中的起始下标
+        Polynomial* sum; // 第一个括号因子；最后若只剩它，把系数分配进去
+    };
+
+    ExprDag* dag = nullptr;
+    std::vector<Factor> scratch; // 正在构造的单项式的因子
+    std::vector<std::pair<const Expr*, double>> pending; // 加法链上待处理的右操作数及其符号
+    // 嵌套的小多项式很多，用过的放回 spare，保留容量供下次使用
+    std::vector<std::unique_ptr<Polynomial>> owned;
+    std::vector<Polynomial*> spare;
+
+    void term(const Expr* e, double scale, Polynomial& out);
+    void product(const Expr* e, Monomial& m);
+    void factor(const Expr* e, Monomial& m);
+    void power(const BinaryExpr* e, Monomial& m);
+    void absorb(Polynomial* p, Monomial& m);
+    void close_sum(Monomial& m);
+    void push(const Expr* base, double exp);
+public:
+    void bind(ExprDag& d) { dag = &d; }
+    bool uses(const ExprDag& d) const { return dag == &d; }
+    // 用过很大的多项式后释放缓冲，不留给之后的调用
+    void trim();
+    Polynomial* acquire();
+    void release(Polynomial* p);
+
+    void sum(const Expr* e, double scale, Polynomial& out);
+};
+
+void Collector::sum(const Expr* e, double scale, Polynomial& out) {
+    size_t base = pending.size();
+    for (;;) {
+        // 沿左侧的加法链循环，右操作数按原顺序稍后处理，10 万项的链也不会递归过深
+        for (;;) {
+            if (auto bin = dynamic_cast<const BinaryExpr*>(e)) {
+                TokenType op = bin->get_op();
+                if (op == TokenType::PLUS || op == TokenType::MINUS) {
+                    pending.emplace_back(bin->get_rhs(), op == TokenType::MINUS ? -scale : scale);
+                    e = bin->get_lhs();
+                    continue;
+                }
+            }
+            else if (auto un = dynamic_cast<const UnaryExpr*>(e)) {
+                if (un->get_op() == TokenType::MINUS) {
+                    scale = -scale;
+                    e = un->get_operand();
+                    continue;
+                }
+            }
+            break;
+        }
+        term(e, scale, out);
+        if (pending.size() == base) return;
+        std::tie(e, scale) = pending.back();
+        pending.pop_back();
+    }
+}
+
+void Collector::term(const Expr* e, double scale, Polynomial& out) {
+    Monomial m{ scale, scratch.size(), nullptr };
+    product(e, m);
+    if (m.sum && scratch.size() == m.first && std::isfinite(m.coeff)) {
+        // 常数乘括号：2*(x+1) → 2*x + 2；inf、NaN 不分配进去，否则 inf*(x-x) 之类会变成 inf*x - inf*x
+        out.add(*m.sum, m.coeff);
+        release(m.sum);
+    }
+    else {
+        close_sum(m);
+        out.add(m.coeff, std::span<Factor>(scratch.data() + m.first, scratch.size() - m.first));
+    }
+    scratch.resize(m.first);
+}
+
+void Collector::product(const Expr* e, Monomial& m) {
+    for (;;) {
+        if (auto bin = dynamic_cast<const BinaryExpr*>(e)) {
+            if (bin->get_op() == TokenType::STAR) {
+                product(bin->get_rhs(), m);
+                e = bin->get_lhs();
+                continue;
+            }
+        }
+        else if (auto un = dynamic_cast<const UnaryExpr*>(e)) {
+            if (un->get_op() == TokenType::MINUS) {
+                m.coeff = -m.coeff;
+                e = un->get_operand();
+                continue;
+            }
+        }
+        break;
+    }
+    factor(e, m);
+}
+
+void Collector::factor(const Expr* e, Monomial& m) {
+    if (auto num = dynamic_cast<const NumberExpr*>(e)) {
+        m.coeff *= num->val;
+        return;
+    }
+    if (auto var = dynamic_cast<const VariableExpr*>(e)) {
+        push(dag->variable(var->name, var), 1.0);
+        return;
+    }
+    if (auto bin = dynamic_cast<const BinaryExpr*>(e)) {
+        TokenType op = bin->get_op();
+        if (op == TokenType::PLUS || op == TokenType::MINUS) {
+            Polynomial* p = acquire();
+            sum(e, 1.0, *p);
+            absorb(p, m);
+            return;
+        }
+        if (op == TokenType::POW) {
+            power(bin, m);
+            return;
+        }
+    }
+    // 其余节点照常化简；结果可能是常数或多项式（如条件表达式折叠后）
+    const Expr* s = dag->simplify(e);
+    if (auto num = dynamic_cast<const NumberExpr*>(s)) m.coeff *= num->val;
+    else if (is_polynomial_node(s)) product(s, m);
+    else push(s, 1.0);
+}
+
+void Collector::power(const BinaryExpr* e, Monomial& m) {
+    const Expr* exponent = dag->simplify(e->get_rhs());
+    auto k_num = dynamic_cast<const NumberExpr*>(exponent);
+    if (!k_num) {
+        const Expr* base = dag->simplify(e->get_lhs());
+        // 0 ^ y = 0
+        auto zero = dynamic_cast<const NumberExpr*>(base);
+        if (zero && zero->val == 0) m.coeff *= 0.0;
+        else push(dag->binary(base, TokenType::POW, exponent, e), 1.0);
+        return;
+    }
+    double k = k_num->val;
+    // x ^ 0 = 1
+    if (k == 0) return;
+
+    // 底数的因子接在 m 的因子之后，就地乘上指数
+    Monomial sub{ 1.0, scratch.size(), nullptr };
+    product(e->get_lhs(), sub);
+    if (k == 1) {
+        m.coeff *= sub.coeff;
+        if (sub.sum) absorb(sub.sum, m);
+        return;
+    }
+    close_sum(sub);
+    std::span<Factor> f(scratch.data() + sub.first, scratch.size() - sub.first);
+    bool distribute = whole_exponent(k);
+    for (const Factor& x : f) distribute = distribute && whole_exponent(x.exp * k);
+    if (distribute) {
+        // 非负整数次幂可以分配给每个因子
+        sub.coeff = std::pow(sub.coeff, k);
+        for (Factor& x : f) x.exp *= k;
+    }
+    else if (f.empty()) {
+        sub.coeff = std::pow(sub.coeff, k);
+    }
+    else {
+        // x^0.5、x^-1、(x*y)^0.5、(x^2)^0.5 等不能拆开，整体作为因子
+        Polynomial* p = acquire();
+        p->add(sub.coeff, f);
+        const Expr* base = p->build(*dag);
+        release(p);
+        scratch.resize(sub.first);
+        push(dag->binary(base, TokenType::POW, exponent), 1.0);
+        return;
+    }
+    m.coeff *= sub.coeff;
+}
+
+void Collector::absorb(Polynomial* p, Monomial& m) {
+    if (p->is_constant()) {
+        m.coeff *= p->constant_term();
+    }
+    else if (p->is_monomial()) {
+        m.coeff *= p->monomial_coeff();
+        for (const Factor& x : p->monomial_factors()) scratch.push_back(x);
+    }
+    else if (!m.sum) {
+        m.sum = p;
+        return;
+    }
+    else {
+        push(p->build(*dag), 1.0);
+    }
+    release(p);
+}
+
+void Collector::close_sum(Monomial& m) {
+    if (!m.sum) return;
+    push(m.sum->build(*dag), 1.0);
+    release(m.sum);
+    m.sum = nullptr;
+}
+
+void Collector::trim() {
+    constexpr size_t KEEP_FACTORS = 4096;
+    bool large = scratch.capacity() > KEEP_FACTORS;
+    for (const auto& p : owned) large = large || p->factor_capacity() > KEEP_FACTORS;
+    if (!large) return;
+    scratch = {};
+    pending = {};
+    owned.clear();
+    spare.clear();
+}
+
+Polynomial* Collector::acquire() {
+    if (spare.empty()) {
+        owned.push_back(std::make_unique<Polynomial>());
+        return owned.back().get();
+    }
+    Polynomial* p = spare.back();
+    spare.pop_back();
+    return p;
+}
+
+void Collector::release(Polynomial* p) {
+    p->clear();
+    spare.push_back(p);
+}
+
+void Collector::push(const Expr* base, double exp) {
+    auto var = dynamic_cast<const VariableExpr*>(base);
+    scratch.push_back({ base, exp, var ? var->name : std::string_view(), dag->shape(base) });
+}
+
+thread_local Collector* active_collector = nullptr;
+// 顶层调用之间复用的 Collector（每个线程一个）
+thread_local std::unique_ptr<Collector> idle_collector;
+
+} // namespace
+
+void Polynomial::grow() {
+    index.assign(std::max<size_t>(4 * LINEAR_TERMS, index.size() * 2), 0);
+    size_t mask = index.size() - 1;
+    for (size_t k = 0; k < terms.size(); ++k) {
+        size_t i = terms[k].hash & mask;
+        while (index[i]) i = (i + 1) & mask;
+        index[i] = static_cast<uint32_t>(k + 1);
+    }
+}
+
+void Polynomial::insert(double coeff, const Factor* f, uint32_t count, uint32_t hash) {
+    if (count == 0) {
+        constant += coeff;
+        return;
+    }
+    if (terms.size() < LINEAR_TERMS) {
+        // 项很少时直接顺序比较，不建哈希表
+        for (Term& t : terms) {
+            if (t.hash == hash && t.count == count && std::equal(f, f + count, factors.data() + t.first, same_factor)) {
+                t.coeff += coeff;
+                return;
+            }
+        }
+        terms.push_back({ coeff, static_cast<uint32_t>(factors.size()), count, hash });
+        factors.insert(factors.end(), f, f + count);
+        return;
+    }
+    if ((terms.size() + 1) * 2 > index.size()) grow();
+    size_t mask = index.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (index[i] == 0) {
+            index[i] = static_cast<uint32_t>(terms.size() + 1);
+            terms.push_back({ coeff, static_cast<uint32_t>(factors.size()), count, hash });
+            factors.insert(factors.end(), f, f + count);
+            return;
+        }
+        Term& t = terms[index[i] - 1];
+        if (t.hash == hash && t.count == count && std::equal(f, f + count, factors.data() + t.first, same_factor)) {
+            t.coeff += coeff;
+            return;
+        }
+    }
+}
+
+void Polynomial::clear() {
+    factors.clear();
+    terms.clear();
+    index.clear();
+    constant = 0.0;
+}
+
+void Polynomial::add(double coeff, std::span<Factor> f) {
+    uint32_t count = normalize(f);
+    insert(coeff, f.data(), count, hash_factors(f.data(), count));
+}
+
+void Polynomial::add(const Polynomial& other, double scale) {
+    constant += scale * other.constant;
+    for (const Term& t : other.terms) {
+        insert(scale * t.coeff, other.factors.data() + t.first, t.count, t.hash);
+    }
+}
+
+const Polynomial::Term* Polynomial::single() const {
+    const Term* found = nullptr;
+    for (const Term& t : terms) {
+        if (t.coeff == 0) continue;
+        if (found) return nullptr;
+        found = &t;
+    }
+    return found;
+}
+
+bool Polynomial::is_constant() const {
+    return std::all_of(terms.begin(), terms.end(), [](const Term& t) { return t.coeff == 0; });
+}
+
+bool Polynomial::is_monomial() const {
+    return constant == 0 && single() != nullptr;
+}
+
+double Polynomial::monomial_coeff() const {
+    return single()->coeff;
+}
+
+std::span<const Polynomial::Factor> Polynomial::monomial_factors() const {
+    const Term* t = single();
+    return { factors.data() + t->first, t->count };
+}
+
+const Expr* Polynomial::build(ExprDag& dag, const Expr* original) const {
+    const Expr* hint = dynamic_cast<const BinaryExpr*>(original);
+    // 系数为 0 的项（同类项相消）不输出
+    order.clear();
+    for (const Term& t : terms) {
+        if (t.coeff != 0) order.push_back(&t);
+    }
+    auto span_of = [&](const Term* t) {
+        return std::span<const Factor>(factors.data() + t->first, t->count);
+    };
+    std::sort(order.begin(), order.end(), [&](const Term* a, const Term* b) {
+        return term_less(span_of(a), span_of(b));
+    });
+
+    const Expr* result = nullptr;
+    for (const Term* t : order) {
+        if (!result) result = monomial(dag, t->coeff, span_of(t), hint);
+        else if (t->coeff < 0) result = dag.binary(result, TokenType::MINUS, monomial(dag, -t->coeff, span_of(t), hint), hint);
+        else result = dag.binary(result, TokenType::PLUS, monomial(dag, t->coeff, span_of(t), hint), hint);
+    }
+    if (!result) return dag.number(constant);
+    if (constant < 0) return dag.binary(result, TokenType::MINUS, dag.number(-constant), hint);
+    if (constant != 0) return dag.binary(result, TokenType::PLUS, dag.number(constant), hint);
+    return result;
+}
+
+const Expr* Polynomial::simplify(const Expr* e, ExprDag& dag) {
+    // 因子内部嵌套的多项式（sin(x*2+1) 的参数等）复用外层的 Collector，
+    // 它的缓冲按栈的方式使用，嵌套调用结束时恢复原状
+    Collector* collector = active_collector;
+    std::unique_ptr<Collector> owner;
+    if (!collector || !collector->uses(dag)) {
+        owner = idle_collector ? std::move(idle_collector) : std::make_unique<Collector>();
+        owner->bind(dag);
+        collector = owner.get();
+    }
+    Collector* outer = std::exchange(active_collector, collector);
+    Polynomial* p = collector->acquire();
+    const Expr* result = nullptr;
+    try {
+        collector->sum(e, 1.0, *p);
+        result = p->build(dag, e);
+    }
+    catch (...) {
+        // 出错时缓冲的状态不确定，owner 随之丢弃
+        active_collector = outer;
+        throw;
+    }
+    collector->release(p);
+    active_collector = outer;
+    if (owner) {
+        owner->trim();
+        idle_collector = std::move(owner);
+    }
+    return result;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "expr.h"
+
+class ExprDag;
+
+// 多项式规范形：把 +、-、* 和常数次幂组成的链展平为单项式之和，一次合并全部同类项后重建最简的树。
+// 单项式 = 系数 × 若干因子的幂，因子是变量或不能再展开的子表达式（已化简并在 ExprDag 中共享，指针相同即结构相同）。
+// 因子先按变量名、其余按结构哈希排列（与构造顺序无关），各项按因子的字典序排列、常数项在最后，因此 y*x*3 与 3*x*y 得到同一棵树。
+// 只把常数系数分配进括号（2*(x+1) → 2*x + 2），两个多项式相乘时不展开，括号整体作为因子。
+// 因子的指数总是非负整数：负数或非整数次幂（x^-1、y^0.5）整体作为一个因子，因此 x*x^-1 不会约成 1；inf、NaN 系数不分配进括号。
+class Polynomial {
+public:
+    struct Factor {
+        const Expr* base;
+        double exp;
+        std::string_view name; // base 为变量时的变量名，用于排序
+        uint32_t shape;        // 其余因子按结构哈希排序（见 ExprDag::shape）
+    };
+private:
+    struct Term {
+        double coeff;
+        uint32_t first; // 在 factors 中的起始下标
+        uint32_t count;
+        uint32_t hash;
+    };
+
+    std::vector<Factor> factors; // 各项的因子依次存放
+    std::vector<Term> terms;     // 按首次出现的顺序
+    std::vector<uint32_t> index; // 开放寻址：项下标 + 1，负载不超过 1/2；项数少于 LINEAR_TERMS 时为空
+    static constexpr size_t LINEAR_TERMS = 8;
+    double constant = 0.0;
+    mutable std::vector<const Term*> order; // build 时排序用的缓冲
+
+    void insert(double coeff, const Factor* f, uint32_t count, uint32_t hash);
+    void grow();
+    const Term* single() const; // 唯一一个系数非零的项
+public:
+    // 加上 coeff × f 中因子之积；f 会被原地排序、合并
+    void add(double coeff, std::span<Factor> f);
+    void add(const Polynomial& other, double scale);
+    void add_constant(double c) { constant += c; }
+    // 清空，保留已分配的容量
+    void clear();
+    size_t factor_capacity() const { return factors.capacity(); }
+
+    // 只有常数项 / 只有一个单项式（没有常数项）
+    bool is_constant() const;
+    bool is_monomial() const;
+    double constant_term() const { return constant; }
+    // is_monomial() 时唯一的单项式
+    double monomial_coeff() const;
+    std::span<const Factor> monomial_factors() const;
+
+    // 按规范顺序重建表达式；original 为被化简的原节点，原地化简时结构未变就直接收入它
+    const Expr* build(ExprDag& dag, const Expr* original = nullptr) const;
+
+    // 化简以 +、-、*、^ 或取负为根的表达式
+    static const Expr* simplify(const Expr* e, ExprDag& dag);
+};
@@ -0,0 +1,54 @@
+#include <charconv>
+#include <cmath>
+#include <ostream>
+
+#include "printer.h"
+#include "operators.h"
+
+void Printer::print(const Expr* root) {
+    operand(root, 0);
+}
+
+void Printer::operand(const Expr* e, int min_precedence) {
+    int saved = required;
+    required = min_precedence;
+    e->print(*this);
+    required = saved;
+}
+
+bool Printer::open(int precedence) {
+    if (precedence >= required) return false;
+    out += '(';
+    return true;
+}
+
+void Printer::number(double v) {
+    // 2^53 以内的整数按定点格式输出（100000 而不是最短格式的 1e+05，与 REPL 一致），其余用最短的往返格式
+    constexpr double MAX_EXACT_INTEGER = 9007199254740992.0;
+    char buf[32];
+    char* end;
+    if (std::abs(v) <= MAX_EXACT_INTEGER && std::trunc(v) == v)
+        end = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed).ptr;
+    else
+        end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+    out.append(buf, end);
+}
+
+void Printer::binary_op(TokenType op) {
+    out += ' ';
+    out += operators::symbol(op);
+    out += ' ';
+}
+
+std::string Expr::to_string() const {
+    std::string s;
+    Printer(s).print(this);
+    return s;
+}
+
+std::ostream& operator<<(std::ostream& os, const Expr& e) {
+    thread_local std::string buffer;
+    buffer.clear();
+    Printer(buffer).print(&e);
+    return os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
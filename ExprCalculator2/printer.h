@@ -0,0 +1,34 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+#include "expr.h"
+#include "token_type.h"
+
+// 把表达式追加写入一个可复用的缓冲区：只在优先级需要时加括号（优先级表见 operators::precedence），
+// 数字用 std::to_chars 的最短形式输出（2^53 以内的整数用定点格式，不写成 1e+05），有限值重新解析后得到完全相同的 double（inf、nan 原样输出为 inf、nan）。
+// 输出能被 Parser 解析回等值的表达式；整个过程只向缓冲区追加，不产生中间字符串。
+class Printer {
+    std::string& out;
+    int required = 0; // 当前位置要求的最低优先级，低于它的节点需要加括号
+public:
+    explicit Printer(std::string& buffer) : out(buffer) {}
+
+    // 追加整个表达式
+    void print(const Expr* root);
+    // 在要求优先级至少为 min_precedence 的位置输出子表达式
+    void operand(const Expr* e, int min_precedence);
+
+    // 供各节点的 print 使用：以优先级 precedence 输出时按需写入括号，open 的返回值传给 close
+    bool open(int precedence);
+    void close(bool opened) { if (opened) out += ')'; }
+    void number(double v);
+    void text(std::string_view s) { out += s; }
+    // 二元运算符，两侧各带一个空格
+    void binary_op(TokenType op);
+};
+
+// 写入流：先在线程内复用的缓冲区中生成，再一次写出
+std::ostream& operator<<(std::ostream& os, const Expr& e);
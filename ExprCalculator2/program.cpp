@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "program.h"
+#include "bytecode_vm.h"
+#include "parser.h"
+#include "user_function.h"
+
+// 在 Context 上执行 Program 的一段字节码：函数已在构造时解析
+struct ProgramEnv {
+    Context& ctx;
+    const Program::Unit& unit;
+
+    bool is_defined(uint32_t slot) const { return ctx.defined[slot] != 0; }
+    double get(uint32_t slot) const { return ctx.values[slot]; }
+    void set(uint32_t slot, double v) {
+        ctx.values[slot] = v;
+        ctx.defined[slot] = 1;
+    }
+    double param(uint32_t index) const { return ctx.params[index]; }
+    uint32_t depth() const { return ctx.call_depth; }
+    const Function* function(uint32_t site) const { return unit.sites[site]; }
+    bytecode::Slot call_user(uint32_t site, const Function* fn, const double* args);
+};
+
+bytecode::Slot ProgramEnv::call_user(uint32_t site, const Function*, const double* args) {
+    // 与 CallFrame 相同：设置参数帧并加深一层，出错时也能恢复
+    struct Frame {
+        Context& ctx;
+        const double* saved;
+        Frame(Context& c, const double* values) : ctx(c), saved(c.params) {
+            ctx.params = values;
+            ++ctx.call_depth;
+        }
+        ~Frame() {
+            ctx.params = saved;
+            --ctx.call_depth;
+        }
+    } frame(ctx, args);
+    const Program::Unit& body = *unit.bodies[site];
+    ProgramEnv inner{ ctx, body };
+    return bytecode::run(body.code, inner);
+}
+
+
+Program::Program(const Expr* expr, const FunctionRegistry& table, std::initializer_list<std::string_view> inputs) {
+    // 在临时的 Evaluator 上编译以分配变量槽（函数表只在编译期间用于判断纯函数）
+    Evaluator layout;
+    layout.functions = table;
+    for (std::string_view name : inputs) layout.bind(name);
+    units.push_back(std::make_unique<Unit>(expr, layout));
+
+    // 逐段解析调用点；用户函数体第一次遇到时编译为新的一段（递归调用指向同一段）
+    std::vector<std::pair<const UserFunction*, const Unit*>> compiled;
+    for (size_t u = 0; u < units.size(); ++u) {
+        Unit& unit = *units[u];
+        for (uint32_t site = 0; site < unit.code.call_sites(); ++site) {
+            std::shared_ptr<const Function> fn = table.share(unit.code.name(site));
+            const Unit* body = nullptr;
+            if (fn && fn->user) {
+                auto it = std::find_if(compiled.begin(), compiled.end(),
+                    [&](const auto& c) { return c.first == fn->user.get(); });
+                if (it != compiled.end()) {
+                    body = it->second;
+                }
+                else {
+                    units.push_back(std::make_unique<Unit>(fn->user->body(), layout));
+                    body = units.back().get();
+                    compiled.emplace_back(fn->user.get(), body);
+                }
+            }
+            unit.sites.push_back(fn.get());
+            unit.bodies.push_back(body);
+            if (fn) functions.push_back(std::move(fn));
+        }
+    }
+
+    const size_t slots = layout.slot_count();
+    slot_names.reserve(slots);
+    for (uint32_t i = 0; i < slots; ++i) {
+        VarSlot slot{ i };
+        const std::string& name = layout.name_of(slot);
+        slot_names.push_back(name);
+        slot_index.emplace(name, i);
+        initial.push_back(layout.is_defined(slot) ? layout.get(slot) : 0.0);
+        initial_defined.push_back(layout.is_defined(slot) ? 1 : 0);
+        symbols.push_back(Value::symbol(name));
+    }
+}
+
+
+Program::Program(std::string_view source, const FunctionRegistry& table,
+    std::initializer_list<std::string_view> inputs)
+    : Program(Parser(source).parse().simplify(&table).get(), table, inputs) {}
+
+
+Value Program::run(Context& ctx) const {
+    if (ctx.program != this) throw std::logic_error("Context was created for a different Program");
+    ProgramEnv env{ ctx, *units[0] };
+    bytecode::Slot top = bytecode::run(units[0]->code, env);
+    if (top.sym >= 0) return symbols[top.sym];
+    return Value(top.num);
+}
+
+
+VarSlot Program::variable(std::string_view name) const {
+    auto it = slot_index.find(name);
+    if (it == slot_index.end()) throw std::invalid_argument("Program has no variable " + std::string(name));
+    return { it->second };
+}
+
+
+Context::Context(const Program& p) : program(&p), values(p.initial), defined(p.initial_defined) {}
+
+
+void Context::reset() {
+    values = program->initial;
+    defined = program->initial_defined;
+    params = nullptr;
+    call_depth = 0;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compiled_expr.h"
+#include "evaluator.h"
+#include "function_registry.h"
+#include "string_map.h"
+
+class Context;
+
+// 构造后不再改变的已编译公式，可在多个线程间共享，各线程用自己的 Context 并发调用 run()，不加锁也不复制函数表。
+// 构造时把变量编号为 Program 自己的变量槽（常数 pi、e 也是变量，初始已定义），
+// 函数按 functions 解析并持有（之后 functions 的修改不影响本 Program），
+// 调用的用户函数体（及其间接调用的函数）一并编译，函数体中的全局变量与表达式共用变量槽。
+// 与 CompiledExpr 一样求值不分配内存，结果与错误信息相同（错误以 std::runtime_error 抛出）；
+// 函数调用计数为原子操作，与 Evaluator 共享同一个 Function 时累加到同一处。
+// 表达式中有函数定义或响应式绑定时无法编译（std::invalid_argument）
+class Program {
+    // 一段字节码及其调用点解析到的函数
+    struct Unit {
+        CompiledExpr code;
+        std::vector<const Function*> sites; // 按调用点，未定义的函数为 nullptr
+        std::vector<const Unit*> bodies;    // 按调用点，用户函数的函数体
+        Unit(const Expr* expr, Evaluator& layout) : code(expr, layout) {}
+    };
+    friend struct ProgramEnv;
+    friend class Context;
+
+    std::vector<std::unique_ptr<Unit>> units;              // units[0] 为表达式本身
+    std::vector<std::shared_ptr<const Function>> functions; // 持有解析到的函数
+    StringMap<uint32_t> slot_index;
+    std::vector<std::string> slot_names;
+    std::vector<double> initial;       // Context 的初始值
+    std::vector<uint8_t> initial_defined;
+    std::vector<Value> symbols;        // 各变量未定义时的符号值（预先登记，求值时不查符号表）
+public:
+    // inputs 中的变量在编译前登记，表达式不读取时也有槽，可统一写入一行输入
+    explicit Program(const Expr* expr, const FunctionRegistry& functions = FunctionRegistry::builtins(),
+        std::initializer_list<std::string_view> inputs = {});
+    // 解析源码并按 functions 化简（小的用户函数内联）后编译；语法错误时抛出 std::runtime_error
+    explicit Program(std::string_view source, const FunctionRegistry& functions = FunctionRegistry::builtins(),
+        std::initializer_list<std::string_view> inputs = {});
+    Program(const Program&) = delete;
+    Program& operator=(const Program&) = delete;
+
+    // 在 ctx 的变量上求值；ctx 必须由本 Program 创建。表达式中的赋值写入 ctx
+    Value run(Context& ctx) const;
+
+    size_t variable_count() const { return slot_names.size(); }
+    // 变量的槽，表达式（及调用的函数体）中没有该变量时抛出 std::invalid_argument
+    VarSlot variable(std::string_view name) const;
+    const std::string& name_of(VarSlot slot) const { return slot_names[slot.index]; }
+};
+
+// 一个线程的求值状态：变量帧与用户函数的参数帧。创建与复制都只分配变量数组，可按线程或按请求各持有一个
+class Context {
+    const Program* program;
+    std::vector<double> values;
+    std::vector<uint8_t> defined;
+    const double* params = nullptr;
+    uint32_t call_depth = 0;
+    friend class Program;
+    friend struct ProgramEnv;
+public:
+    // 变量取初始值：常数已定义，其余未定义
+    explicit Context(const Program& p);
+
+    void set(VarSlot slot, double value) {
+        values[slot.index] = value;
+        defined[slot.index] = 1;
+    }
+    void set(std::string_view name, double value) { set(program->variable(name), value); }
+    void unset(VarSlot slot) { defined[slot.index] = 0; }
+    double get(VarSlot slot) const { return values[slot.index]; }
+    bool is_defined(VarSlot slot) const { return defined[slot.index] != 0; }
+    // 恢复为初始值
+    void reset();
+};
@@ -0,0 +1,55 @@
+#include <stdexcept>
+
+#include "evaluator.h" // 节点递归运算需要
+#include "reactive_assign_expr.h"
+#include "compiled_expr.h"
+#include "printer.h"
+#include "operators.h"
+#include "expr_dag.h"
+#include "differentiator.h"
+
+// 响应式绑定
+ReactiveAssignExpr::ReactiveAssignExpr(std::string_view name, const Expr* f)
+        : var_name(name), formula(f) {}
+
+void ReactiveAssignExpr::print(Printer& p) const {
+    bool opened = p.open(operators::precedence(TokenType::REACTIVE_ASSIGN));
+    p.text(var_name);
+    p.binary_op(TokenType::REACTIVE_ASSIGN);
+    p.operand(formula, 0);
+    p.close(opened);
+}
+
+
+EvalResult ReactiveAssignExpr::try_evaluate(Evaluator& eval) const {
+    if (!eval.define_reactive(var_name, formula)) return EvalError{ EvalErrc::CYCLIC_BINDING, this };
+    if (const double* v = eval.findVariable(var_name)) return Value(*v);
+    // 读取的变量还未定义时结果为符号值；其他错误照常报告（绑定仍然保留，输入变化后会重新计算）
+    EvalResult r = formula->try_evaluate(eval);
+    if (!r && r.error().code != EvalErrc::UNDEFINED_VARIABLE) return r;
+    return Value::symbol(var_name);
+}
+
+
+// 与函数体一样不内联调用：公式中的函数按名字在重新计算时查找
+const Expr* ReactiveAssignExpr::simplify(ExprDag& dag) const {
+    bool inlining = dag.set_inlining(false);
+    const Expr* new_formula = dag.simplify(formula);
+    dag.set_inlining(inlining);
+    return dag.reactive_assign(var_name, new_formula, new_formula == formula ? this : nullptr);
+}
+
+
+void ReactiveAssignExpr::compile(Compiler&) const {
+    throw std::invalid_argument("Reactive bindings cannot be compiled; evaluate them instead");
+}
+
+
+const Expr* ReactiveAssignExpr::share(ExprDag& dag) const {
+    return dag.reactive_assign(var_name, formula->share(dag));
+}
+
+
+const Expr* ReactiveAssignExpr::derive(Differentiator&) const {
+    throw std::invalid_argument("Cannot differentiate a reactive binding");
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string_view>
+
+#include "expr.h"
+
+// 响应式绑定 b := formula，只能出现在最外层。
+// 求值时把公式登记到 Evaluator 的依赖图（见 reactive_graph.h），之后 formula 读取的变量变化时 b 自动重新计算；
+// 结果为 b 的当前值，公式暂时无法求值时为 b 的符号值。会形成循环时返回 CYCLIC_BINDING，不做任何修改。
+// 不能编译为字节码
+class ReactiveAssignExpr final : public Expr {
+    std::string_view var_name;
+    const Expr* formula;
+    friend class ExprDag;
+public:
+    ReactiveAssignExpr(std::string_view name, const Expr* f);
+    EvalResult try_evaluate(Evaluator& eval) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
+
+    std::string_view get_name() const { return var_name; }
+    const Expr* get_formula() const { return formula; }
+};
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+#include "reactive_graph.h"
+#include "evaluator.h"
+#include "expr_dag.h"
+#include "user_function.h"
+
+namespace {
+
+// 收集 code 读取的变量槽与调用的函数名，调用的用户函数体一并收集（每个函数只看一次）
+void collect_reads(const CompiledExpr& code, const Evaluator& eval, std::vector<uint32_t>& reads,
+    std::vector<std::string>& calls, std::vector<const UserFunction*>& seen) {
+    for (const Instr& in : code.instructions()) {
+        if (in.op == OpCode::STORE) throw std::invalid_argument("Reactive formulas cannot contain assignments");
+        if (in.op == OpCode::LOAD_VAR) reads.push_back(in.arg);
+        if (in.op != OpCode::FUNC) continue;
+        calls.emplace_back(code.name(in.arg));
+        const Function* fn = eval.functions.find(code.name(in.arg));
+        if (!fn || !fn->user || std::find(seen.begin(), seen.end(), fn->user.get()) != seen.end()) continue;
+        seen.push_back(fn->user.get());
+        collect_reads(fn->user->bytecode(), eval, reads, calls, seen);
+    }
+}
+
+} // namespace
+
+ReactiveGraph::Formula::Formula(ParseResult e, Evaluator& eval) : expr(std::move(e)), code(expr.get(), eval) {
+    std::vector<const UserFunction*> seen;
+    collect_reads(code, eval, reads, calls, seen);
+    std::sort(reads.begin(), reads.end());
+    reads.erase(std::unique(reads.begin(), reads.end()), reads.end());
+    std::sort(calls.begin(), calls.end());
+    calls.erase(std::unique(calls.begin(), calls.end()), calls.end());
+}
+
+
+std::shared_ptr<const ReactiveGraph::Formula> ReactiveGraph::compile(Evaluator& eval, const Expr* formula) const {
+    // 复制公式：调用方的 AST 可能随缓存淘汰而释放
+    Arena arena;
+    ExprDag dag(arena);
+    const Expr* copy = formula->share(dag);
+    return std::make_shared<const Formula>(ParseResult(std::move(arena), copy), eval);
+}
+
+
+void ReactiveGraph::reserve(size_t slots) {
+    if (slots <= flags.size()) return;
+    formulas.resize(slots);
+    dependents.resize(slots);
+    flags.resize(slots, 0);
+    visited.resize(slots, 0);
+    dirty.resize(slots, 0);
+}
+
+
+uint32_t ReactiveGraph::next_epoch() {
+    if (++epoch == 0) {
+        std::fill(visited.begin(), visited.end(), 0);
+        epoch = 1;
+    }
+    return epoch;
+}
+
+
+// 从 from 沿公式的读取关系能否到达 target（from 本身等于 target 也算）
+bool ReactiveGraph::reaches(uint32_t from, uint32_t target) {
+    if (from == target) return true;
+    order.clear();
+    order.push_back(from);
+    visited[from] = epoch;
+    while (!order.empty()) {
+        uint32_t slot = order.back();
+        order.pop_back();
+        if (!formulas[slot]) continue;
+        for (uint32_t r : formulas[slot]->reads) {
+            if (r == target) return true;
+            if (visited[r] == epoch) continue;
+            visited[r] = epoch;
+            order.push_back(r);
+        }
+    }
+    return false;
+}
+
+
+// slot 的公式读取的变量（直接或经由其他公式）是否依赖 slot 本身
+bool ReactiveGraph::cyclic(uint32_t slot) {
+    next_epoch();
+    for (uint32_t r : formulas[slot]->reads) {
+        if (reaches(r, slot)) return true;
+    }
+    return false;
+}
+
+
+void ReactiveGraph::link(uint32_t slot) {
+    flags[slot] |= HAS_FORMULA;
+    for (uint32_t r : formulas[slot]->reads) {
+        dependents[r].push_back(slot);
+        flags[r] |= HAS_DEPENDENTS;
+    }
+}
+
+
+void ReactiveGraph::unlink(uint32_t slot) {
+    flags[slot] &= ~HAS_FORMULA;
+    for (uint32_t r : formulas[slot]->reads) {
+        auto& list = dependents[r];
+        list.erase(std::find(list.begin(), list.end(), slot));
+        if (list.empty()) flags[r] &= ~HAS_DEPENDENTS;
+    }
+}
+
+
+bool ReactiveGraph::define(Evaluator& eval, uint32_t slot, const Expr* formula) {
+    auto f = compile(eval, formula);
+
+    reserve(eval.slot_count());
+    // 公式读取的变量（直接或经由其他公式）依赖 slot 时会形成循环
+    next_epoch();
+    for (uint32_t r : f->reads) {
+        if (reaches(r, slot)) return false;
+    }
+
+    if (formulas[slot]) unlink(slot);
+    else ++bound;
+    formulas[slot] = std::move(f);
+    link(slot);
+    recompute(eval, slot);
+    propagate(eval, slot);
+    return true;
+}
+
+
+bool ReactiveGraph::redefined(Evaluator& eval, std::string_view name) {
+    // 先全部重新编译（函数体中有赋值时在这里抛出，图还没有修改）
+    std::vector<std::pair<uint32_t, std::shared_ptr<const Formula>>> changed;
+    for (uint32_t slot = 0; slot < formulas.size(); ++slot) {
+        const auto& f = formulas[slot];
+        if (f && std::binary_search(f->calls.begin(), f->calls.end(), name)) {
+            changed.emplace_back(slot, compile(eval, f->expr.get()));
+        }
+    }
+    if (changed.empty()) return true;
+
+    reserve(eval.slot_count());
+    auto swap_all = [&] {
+        for (auto& [slot, f] : changed) unlink(slot);
+        for (auto& [slot, f] : changed) {
+            std::swap(formulas[slot], f);
+            link(slot);
+        }
+    };
+    swap_all();
+    for (const auto& [slot, f] : changed) {
+        if (cyclic(slot)) {
+            swap_all();
+            return false;
+        }
+    }
+    for (const auto& [slot, f] : changed) {
+        recompute(eval, slot);
+        propagate(eval, slot);
+    }
+    return true;
+}
+
+
+void ReactiveGraph::remove(uint32_t slot) {
+    if (slot >= formulas.size() || !formulas[slot]) return;
+    unlink(slot);
+    formulas[slot].reset();
+    --bound;
+}
+
+
+void ReactiveGraph::assigned(Evaluator& eval, uint32_t slot) {
+    remove(slot);
+    propagate(eval, slot);
+}
+
+
+void ReactiveGraph::propagate(Evaluator& eval, uint32_t slot) {
+    if (slot >= dependents.size() || dependents[slot].empty()) return;
+
+    // 沿反向边做后序 DFS，order 为逆拓扑序（最后一个是 slot 本身）
+    uint32_t mark = next_epoch();
+    order.clear();
+    dfs.clear();
+    dfs.push_back({ slot, 0 });
+    visited[slot] = mark;
+    while (!dfs.empty()) {
+        size_t top = dfs.size() - 1;
+        uint32_t node = dfs[top].first;
+        if (dfs[top].second < dependents[node].size()) {
+            uint32_t next = dependents[node][dfs[top].second++];
+            if (visited[next] != mark) {
+                visited[next] = mark;
+                dfs.push_back({ next, 0 });
+            }
+            continue;
+        }
+        order.push_back(node);
+        dfs.pop_back();
+    }
+
+    // 按拓扑序计算；读取的变量都没有变化的公式跳过
+    dirty[slot] = 1;
+    for (size_t i = order.size() - 1; i-- > 0;) {
+        uint32_t node = order[i];
+        const auto& reads = formulas[node]->reads;
+        bool stale = std::any_of(reads.begin(), reads.end(), [&](uint32_t r) { return dirty[r] != 0; });
+        if (stale && recompute(eval, node)) dirty[node] = 1;
+    }
+    for (uint32_t node : order) dirty[node] = 0;
+}
+
+
+bool ReactiveGraph::recompute(Evaluator& eval, uint32_t slot) {
+    ++recomputed;
+    double v = 0.0;
+    bool ok = false;
+    try {
+        Value r = formulas[slot]->code.evaluate(eval);
+        ok = r.is_number();
+        if (ok) v = r.num;
+    }
+    catch (const std::runtime_error&) {
+        // 求值出错：变为未定义
+    }
+    // 直接写入，不经过 Evaluator::set（否则会解除绑定）
+    bool was = eval.defined[slot] != 0;
+    bool changed = ok != was || (ok && std::bit_cast<uint64_t>(v) != std::bit_cast<uint64_t>(eval.values[slot]));
+    eval.values[slot] = v;
+    eval.defined[slot] = ok ? 1 : 0;
+    return changed;
+}
+
+
+const Expr* ReactiveGraph::formula(uint32_t slot) const {
+    return slot < formulas.size() && formulas[slot] ? formulas[slot]->expr.get() : nullptr;
+}
+
+
+std::span<const uint32_t> ReactiveGraph::reads(uint32_t slot) const {
+    if (slot >= formulas.size() || !formulas[slot]) return {};
+    return formulas[slot]->reads;
+}
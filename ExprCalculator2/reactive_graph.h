@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compiled_expr.h"
+#include "parse_result.h"
+
+class Evaluator;
+
+// 响应式绑定（b := a * 2）的依赖图：每个绑定的变量槽保存一份编译好的公式与它读取的变量槽，
+// 反向边记录每个变量被哪些公式读取。
+// 变量被赋值（Evaluator::set）后，只按拓扑序重新计算从它可达的公式；
+// 某个公式重新计算后值没有变化时，只依赖它的公式不再计算。
+// 公式求值出错或读取了未定义的变量时，绑定的变量变为未定义，输入变化后再重新计算。
+// 对绑定的变量直接赋值会解除绑定（与电子表格中用数值覆盖公式相同）。
+// 公式读取的变量包括其中调用的用户函数体读取的全局变量；重新定义被调用的函数后重新收集并计算，公式与这些函数体中不能有赋值。
+// 复制 Evaluator 时公式共享（只读），依赖关系各自独立
+class ReactiveGraph {
+    struct Formula {
+        ParseResult expr;
+        CompiledExpr code;
+        std::vector<uint32_t> reads; // 去重后的变量槽
+        std::vector<std::string> calls; // 直接或经由用户函数体调用的函数名，去重（包括尚未定义的）
+
+        Formula(ParseResult e, Evaluator& eval);
+    };
+
+    enum : uint8_t {
+        HAS_FORMULA = 1 << 0,
+        HAS_DEPENDENTS = 1 << 1,
+    };
+
+    std::vector<std::shared_ptr<const Formula>> formulas; // 按变量槽，普通变量为空
+    std::vector<std::vector<uint32_t>> dependents;        // 按变量槽：读取它的公式所在的槽
+    std::vector<uint8_t> flags;                           // 按变量槽
+    size_t bound = 0;
+    uint64_t recomputed = 0;
+
+    // 遍历用的临时数据：visited 按 epoch 标记，不必每次清空
+    std::vector<uint32_t> visited;
+    uint32_t epoch = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> dfs; // (槽, 下一个要访问的后继)
+    std::vector<uint32_t> order;
+    std::vector<uint8_t> dirty;
+
+    std::shared_ptr<const Formula> compile(Evaluator& eval, const Expr* formula) const;
+    void reserve(size_t slots);
+    uint32_t next_epoch();
+    bool reaches(uint32_t from, uint32_t target);
+    bool cyclic(uint32_t slot);
+    void link(uint32_t slot);
+    void unlink(uint32_t slot);
+    // 重新计算 slot 的公式，返回值（或是否定义）是否改变
+    bool recompute(Evaluator& eval, uint32_t slot);
+public:
+    // 绑定 slot := formula 并计算一次（公式会被复制）；会形成循环时不做任何修改并返回 false。
+    // 公式中有赋值、定义或无法编译时抛出 std::invalid_argument
+    bool define(Evaluator& eval, uint32_t slot, const Expr* formula);
+    // 解除绑定，变量保留当前值
+    void remove(uint32_t slot);
+    // 函数 name 被定义或替换后调用：重新编译调用它的公式、收集读取的变量并重新计算。
+    // 会形成循环时恢复原来的公式并返回 false（函数表由调用方恢复）；函数体中有赋值时同样恢复并抛出 std::invalid_argument
+    bool redefined(Evaluator& eval, std::string_view name);
+
+    // Evaluator::set 在赋值后调用：slot 需要处理（有公式或被公式读取）
+    bool watched(uint32_t slot) const { return slot < flags.size() && flags[slot] != 0; }
+    // slot 被直接赋值：解除它的绑定，并更新依赖它的公式
+    void assigned(Evaluator& eval, uint32_t slot);
+    // 按拓扑序重新计算从 slot 可达的公式
+    void propagate(Evaluator& eval, uint32_t slot);
+
+    // 绑定的公式（未绑定时为 nullptr）
+    const Expr* formula(uint32_t slot) const;
+    std::span<const uint32_t> reads(uint32_t slot) const;
+    size_t size() const { return bound; }
+    // 累计重新计算的公式数
+    uint64_t recomputations() const { return recomputed; }
+};
@@ -0,0 +1,400 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+#include "script_runner.h"
+#include "line_reader.h"
+#include "printer.h"
+#include "user_function.h"
+
+namespace {
+
+// 调用 name 是否可能改变状态：非纯函数，或（按当前函数表）经由函数体调用的用户函数间接调用了非纯函数。
+// 未定义的函数求值时报错，不改变状态
+bool call_has_effects(const FunctionRegistry& functions, std::string_view name, std::vector<const Function*>& seen) {
+    const Function* fn = functions.find(name);
+    if (!fn || std::find(seen.begin(), seen.end(), fn) != seen.end()) return false;
+    seen.push_back(fn);
+    if (!fn->pure()) return true;
+    if (!fn->user) return false;
+    for (const std::string& callee : fn->user->callees()) {
+        if (call_has_effects(functions, callee, seen)) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+OutputFormat parse_output_format(std::string_view name) {
+    if (name == "plain") return OutputFormat::PLAIN;
+    if (name == "csv") return OutputFormat::CSV;
+    if (name == "jsonl") return OutputFormat::JSONL;
+    throw std::invalid_argument("Unknown output format: " + std::string(name) + " (expected plain, csv or jsonl)");
+}
+
+
+ScriptRunner::ScriptRunner(Evaluator& e, std::FILE* output, OutputFormat f, unsigned threads)
+    : eval(e), sink(output), format(f) {
+    out.reserve(FLUSH_AT + 4096);
+    if (format == OutputFormat::CSV) out += "line,status,value,detail\n";
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads > 1) {
+        pool = std::make_unique<ThreadPool>(threads);
+        workers.resize(pool->size());
+        counters.threads = pool->size();
+    }
+}
+
+
+ScriptRunner::~ScriptRunner() {
+    try {
+        flush();
+    }
+    catch (const std::runtime_error&) {
+        // 析构时无法报告写出失败
+    }
+}
+
+
+ScriptRunner::Stats ScriptRunner::run(LineReader& in) {
+    auto start = std::chrono::steady_clock::now();
+    std::string_view t;
+    if (!pool) {
+        while (in.next(t)) {
+            ++counters.lines;
+            if (!line(counters.lines, t)) break;
+        }
+    }
+    else {
+        // 读入一块（复制文本：LineReader 返回的行在下一次读取后失效），处理完再读下一块
+        do {
+            block.clear();
+            text.clear();
+            while (block.size() < BLOCK_LINES && text.size() < BLOCK_BYTES && in.next(t)) {
+                block.push_back({ ++counters.lines, text.size(), t.size() });
+                text += t;
+            }
+        } while (!block.empty() && run_block());
+    }
+    flush();
+    std::fflush(sink);
+    counters.bytes = in.bytes();
+    counters.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return counters;
+}
+
+
+bool ScriptRunner::line(uint64_t number, std::string_view source) {
+    if (source.empty()) return true;
+    if (source == "exit") return false;
+    Status s;
+    try {
+        auto simplified = cache.get(source, &eval.functions);
+        s = evaluate(out, scratch, eval, number, *simplified);
+    }
+    catch (const std::exception& e) {
+        write_error(out, number, e.what());
+        s = ERROR;
+    }
+    account(s);
+    if (out.size() >= FLUSH_AT) flush();
+    return true;
+}
+
+
+void ScriptRunner::flush() {
+    if (out.empty()) return;
+    size_t written = std::fwrite(out.data(), 1, out.size(), sink);
+    bool failed = written != out.size();
+    out.clear();
+    if (failed) throw std::runtime_error("Failed to write output");
+}
+
+
+void ScriptRunner::account(Status s) {
+    if (s != SKIPPED) ++counters.expressions;
+    if (s == ERROR) ++counters.errors;
+}
+
+
+// 按顺序处理一块：独立行组成的段并行求值，屏障在调用线程上执行。遇到 exit 时返回 false
+bool ScriptRunner::run_block() {
+    parse_block();
+    const size_t n = block.size();
+    for (size_t pos = 0; pos < n;) {
+        size_t end = pos;
+        while (end < n && !is_barrier(source(block[end]))) ++end;
+
+        if (end - pos >= MIN_PARALLEL) {
+            evaluate_parallel(pos, end);
+            for (size_t i = pos; i < end; ++i) {
+                const Pending& p = block[i];
+                out.append(workers[p.worker].out, p.out_begin, p.out_end - p.out_begin);
+                account(p.status);
+            }
+        }
+        else {
+            for (size_t i = pos; i < end; ++i) account(process(out, scratch, eval, i));
+        }
+
+        if (end < n) {
+            if (source(block[end]) == "exit") {
+                counters.lines = block[end].number;
+                return false;
+            }
+            ++counters.barriers;
+            account(process(out, scratch, eval, end));
+            workers_stale = true;
+        }
+        if (out.size() >= FLUSH_AT) flush();
+        pos = end + 1;
+    }
+    return true;
+}
+
+
+// 在线程池上解析、化简整块（结果放入缓存并留在 entries 中）；出错的行求值时重新解析并报告
+void ScriptRunner::parse_block() {
+    entries.assign(block.size(), nullptr);
+    parsed_version = eval.functions.version();
+    std::atomic<size_t> next{ 0 };
+    pool->run([&](unsigned) {
+        for (size_t first; (first = next.fetch_add(GRAIN)) < block.size();) {
+            size_t last = std::min(first + GRAIN, block.size());
+            for (size_t i = first; i < last; ++i) {
+                std::string_view s = source(block[i]);
+                if (s.empty() || s == "exit") continue;
+                try {
+                    entries[i] = cache.get(s, &eval.functions);
+                }
+                catch (const std::exception&) {
+                    // 求值时重新解析并报告错误
+                }
+            }
+        }
+    });
+}
+
+
+// 段中没有屏障，eval 在此期间不变：各线程先按需复制 eval，再领取行求值，输出写入自己的缓冲区
+void ScriptRunner::evaluate_parallel(size_t begin, size_t end) {
+    std::atomic<size_t> next{ begin };
+    pool->run([&](unsigned w) {
+        Worker& worker = workers[w];
+        if (workers_stale) worker.frame = eval;
+        worker.out.clear();
+        for (size_t first; (first = next.fetch_add(GRAIN)) < end;) {
+            size_t last = std::min(first + GRAIN, end);
+            for (size_t i = first; i < last; ++i) {
+                Pending& p = block[i];
+                p.worker = w;
+                p.out_begin = worker.out.size();
+                p.status = process(worker.out, worker.scratch, worker.frame, i);
+                p.out_end = worker.out.size();
+            }
+        }
+    });
+    workers_stale = false;
+}
+
+
+ScriptRunner::Status ScriptRunner::process(std::string& buf, std::string& tmp, Evaluator& ev, size_t index) {
+    const Pending& p = block[index];
+    std::string_view s = source(p);
+    if (s.empty()) return SKIPPED;
+    try {
+        // 块中之前的行定义了用户函数时，按新的函数表重新取化简结果
+        ExprCache::Entry& entry = entries[index];
+        if (!entry || parsed_version != eval.functions.version()) entry = cache.get(s, &eval.functions);
+        return evaluate(buf, tmp, ev, p.number, *entry);
+    }
+    catch (const std::exception& e) {
+        write_error(buf, p.number, e.what());
+        return ERROR;
+    }
+}
+
+
+// 可能改变 Evaluator 状态的行：含赋值、函数定义或响应式绑定（不属于 ==、!=、<=、>= 的 =），
+// 或调用了可能有副作用的函数；exit 也按屏障处理
+bool ScriptRunner::is_barrier(std::string_view s) const {
+    if (s == "exit") return true;
+    auto at = [&](size_t i) { return static_cast<unsigned char>(s[i]); };
+    std::vector<const Function*> seen;
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '=') {
+            if (i + 1 < s.size() && s[i + 1] == '=') {
+                ++i;
+                continue;
+            }
+            if (i == 0 || (s[i - 1] != '!' && s[i - 1] != '<' && s[i - 1] != '>')) return true;
+            continue;
+        }
+        if (std::isdigit(at(i)) || c == '.') {
+            // 数字（含 1e5 这样的指数部分）不是函数名
+            while (i + 1 < s.size() && (std::isalnum(at(i + 1)) || s[i + 1] == '.')) ++i;
+            continue;
+        }
+        if (!std::isalpha(at(i)) && c != '_') continue;
+        size_t start = i;
+        while (i + 1 < s.size() && (std::isalnum(at(i + 1)) || s[i + 1] == '_')) ++i;
+        size_t j = i + 1;
+        while (j < s.size() && std::isspace(at(j))) ++j;
+        if (j < s.size() && s[j] == '(') {
+            seen.clear();
+            if (call_has_effects(eval.functions, s.substr(start, i + 1 - start), seen)) return true;
+        }
+    }
+    return false;
+}
+
+
+ScriptRunner::Status ScriptRunner::evaluate(std::string& buf, std::string& tmp, Evaluator& ev, uint64_t number,
+    const ParseResult& expr) const {
+    EvalResult result = ev.try_evaluate(expr.get());
+    if (result && result->is_number()) {
+        write_value(buf, number, result->num);
+        return OK;
+    }
+    if (result || result.error().code == EvalErrc::UNDEFINED_VARIABLE) {
+        write_symbolic(buf, tmp, number, expr.get());
+        return SYMBOLIC;
+    }
+    write_error(buf, number, result.error().message());
+    return ERROR;
+}
+
+
+void ScriptRunner::begin(std::string& buf, uint64_t number, std::string_view status) const {
+    if (format == OutputFormat::PLAIN) return;
+    char digits[24];
+    auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), number);
+    if (format == OutputFormat::CSV) {
+        buf.append(digits, end);
+        buf += ',';
+        buf += status;
+        buf += ',';
+    }
+    else {
+        buf += "{\"line\":";
+        buf.append(digits, end);
+        buf += ",\"status\":\"";
+        buf += status;
+        buf += "\",";
+    }
+}
+
+
+void ScriptRunner::write_value(std::string& buf, uint64_t number, double v) const {
+    begin(buf, number, "ok");
+    if (format == OutputFormat::JSONL) {
+        buf += "\"value\":";
+        // JSON 没有 inf、nan，写为字符串
+        bool finite = std::isfinite(v);
+        if (!finite) buf += '"';
+        Printer(buf).number(v);
+        if (!finite) buf += '"';
+        buf += "}\n";
+        return;
+    }
+    Printer(buf).number(v);
+    if (format == OutputFormat::CSV) buf += ',';
+    buf += '\n';
+}
+
+
+void ScriptRunner::write_symbolic(std::string& buf, std::string& tmp, uint64_t number, const Expr* simplified) const {
+    begin(buf, number, "symbolic");
+    if (format == OutputFormat::PLAIN) {
+        Printer(buf).print(simplified);
+        buf += '\n';
+        return;
+    }
+    tmp.clear();
+    Printer(tmp).print(simplified);
+    if (format == OutputFormat::CSV) {
+        buf += ',';
+        quoted(buf, tmp);
+        buf += '\n';
+    }
+    else {
+        buf += "\"expr\":";
+        quoted(buf, tmp);
+        buf += "}\n";
+    }
+}
+
+
+void ScriptRunner::write_error(std::string& buf, uint64_t number, std::string_view message) const {
+    begin(buf, number, "error");
+    if (format == OutputFormat::PLAIN) {
+        buf += "Error: ";
+        buf += message;
+        buf += '\n';
+        return;
+    }
+    if (format == OutputFormat::CSV) {
+        buf += ',';
+        quoted(buf, message);
+        buf += '\n';
+    }
+    else {
+        buf += "\"error\":";
+        quoted(buf, message);
+        buf += "}\n";
+    }
+}
+
+
+// CSV：含逗号、引号或换行时加引号并把引号写两遍；JSON：总是加引号并转义
+void ScriptRunner::quoted(std::string& buf, std::string_view s) const {
+    if (format == OutputFormat::CSV) {
+        if (s.find_first_of(",\"\r\n") == std::string_view::npos) {
+            buf += s;
+            return;
+        }
+        buf += '"';
+        for (char c : s) {
+            if (c == '"') buf += '"';
+            buf += c;
+        }
+        buf += '"';
+        return;
+    }
+    static constexpr char HEX[] = "0123456789abcdef";
+    buf += '"';
+    for (char c : s) {
+        auto u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            buf += '\\';
+            buf += c;
+        }
+        else if (u < 0x20) {
+            buf += "\\u00";
+            buf += HEX[u >> 4];
+            buf += HEX[u & 0xF];
+        }
+        else {
+            buf += c;
+        }
+    }
+    buf += '"';
+}
+
+
+std::string ScriptRunner::summary(const Stats& s) {
+    double seconds = s.seconds > 0.0 ? s.seconds : 1e-9;
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+        "%llu lines, %llu expressions, %llu errors, %.2f MB in %.3f s (%.0f lines/s, %.1f MB/s, %u threads)",
+        static_cast<unsigned long long>(s.lines), static_cast<unsigned long long>(s.expressions),
+        static_cast<unsigned long long>(s.errors), s.bytes / 1e6, s.seconds, s.lines / seconds,
+        s.bytes / 1e6 / seconds, s.threads);
+    return buf;
+}
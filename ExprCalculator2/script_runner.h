@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "evaluator.h"
+#include "expr_cache.h"
+#include "thread_pool.h"
+
+class LineReader;
+
+// 批处理的输出格式：
+//   PLAIN  每行一个结果：数值、化简后的表达式（含未定义变量时）或 "Error: 信息"
+//   CSV    line,status,value,detail（带表头；detail 为化简后的表达式或错误信息，按需加引号）
+//   JSONL  每行一个对象 {"line":1,"status":"ok","value":3}，非有限值写为字符串 "inf"、"nan"
+enum class OutputFormat : uint8_t {
+    PLAIN,
+    CSV,
+    JSONL,
+};
+
+// "plain"、"csv"、"jsonl"；未知名字抛出 std::invalid_argument
+OutputFormat parse_output_format(std::string_view name);
+
+// 非交互的批处理：逐行解析、化简（经 ExprCache，重复的行不再解析）、求值，
+// 结果追加到输出缓冲区，攒够 FLUSH_AT 字节才写出一次，不逐行刷新。
+// 每个非空输入行输出一行，状态为 ok、symbolic（含未定义变量，输出化简结果）或 error；
+// 变量与函数定义在后续行中可见，遇到 "exit" 行时停止。写出失败时抛出 std::runtime_error。
+//
+// 多线程时按块（至多 BLOCK_LINES 行）处理：先在线程池上解析、化简整块，再按顺序把块切成段。
+// 可能改变状态的行（含 =、:= 或调用有副作用的用户函数，按文本保守判断）是屏障，在调用线程上按顺序执行；
+// 两个屏障之间的独立行由各线程在自己的 Evaluator 副本上求值（屏障执行后重新复制），
+// 输出先写入各线程的缓冲区，再按行号顺序拼接，因此结果与单线程逐行执行完全相同，缓冲区大小以块为上限
+class ScriptRunner {
+public:
+    struct Stats {
+        uint64_t lines = 0;       // 读取的输入行
+        uint64_t expressions = 0; // 处理的非空行
+        uint64_t errors = 0;
+        uint64_t barriers = 0;    // 多线程时按顺序执行的行
+        uint64_t bytes = 0;       // 读取的输入字节数
+        double seconds = 0.0;
+        unsigned threads = 1;
+    };
+
+    // threads 为 0 时使用全部硬件线程，为 1 时逐行处理
+    ScriptRunner(Evaluator& eval, std::FILE* out, OutputFormat format, unsigned threads = 1);
+    ~ScriptRunner();
+    ScriptRunner(const ScriptRunner&) = delete;
+    ScriptRunner& operator=(const ScriptRunner&) = delete;
+
+    // 处理 in 的全部行，返回后输出已全部写出
+    Stats run(LineReader& in);
+    // 处理第 number 行（不含换行符）；遇到 exit 时返回 false
+    bool line(uint64_t number, std::string_view source);
+    void flush();
+
+    const Stats& stats() const { return counters; }
+    // 一行吞吐量摘要：行数、错误数、字节数、耗时、行/秒、MB/秒
+    static std::string summary(const Stats& s);
+private:
+    static constexpr size_t FLUSH_AT = 1u << 20;
+    static constexpr size_t BLOCK_LINES = 8192;
+    static constexpr size_t BLOCK_BYTES = 4u << 20;
+    static constexpr size_t MIN_PARALLEL = 256; // 更短的独立段直接在调用线程上求值
+    static constexpr size_t GRAIN = 64;         // 工作线程每次领取的行数
+
+    enum Status : uint8_t {
+        SKIPPED, // 空行
+        OK,
+        SYMBOLIC,
+        ERROR,
+    };
+
+    // 工作线程求值用的 Evaluator 副本与输出缓冲区
+    struct Worker {
+        Evaluator frame;
+        std::string out;
+        std::string scratch;
+    };
+
+    // 块中的一行
+    struct Pending {
+        uint64_t number;
+        size_t offset; // 在 text 中的位置
+        size_t length;
+        size_t out_begin = 0; // 并行求值时在 workers[worker].out 中的输出
+        size_t out_end = 0;
+        unsigned worker = 0;
+        Status status = SKIPPED;
+    };
+
+    Evaluator& eval;
+    ExprCache cache;
+    std::FILE* sink;
+    OutputFormat format;
+    std::string out;
+    std::string scratch; // 需要转义的化简结果先写到这里
+    Stats counters;
+
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<Worker> workers;
+    bool workers_stale = true; // 屏障执行后副本需要重新复制
+    std::string text;
+    std::vector<Pending> block;
+    std::vector<ExprCache::Entry> entries; // 按块中的行，解析失败时为空
+    uint64_t parsed_version = 0;           // 解析整块时函数表的版本
+
+    std::string_view source(const Pending& p) const { return std::string_view(text).substr(p.offset, p.length); }
+    bool is_barrier(std::string_view s) const;
+    bool run_block();
+    void parse_block();
+    void evaluate_parallel(size_t begin, size_t end);
+    Status process(std::string& buf, std::string& tmp, Evaluator& ev, size_t index);
+    void account(Status s);
+
+    Status evaluate(std::string& buf, std::string& tmp, Evaluator& ev, uint64_t number, const ParseResult& expr) const;
+    void write_value(std::string& buf, uint64_t number, double v) const;
+    void write_symbolic(std::string& buf, std::string& tmp, uint64_t number, const Expr* simplified) const;
+    void write_error(std::string& buf, uint64_t number, std::string_view message) const;
+    void begin(std::string& buf, uint64_t number, std::string_view status) const;
+    void quoted(std::string& buf, std::string_view s) const;
+};
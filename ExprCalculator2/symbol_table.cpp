@@ -0,0 +1,36 @@
+#include <mutex>
+#include <stdexcept>
+
+#include "symbol_table.h"
+
+SymbolTable& SymbolTable::instance() {
+    static SymbolTable table;
+    return table;
+}
+
+uint32_t SymbolTable::intern(std::string_view name) {
+    {
+        std::shared_lock lock(m);
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+    }
+    std::unique_lock lock(m);
+    auto it = ids.find(name); // 加写锁期间可能已被其他线程加入
+    if (it != ids.end()) return it->second;
+    auto id = static_cast<uint32_t>(names.size());
+    std::string_view stored = names_arena.copy(name);
+    names.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+}
+
+std::string_view SymbolTable::name(uint32_t id) const {
+    std::shared_lock lock(m);
+    if (id >= names.size()) throw std::out_of_range("Unknown symbol id");
+    return names[id];
+}
+
+size_t SymbolTable::size() const {
+    std::shared_lock lock(m);
+    return names.size();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+
+// 进程内共享的符号表：名字 → 32 位 id，Value 中的符号值只保存 id。
+// 可在多个线程间并发使用；id 与名字在进程生命周期内保持有效，名字不会被释放。
+class SymbolTable {
+    mutable std::shared_mutex m;
+    Arena names_arena;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::vector<std::string_view> names;
+
+    SymbolTable() = default;
+public:
+    static SymbolTable& instance();
+
+    // 返回名字的 id，第一次出现时分配
+    uint32_t intern(std::string_view name);
+    std::string_view name(uint32_t id) const;
+    size_t size() const;
+};
@@ -0,0 +1,67 @@
+#include <utility>
+
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned workers) {
+    if (workers == 0) workers = std::thread::hardware_concurrency();
+    if (workers == 0) workers = 1;
+    threads.reserve(workers - 1);
+    for (unsigned i = 1; i < workers; ++i) threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+void ThreadPool::execute(unsigned index) {
+    try {
+        (*job)(index);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(m);
+        if (!error) error = std::current_exception();
+    }
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        execute(index);
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if (--pending == 0) done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::run(const std::function<void(unsigned worker)>& task) {
+    std::lock_guard<std::mutex> serial(run_mutex);
+    {
+        std::lock_guard<std::mutex> lock(m);
+        job = &task;
+        error = nullptr;
+        pending = static_cast<unsigned>(threads.size());
+        ++generation;
+    }
+    wake.notify_all();
+    execute(0);
+
+    std::exception_ptr failure;
+    {
+        std::unique_lock<std::mutex> lock(m);
+        done.wait(lock, [&] { return pending == 0; });
+        job = nullptr;
+        failure = std::exchange(error, nullptr);
+    }
+    if (failure) std::rethrow_exception(failure);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 固定数量的工作线程。run() 把同一个任务交给所有线程（调用线程作为 0 号）并等待全部完成，
+// 任务抛出的第一个异常在 run() 中重新抛出。线程在多次 run() 之间复用；run() 不可并发调用。
+class ThreadPool {
+    std::vector<std::thread> threads;
+    std::mutex run_mutex;
+    std::mutex m;
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(unsigned)>* job = nullptr;
+    uint64_t generation = 0;
+    unsigned pending = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    void workerLoop(unsigned index);
+    void execute(unsigned index);
+public:
+    // workers 为 0 时使用 std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned workers = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(threads.size()) + 1; }
+    void run(const std::function<void(unsigned worker)>& task);
+};
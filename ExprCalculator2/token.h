@@ -1,11 +1,13 @@
 #pragma once
 
-#include <string>
+#include <string_view>
 
 #include "token_type.h"
 
+// lexeme 指向 Lexer 借用的源缓冲区，源字符串必须比 Token 活得更久
 struct Token {
     TokenType type = TokenType::ERROR;
-    std::string lexeme;
+    std::string_view lexeme;
     double number_value = 0.0;
-};
\ No newline at end of file
+    const char* error = nullptr; // ERROR 时的错误说明（静态字符串）
+};
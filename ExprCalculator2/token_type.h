@@ -2,7 +2,7 @@
 
 enum class TokenType {
     NUMBER, IDENTIFIER, PLUS, MINUS, STAR, SLASH, MOD, POW,
-    LPAREN, RPAREN, ASSIGN,
+    LPAREN, RPAREN, ASSIGN, REACTIVE_ASSIGN,
     GT, LT, GE, LE, EQ, NE,
     LOG_AND, LOG_OR, LOG_NOT,
     QUESTION, COLON,
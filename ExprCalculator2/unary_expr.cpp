@@ -1,65 +1,88 @@
 #include "evaluator.h" // 节点递归运算需要
 #include "unary_expr.h"
 #include "number_expr.h"
+#include "operators.h"
+#include "compiled_expr.h"
+#include "printer.h"
+#include "expr_dag.h"
+#include "differentiator.h"
+#include "polynomial.h"
 
 // 一元运算
-UnaryExpr::UnaryExpr(TokenType o, std::unique_ptr<Expr> expr) : op(o), operand(std::move(expr)) {}
+UnaryExpr::UnaryExpr(TokenType o, const Expr* expr) : operand(expr), op(o) {}
 
-std::string UnaryExpr::to_string() const {
-    std::string op_str = (op == TokenType::MINUS) ? "-" : "!";
-    return op_str + operand->to_string();
+void UnaryExpr::print(Printer& p) const {
+    // 一元运算符只作用于紧跟的基本表达式：-x ^ 2 解析为 (-x) ^ 2
+    p.text(operators::symbol(op));
+    p.operand(operand, operators::PRIMARY);
 }
 
 
-Value UnaryExpr::evaluate(Evaluator& eval) const {
-    Value v = operand->evaluate(eval);
-    if (v.is_symbol()) {
-        throw std::runtime_error("Cannot evaluate expression with undefined variables");
-    }
-    switch (op) {
-    case TokenType::MINUS: return Value(-v.num);
-    case TokenType::LOG_NOT: return Value(std::abs(v.num) < 1e-9 ? 1.0 : 0.0);
-    default: throw std::runtime_error("Unhandled unary operator");
+EvalResult UnaryExpr::try_evaluate(Evaluator& eval) const {
+    EvalResult v = operand->try_evaluate(eval);
+    if (!v) return v;
+    if (v->is_symbol()) {
+        return EvalError{ EvalErrc::UNDEFINED_VARIABLE, this };
     }
+    if (op != TokenType::MINUS && op != TokenType::LOG_NOT) return EvalError{ EvalErrc::UNHANDLED_OPERATOR, this };
+    return Value(operators::unary(op, v->num));
 }
 
 
-std::unique_ptr<Expr> UnaryExpr::simplify() const {
-    auto simplified_operand = operand->simplify();
+const Expr* UnaryExpr::simplify(ExprDag& dag) const {
+    // 取负交给多项式规范化（-(x - y) → y - x）
+    if (op == TokenType::MINUS) return Polynomial::simplify(this, dag);
+
+    auto simplified_operand = dag.simplify(operand);
     auto is_constant = [](const Expr* expr) {
         return dynamic_cast<const NumberExpr*>(expr) != nullptr;
         };
 
     // 常数折叠（纯常数表达式直接计算）
-    if (is_constant(simplified_operand.get())) {
-        double r = dynamic_cast<const NumberExpr*>(simplified_operand.get())->val;
+    if (is_constant(simplified_operand)) {
+        double r = dynamic_cast<const NumberExpr*>(simplified_operand)->val;
         double result = 0.0;
 
         switch (op) {
-        case TokenType::MINUS: result = -r; break;
         case TokenType::LOG_NOT: result = r ? 1.0 : 0.0; break;
         default:
             // 其他运算符（如ASSIGN）不折叠
             goto end_constant_folding;
         }
-        return std::make_unique<NumberExpr>(result);
+        return dag.number(result);
     }
 end_constant_folding:
 
-    if (op == TokenType::MINUS) {
-        if (auto unary = dynamic_cast<const UnaryExpr*>(simplified_operand.get())) {
-            if (unary->op == TokenType::MINUS) {
-                return unary->operand->simplify();
-            }
-        }
-    }
-    else if (op == TokenType::LOG_NOT) {
-        if (auto unary = dynamic_cast<const UnaryExpr*>(simplified_operand.get())) {
+    if (op == TokenType::LOG_NOT) {
+        // 操作数已经化简过，直接取出
+        if (auto unary = dynamic_cast<const UnaryExpr*>(simplified_operand)) {
             if (unary->op == TokenType::LOG_NOT) {
-                return unary->operand->simplify();
+                return unary->operand;
             }
         }
     }
 
-    return std::make_unique<UnaryExpr>(op, std::move(simplified_operand));
-}
\ No newline at end of file
+    return dag.unary(op, simplified_operand, simplified_operand == operand ? this : nullptr);
+}
+
+
+void UnaryExpr::compile(Compiler& c) const {
+    c.operand(operand);
+    switch (op) {
+    case TokenType::MINUS: c.emit(OpCode::NEG); break;
+    case TokenType::LOG_NOT: c.emit(OpCode::NOT); break;
+    default: throw std::runtime_error("Unhandled unary operator");
+    }
+}
+
+
+const Expr* UnaryExpr::share(ExprDag& dag) const {
+    return dag.unary(op, operand->share(dag));
+}
+
+
+const Expr* UnaryExpr::derive(Differentiator& d) const {
+    if (op == TokenType::MINUS) return d.neg(d.derive(operand));
+    // 逻辑非：分段常数
+    return d.number(0.0);
+}
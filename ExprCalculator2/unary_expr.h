@@ -4,12 +4,20 @@
 #include "token_type.h"
 
 // 一元运算
-class UnaryExpr : public Expr {
-    std::unique_ptr<Expr> operand;
+class UnaryExpr final : public Expr {
+    const Expr* operand;
     TokenType op;
+    friend class ExprDag;
 public:
-    UnaryExpr(TokenType o, std::unique_ptr<Expr> expr);
-    Value evaluate(Evaluator& eval) const override;
-    std::unique_ptr<Expr> simplify() const override;
-    std::string to_string() const override;
+    UnaryExpr(TokenType o, const Expr* expr);
+    EvalResult try_evaluate(Evaluator& eval) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
+
+    // 辅助方法：获取操作数和运算符
+    const Expr* get_operand() const { return operand; }
+    TokenType get_op() const { return op; }
 };
\ No newline at end of file
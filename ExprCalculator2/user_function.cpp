@@ -0,0 +1,31 @@
+#include <algorithm>
+
+#include "evaluator.h"
+#include "user_function.h"
+#include "expr_dag.h"
+
+UserFunction::UserFunction(std::string_view name, std::span<const std::string_view> params, const Expr* body,
+    Evaluator& eval)
+    : fn_name(name), param_names(params.begin(), params.end()), param_views(param_names.begin(), param_names.end()),
+      body_tree(bind(body, eval)), program(body_tree.get(), eval) {}
+
+ParseResult UserFunction::bind(const Expr* body, Evaluator& eval) {
+    Arena arena;
+    ExprDag dag(arena, false, &eval.functions);
+    const Expr* root = dag.bind_params(body, param_views, fn_name);
+    node_count = dag.unique_nodes();
+    no_effects = !dag.has_effects(root);
+    all_params_used = dag.params_used() == param_views.size();
+    for (std::string_view callee : dag.called_functions()) callee_names.emplace_back(callee);
+    return ParseResult(std::move(arena), root);
+}
+
+CallFrame::CallFrame(Evaluator& e, const double* args) : eval(e), saved(e.param_values) {
+    eval.param_values = args;
+    ++eval.call_depth;
+}
+
+CallFrame::~CallFrame() {
+    eval.param_values = saved;
+    --eval.call_depth;
+}
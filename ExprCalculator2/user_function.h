@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compiled_expr.h"
+#include "parse_result.h"
+
+class Evaluator;
+
+// 用户定义的函数 f(x, y) = body。
+// 函数体复制进自己的 Arena，参数绑定为 ParamExpr；同时编译为字节码，所有调用处共享这一份。
+// 调用按名字在求值时查找（与变量相同），因此重新定义后已有的调用使用新定义；函数体内可以递归调用，
+// 嵌套深度超过 Evaluator::MAX_CALL_DEPTH 时报错。
+// 化简时（ExprDag 带函数表）小的函数体直接内联到调用处，参数替换为实参后与周围一起化简，
+// 递归的函数、有副作用的实参与没有用到全部参数的函数体不内联（见 ExprDag::inline_call）。
+class UserFunction {
+    std::string fn_name;
+    std::vector<std::string> param_names;
+    std::vector<std::string_view> param_views;
+    std::vector<std::string> callee_names;
+    // 以下三项由 bind 在构造 body_tree 时填写，需声明在它之前
+    size_t node_count = 0;
+    bool no_effects = true;
+    bool all_params_used = true;
+    ParseResult body_tree;
+    CompiledExpr program;
+
+    ParseResult bind(const Expr* body, Evaluator& eval);
+public:
+    // 函数体中与参数同名的变量绑定为参数，其余变量在调用时按全局变量查找；函数体在 eval 上编译
+    UserFunction(std::string_view name, std::span<const std::string_view> params, const Expr* body, Evaluator& eval);
+
+    std::string_view name() const { return fn_name; }
+    std::span<const std::string_view> params() const { return param_views; }
+    const Expr* body() const { return body_tree.get(); }
+    const CompiledExpr& bytecode() const { return program; }
+
+    // 函数体（共享后）的节点数，决定是否内联
+    size_t size() const { return node_count; }
+    // 函数体中没有赋值，也不调用非纯函数（按定义时的函数表判断）
+    bool pure() const { return no_effects; }
+    bool uses_all_params() const { return all_params_used; }
+    // 函数体中调用的函数名（判断递归用）
+    std::span<const std::string> callees() const { return callee_names; }
+};
+
+// 在作用域内把 eval 的参数帧设为 args（嵌套深度加一），退出时恢复
+class CallFrame {
+    Evaluator& eval;
+    const double* saved;
+public:
+    CallFrame(Evaluator& e, const double* args);
+    ~CallFrame();
+    CallFrame(const CallFrame&) = delete;
+    CallFrame& operator=(const CallFrame&) = delete;
+};
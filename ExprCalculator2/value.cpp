@@ -1,13 +1,25 @@
 #include <stdexcept>
 
 #include "value.h"
+#include "symbol_table.h"
 
-Value::Value(double v) : type(Type::NUMBER), num(v) {}
-    
-// 符号构造函数
-Value::Value(std::string name) : type(Type::SYMBOL), symbol_name(std::move(name)) {}
+Value Value::symbol(std::string_view name) {
+    return symbol(SymbolTable::instance().intern(name));
+}
+
+Value Value::symbol(uint32_t id) {
+    Value v;
+    v.sym = id;
+    v.type = Type::SYMBOL;
+    return v;
+}
 
 Value::operator double() const {
     if (type != Type::NUMBER) throw std::runtime_error("Not a number");
     return num;
-}
\ No newline at end of file
+}
+
+std::string_view Value::symbol_name() const {
+    if (type != Type::SYMBOL) throw std::runtime_error("Not a symbol");
+    return SymbolTable::instance().name(sym);
+}
@@ -1,26 +1,36 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
 
+// 求值结果：16 字节、可平凡复制，按值传递不涉及堆分配与析构。
+// 符号值只保存名字在 SymbolTable 中的 id
 struct Value {
-    enum class Type {
+    enum class Type : uint8_t {
         NUMBER,    // 数值类型
-        COMPLEX,   // 复数类型（预留）
+        COMPLEX,   // 复数类型（预留，虚部可同符号名一样按 32 位下标存放）
         SYMBOL     // 符号类型（变量名）
     };
 
-    Type type = Type::NUMBER;
     double num = 0.0;
-    std::string symbol_name; // 存储符号名
+    uint32_t sym = 0; // 符号值的 id
+    Type type = Type::NUMBER;
 
     // 数值构造函数
-    explicit Value(double v = 0.0);
-    // 符号构造函数
-    explicit Value(std::string name);
+    explicit Value(double v = 0.0) : num(v) {}
+    // 符号值（变量名）
+    static Value symbol(std::string_view name);
+    static Value symbol(uint32_t id);
 
     operator double() const;
 
     bool is_number() const { return type == Type::NUMBER; }
     bool is_complex() const { return type == Type::COMPLEX; }
     bool is_symbol() const { return type == Type::SYMBOL; }
-};
\ No newline at end of file
+    // 符号值的名字
+    std::string_view symbol_name() const;
+};
+
+static_assert(sizeof(Value) == 16, "Value should stay within two machine words");
+static_assert(std::is_trivially_copyable_v<Value>, "Value is passed around by plain copies");
@@ -1,24 +1,43 @@
 #include "evaluator.h" // 节点递归运算需要
 #include "variable_expr.h"
+#include "compiled_expr.h"
+#include "printer.h"
+#include "expr_dag.h"
+#include "differentiator.h"
 
-VariableExpr::VariableExpr(std::string n) : name(std::move(n)) {}
+VariableExpr::VariableExpr(std::string_view n) : name(n) {}
 
-std::string VariableExpr::to_string() const {
-    return name;
+void VariableExpr::print(Printer& p) const {
+    p.text(name);
 }
 
 
-Value VariableExpr::evaluate(Evaluator& eval) const {
-    auto it = eval.variables.find(name);
-    if (it != eval.variables.end()) {
-        return Value(it->second);
+EvalResult VariableExpr::try_evaluate(Evaluator& eval) const {
+    if (const double* v = eval.findVariable(name)) {
+        return Value(*v);
     }
     else {
-        return Value(name); // 未定义变量返回符号值
+        return Value::symbol(name); // 未定义变量返回符号值
     }
 }
 
 
-std::unique_ptr<Expr> VariableExpr::simplify() const {
-    return std::make_unique<VariableExpr>(name);
-}
\ No newline at end of file
+const Expr* VariableExpr::simplify(ExprDag& dag) const {
+    return dag.variable(name, this);
+}
+
+
+void VariableExpr::compile(Compiler& c) const {
+    c.emit(OpCode::LOAD_VAR, c.slot(name));
+}
+
+
+const Expr* VariableExpr::share(ExprDag& dag) const {
+    return dag.variable(name);
+}
+
+
+const Expr* VariableExpr::derive(Differentiator& d) const {
+    d.note_read(name);
+    return d.number(name == d.variable() ? 1.0 : 0.0);
+}
@@ -1,13 +1,18 @@
 #pragma once
 
+#include <string_view>
+
 #include "expr.h"
 
 // 变量引用
-class VariableExpr : public Expr {
+class VariableExpr final : public Expr {
 public:
-    std::string name;
-    VariableExpr(std::string n);
-    Value evaluate(Evaluator& eval) const override;
-    std::unique_ptr<Expr> simplify() const override;
-    std::string to_string() const override;
+    std::string_view name;
+    VariableExpr(std::string_view n);
+    EvalResult try_evaluate(Evaluator& eval) const override;
+    const Expr* simplify(ExprDag& dag) const override;
+    void print(Printer& p) const override;
+    void compile(Compiler& c) const override;
+    const Expr* share(ExprDag& dag) const override;
+    const Expr* derive(Differentiator& d) const override;
 };
\ No newline at end of file
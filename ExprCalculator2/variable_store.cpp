@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "variable_store.h"
+#include "program.h"
+
+VariableStore::Reader::Reader(VariableStore& s) : store(s), slot(nullptr) {
+    std::lock_guard<std::mutex> lock(store.m);
+    for (ReaderSlot& r : store.readers) {
+        if (!r.active) {
+            slot = &r;
+            break;
+        }
+    }
+    if (!slot) slot = &store.readers.emplace_back();
+    slot->active = true;
+}
+
+
+VariableStore::Reader::~Reader() {
+    std::lock_guard<std::mutex> lock(store.m);
+    slot->hazard.store(nullptr, std::memory_order_relaxed);
+    slot->active = false;
+}
+
+
+VariableStore::Reader::Pin VariableStore::Reader::pin() {
+    if (slot->hazard.load(std::memory_order_relaxed)) throw std::logic_error("Reader already holds a pinned snapshot");
+    // 先登记再确认仍是当前快照：写入方在替换之后才检查登记，两者都是顺序一致的，
+    // 确认成功时写入方要么还没替换它，要么一定能看到登记
+    const Snapshot* p = store.current.load(std::memory_order_seq_cst);
+    for (;;) {
+        slot->hazard.store(p, std::memory_order_seq_cst);
+        const Snapshot* now = store.current.load(std::memory_order_seq_cst);
+        if (now == p) break;
+        p = now;
+    }
+    return Pin(slot, p);
+}
+
+
+Value VariableStore::Reader::run(const Program& program, const Binding& binding, Context& ctx, uint64_t* version) {
+    if (binding.program != &program) throw std::logic_error("Binding was created for a different Program");
+    {
+        Pin snapshot = pin();
+        for (const auto& [var, index] : binding.slots) {
+            if (snapshot->defined[index]) ctx.set(var, snapshot->values[index]);
+            else ctx.unset(var);
+        }
+        if (version) *version = snapshot->version;
+    }
+    return program.run(ctx);
+}
+
+
+VariableStore::VariableStore(const std::vector<std::string>& vars) {
+    for (const std::string& name : vars) {
+        if (index.emplace(name, static_cast<uint32_t>(names.size())).second) names.push_back(name);
+    }
+    auto* first = new Snapshot;
+    first->published = std::chrono::steady_clock::now();
+    first->values.assign(names.size(), 0.0);
+    first->defined.assign(names.size(), 0);
+    current.store(first, std::memory_order_relaxed);
+}
+
+
+VariableStore::~VariableStore() {
+    delete current.load(std::memory_order_relaxed);
+    for (Snapshot* s : retired) delete s;
+    for (Snapshot* s : spare) delete s;
+}
+
+
+VarSlot VariableStore::variable(std::string_view name) const {
+    auto it = index.find(name);
+    if (it == index.end()) throw std::invalid_argument("VariableStore has no variable " + std::string(name));
+    return { it->second };
+}
+
+
+VariableStore::Binding VariableStore::bind(const Program& program) const {
+    Binding binding;
+    binding.program = &program;
+    for (uint32_t i = 0; i < program.variable_count(); ++i) {
+        VarSlot var{ i };
+        auto it = index.find(program.name_of(var));
+        if (it != index.end()) binding.slots.emplace_back(var, it->second);
+    }
+    return binding;
+}
+
+
+void VariableStore::check(VarSlot slot) const {
+    if (slot.index >= names.size()) throw std::invalid_argument("VariableStore slot out of range");
+}
+
+
+uint64_t VariableStore::set(std::span<const Update> updates) {
+    for (const Update& u : updates) check(u.slot);
+    std::lock_guard<std::mutex> lock(m);
+    Snapshot* next = next_snapshot();
+    for (const Update& u : updates) {
+        next->values[u.slot.index] = u.value;
+        next->defined[u.slot.index] = 1;
+    }
+    return publish(next);
+}
+
+
+uint64_t VariableStore::set(VarSlot slot, double value) {
+    const Update update{ slot, value };
+    return set(std::span<const Update>(&update, 1));
+}
+
+
+uint64_t VariableStore::unset(VarSlot slot) {
+    check(slot);
+    std::lock_guard<std::mutex> lock(m);
+    Snapshot* next = next_snapshot();
+    next->defined[slot.index] = 0;
+    return publish(next);
+}
+
+
+// 当前快照的副本（复用回收的快照，不重新分配）
+VariableStore::Snapshot* VariableStore::next_snapshot() {
+    Snapshot* next;
+    if (spare.empty()) {
+        next = new Snapshot;
+    }
+    else {
+        next = spare.back();
+        spare.pop_back();
+    }
+    const Snapshot* now = current.load(std::memory_order_relaxed);
+    next->values = now->values;
+    next->defined = now->defined;
+    return next;
+}
+
+
+uint64_t VariableStore::publish(Snapshot* next) {
+    Snapshot* old = current.load(std::memory_order_relaxed);
+    next->version = old->version + 1;
+    next->published = std::chrono::steady_clock::now();
+    current.store(next, std::memory_order_seq_cst);
+    retired.push_back(old);
+    ++published;
+    reclaim_locked();
+    return next->version;
+}
+
+
+size_t VariableStore::reclaim() {
+    std::lock_guard<std::mutex> lock(m);
+    return reclaim_locked();
+}
+
+
+size_t VariableStore::reclaim_locked() {
+    // 收集所有读取方登记的快照，不在其中的已替换快照可以回收
+    hazards.clear();
+    for (const ReaderSlot& r : readers) {
+        if (const Snapshot* p = r.hazard.load(std::memory_order_seq_cst)) hazards.push_back(p);
+    }
+    size_t freed = 0;
+    auto keep = std::remove_if(retired.begin(), retired.end(), [&](Snapshot* s) {
+        if (std::find(hazards.begin(), hazards.end(), s) != hazards.end()) return false;
+        if (spare.size() < MAX_SPARE) spare.push_back(s);
+        else delete s;
+        ++freed;
+        return true;
+    });
+    retired.erase(keep, retired.end());
+    reclaimed += freed;
+    return freed;
+}
+
+
+VariableStore::Stats VariableStore::stats() const {
+    std::lock_guard<std::mutex> lock(m);
+    const Snapshot* now = current.load(std::memory_order_relaxed);
+    const auto clock = std::chrono::steady_clock::now();
+    Stats s;
+    s.version = now->version;
+    s.published = published;
+    s.reclaimed = reclaimed;
+    s.retired = retired.size();
+    for (const Snapshot* r : retired) s.reclaim_lag = std::max(s.reclaim_lag, now->version - r->version);
+
+    for (const ReaderSlot& r : readers) {
+        if (!r.active) continue;
+        ++s.readers;
+        const Snapshot* p = r.hazard.load(std::memory_order_seq_cst);
+        if (!p) continue;
+        ++s.pinned;
+        // 正在确认中的登记可能指向已回收的快照，只读取仍然存在的（当前或等待回收的）
+        if (p != now && std::find(retired.begin(), retired.end(), p) == retired.end()) continue;
+        s.pinned_lag = std::max(s.pinned_lag, now->version - p->version);
+        s.pinned_age = std::max(s.pinned_age, std::chrono::duration<double>(clock - p->published).count());
+    }
+    return s;
+}
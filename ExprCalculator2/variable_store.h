@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "evaluator.h"
+#include "string_map.h"
+
+class Context;
+class Program;
+
+// 多线程共享的变量表（MVCC / RCU）：写入方在当前快照的副本上修改，整体发布为新版本，已发布的快照不再改变；
+// 读取方在一次求值期间固定（pin）一个快照，读到的变量都来自同一版本，不加锁。
+// 被替换的快照在没有读取方固定它之后回收（每个读取方登记正在读的快照，即 hazard pointer），回收的快照留给之后的发布复用。
+// 写入方之间用互斥锁串行；读取方每线程一个 Reader，只在创建与销毁时加锁，固定与释放只是原子读写。
+// 变量在构造时给定，按槽访问（槽与 Evaluator、Program 的无关，用 bind 对应到 Program）
+class VariableStore {
+public:
+    struct Snapshot {
+        uint64_t version = 0;
+        std::chrono::steady_clock::time_point published;
+        std::vector<double> values; // 按槽
+        std::vector<uint8_t> defined;
+    };
+
+    struct Update {
+        VarSlot slot;
+        double value;
+    };
+
+    struct Stats {
+        uint64_t version = 0;           // 当前版本（构造时为 0）
+        uint64_t published = 0;         // 发布的快照数
+        uint64_t reclaimed = 0;         // 回收的快照数
+        size_t retired = 0;             // 已被替换、等待回收的快照数
+        size_t readers = 0;             // 存在的 Reader 数
+        size_t pinned = 0;              // 正在固定快照的 Reader 数
+        uint64_t pinned_lag = 0;        // 当前版本与被固定的最旧快照之差
+        double pinned_age = 0.0;        // 被固定的最旧快照发布至今的秒数
+        uint64_t reclaim_lag = 0;       // 当前版本与等待回收的最旧快照之差
+    };
+
+    // Program 的变量与本表同名变量的对应关系
+    class Binding {
+        friend class VariableStore;
+        const Program* program = nullptr;
+        std::vector<std::pair<VarSlot, uint32_t>> slots; // (Program 的槽, 本表的槽)
+    };
+
+private:
+    struct alignas(64) ReaderSlot {
+        std::atomic<const Snapshot*> hazard{ nullptr }; // 正在读的快照
+        bool active = false; // 由 mutex 保护
+    };
+
+public:
+    // 读取线程的登记项：不能被多个线程同时使用，须在 VariableStore 之前销毁
+    class Reader {
+        VariableStore& store;
+        ReaderSlot* slot;
+    public:
+        // 固定的快照，析构时释放；同一 Reader 同时只能有一个 Pin
+        class Pin {
+            ReaderSlot* slot;
+            const Snapshot* snapshot;
+            friend class Reader;
+            Pin(ReaderSlot* s, const Snapshot* p) : slot(s), snapshot(p) {}
+        public:
+            Pin(Pin&& other) noexcept : slot(std::exchange(other.slot, nullptr)), snapshot(other.snapshot) {}
+            Pin(const Pin&) = delete;
+            Pin& operator=(const Pin&) = delete;
+            Pin& operator=(Pin&&) = delete;
+            ~Pin() {
+                if (slot) slot->hazard.store(nullptr, std::memory_order_release);
+            }
+
+            const Snapshot& operator*() const { return *snapshot; }
+            const Snapshot* operator->() const { return snapshot; }
+        };
+
+        explicit Reader(VariableStore& store);
+        ~Reader();
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // 固定当前快照；已有 Pin 时抛出 std::logic_error
+        Pin pin();
+        // 把 binding 中的变量从当前快照复制到 ctx（快照中未定义的在 ctx 中也置为未定义）后求值，
+        // 只在复制期间固定快照；version 不为空时写入所用快照的版本
+        Value run(const Program& program, const Binding& binding, Context& ctx, uint64_t* version = nullptr);
+    };
+
+    explicit VariableStore(const std::vector<std::string>& names);
+    ~VariableStore();
+    VariableStore(const VariableStore&) = delete;
+    VariableStore& operator=(const VariableStore&) = delete;
+
+    size_t size() const { return names.size(); }
+    // 变量的槽，不存在时抛出 std::invalid_argument
+    VarSlot variable(std::string_view name) const;
+    const std::string& name_of(VarSlot slot) const { return names[slot.index]; }
+    Binding bind(const Program& program) const;
+
+    // 以下各自发布一个新版本并返回版本号，同时回收已无人读取的快照；槽越界时抛出 std::invalid_argument
+    uint64_t set(std::span<const Update> updates);
+    uint64_t set(VarSlot slot, double value);
+    uint64_t set(std::string_view name, double value) { return set(variable(name), value); }
+    uint64_t unset(VarSlot slot);
+
+    // 回收已无人读取的快照，返回回收的个数（发布时会自动进行，读取方空闲后可再调用一次）
+    size_t reclaim();
+    Stats stats() const;
+private:
+    static constexpr size_t MAX_SPARE = 4;
+
+    StringMap<uint32_t> index;
+    std::vector<std::string> names;
+    std::atomic<Snapshot*> current;
+
+    mutable std::mutex m; // 保护以下成员，写入方之间串行
+    std::deque<ReaderSlot> readers;
+    std::vector<Snapshot*> retired; // 已被替换，可能仍有读取方固定
+    std::vector<Snapshot*> spare;   // 已回收，留给下次发布
+    std::vector<const Snapshot*> hazards;
+    uint64_t published = 0;
+    uint64_t reclaimed = 0;
+
+    void check(VarSlot slot) const;
+    Snapshot* next_snapshot();
+    uint64_t publish(Snapshot* next);
+    size_t reclaim_locked();
+};
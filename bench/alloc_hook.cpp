@@ -0,0 +1,43 @@
+#include <cstdlib>
+#include <new>
+
+#include "bench_util.h"
+
+// 替换全局 operator new/delete，统计分配次数与字节数
+
+bench::AllocStats& bench::alloc_stats() {
+    static AllocStats stats;
+    return stats;
+}
+
+static void* counted_alloc(std::size_t size) {
+    auto& stats = bench::alloc_stats();
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    stats.bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+static void* counted_aligned_alloc(std::size_t size, std::align_val_t align) {
+    auto& stats = bench::alloc_stats();
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    stats.bytes.fetch_add(size, std::memory_order_relaxed);
+    std::size_t a = static_cast<std::size_t>(align);
+    std::size_t rounded = (size + a - 1) / a * a;
+    if (void* p = std::aligned_alloc(a, rounded ? rounded : a)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) { return counted_alloc(size); }
+void* operator new[](std::size_t size) { return counted_alloc(size); }
+void* operator new(std::size_t size, std::align_val_t align) { return counted_aligned_alloc(size, align); }
+void* operator new[](std::size_t size, std::align_val_t align) { return counted_aligned_alloc(size, align); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
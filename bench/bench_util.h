@@ -0,0 +1,174 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+// 基准测试公共工具：分配计数、计时循环、峰值 RSS、JSON 输出
+
+namespace bench {
+
+// 由 alloc_hook.cpp 中替换的全局 operator new 累加
+struct AllocStats {
+    std::atomic<uint64_t> count{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+};
+AllocStats& alloc_stats();
+
+struct Result {
+    std::string suite;   // 语料名
+    std::string phase;   // lex / parse / simplify / evaluate ...
+    uint64_t iterations = 0;
+    double ns_per_op = 0.0;
+    double allocs_per_op = 0.0;
+    double bytes_per_op = 0.0;
+    uint64_t input_bytes = 0; // 每次操作处理的输入字节数，非 0 时额外报告吞吐量
+
+    double mb_per_s() const { return input_bytes ? input_bytes / ns_per_op * 1e3 : 0.0; }
+};
+
+// 固定种子的线性同余生成器，保证每次运行语料一致
+struct Lcg {
+    uint64_t state;
+    explicit Lcg(uint64_t seed) : state(seed) {}
+    uint32_t next() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>(state >> 33);
+    }
+    uint32_t below(uint32_t n) { return next() % n; }
+};
+
+// 峰值常驻内存（KiB）
+inline long peak_rss_kb() {
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+// 反复执行 fn，直到累计时间超过 min_seconds 且至少执行 min_iters 次
+template <class Fn>
+Result run(const std::string& suite, const std::string& phase, double min_seconds, uint64_t min_iters, Fn&& fn) {
+    using clock = std::chrono::steady_clock;
+    fn(); // 预热
+
+    auto& stats = alloc_stats();
+    uint64_t iters = 0;
+    uint64_t allocs0 = stats.count.load(std::memory_order_relaxed);
+    uint64_t bytes0 = stats.bytes.load(std::memory_order_relaxed);
+    auto start = clock::now();
+    double elapsed = 0.0;
+    do {
+        fn();
+        ++iters;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < min_seconds || iters < min_iters);
+
+    Result r;
+    r.suite = suite;
+    r.phase = phase;
+    r.iterations = iters;
+    r.ns_per_op = elapsed * 1e9 / iters;
+    r.allocs_per_op = double(stats.count.load(std::memory_order_relaxed) - allocs0) / iters;
+    r.bytes_per_op = double(stats.bytes.load(std::memory_order_relaxed) - bytes0) / iters;
+    return r;
+}
+
+inline std::string json_escape(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        }
+        else out += c;
+    }
+    return out;
+}
+
+inline void print_header() {
+    std::printf("%-16s %-12s %12s %14s %12s %14s\n", "suite", "phase", "iters", "ns/op", "allocs/op", "bytes/op");
+}
+
+inline void print_result(const Result& r) {
+    std::printf("%-16s %-12s %12llu %14.1f %12.1f %14.1f", r.suite.c_str(), r.phase.c_str(),
+        static_cast<unsigned long long>(r.iterations), r.ns_per_op, r.allocs_per_op, r.bytes_per_op);
+    if (r.input_bytes) std::printf("   %.1f MB/s", r.mb_per_s());
+    std::printf("\n");
+}
+
+// 输出机器可读的结果，便于对比两次运行
+inline bool write_json(const std::string& path, const std::string& name, const std::vector<Result>& results) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+    std::fprintf(f, "{\n  \"benchmark\": \"%s\",\n  \"peak_rss_kb\": %ld,\n  \"results\": [\n",
+        json_escape(name).c_str(), peak_rss_kb());
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        std::fprintf(f,
+            "    {\"suite\": \"%s\", \"phase\": \"%s\", \"iterations\": %llu, "
+            "\"ns_per_op\": %.3f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.3f",
+            json_escape(r.suite).c_str(), json_escape(r.phase).c_str(),
+            static_cast<unsigned long long>(r.iterations), r.ns_per_op, r.allocs_per_op, r.bytes_per_op);
+        if (r.input_bytes) std::fprintf(f, ", \"mb_per_s\": %.3f", r.mb_per_s());
+        std::fprintf(f, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+    std::fclose(f);
+    return true;
+}
+
+// 各基准程序共用的命令行参数
+struct Options {
+    double min_seconds = 0.2;
+    uint64_t min_iters = 5;
+    std::string json_path;
+    std::string filter;
+
+    bool selected(const std::string& suite) const {
+        return filter.empty() || suite.find(filter) != std::string::npos;
+    }
+};
+
+// 解析失败时打印用法并返回 false
+inline bool parse_options(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if (arg("--json")) opt.json_path = argv[++i];
+        else if (arg("--min-time")) opt.min_seconds = std::atof(argv[++i]);
+        else if (arg("--min-iters")) opt.min_iters = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg("--filter")) opt.filter = argv[++i];
+        else {
+            std::fprintf(stderr,
+                "usage: %s [--json FILE] [--min-time SECONDS] [--min-iters N] [--filter SUITE]\n", argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// 打印峰值 RSS，并按需写出 JSON；返回进程退出码
+inline int finish(const Options& opt, const std::string& name, const std::vector<Result>& results) {
+    std::printf("peak RSS: %ld KiB\n", peak_rss_kb());
+    if (!opt.json_path.empty() && !write_json(opt.json_path, name, results)) {
+        std::fprintf(stderr, "cannot write %s\n", opt.json_path.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// 防止被优化掉
+template <class T>
+inline void do_not_optimize(const T& v) {
+    asm volatile("" : : "r,m"(v) : "memory");
+}
+
+} // namespace bench
@@ -0,0 +1,599 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "lexer.h"
+#include "parser.h"
+#include "evaluator.h"
+#include "compiled_expr.h"
+#include "batch_eval.h"
+#include "jit_expr.h"
+#include "parallel_eval.h"
+#include "expr_cache.h"
+#include "printer.h"
+#include "gradient.h"
+#include "program.h"
+#include "variable_store.h"
+
+// 分阶段测量 main.cpp 中每行的处理流程：
+//   lex      : Lexer::nextToken 直到 END
+//   parse    : Parser 构造（含词法分析）+ Parser::parse
+//   simplify : ParseResult::simplify 左值版本，复制到新的 Arena（含结果树的析构）
+//   in_place : Parser::parse 后原地化简（右值版本，未变的子树直接复用）
+//   cached   : ExprCache::get 命中（规范化 + 查找），对应重复输入时 parse + simplify 的开销
+//   print    : 把化简结果追加写入复用的缓冲区（Printer），吞吐量按输出的字节数计
+//   evaluate : Evaluator::evaluate
+//   compile  : 生成字节码（CompiledExpr 构造）
+//   vm       : CompiledExpr::evaluate
+//   jit      : JitExpr::evaluate（x86-64 Linux 上为生成的机器码）
+// value 组：深层嵌套表达式的树求值、未定义变量（符号值）的求值，并报告 sizeof(Value) 与树求值每层嵌套占用的栈；
+//   throw_5pct / result_5pct 逐行树求值，5% 的行除以零，分别用抛异常的 evaluate 与返回错误的 try_evaluate
+// rows 组：同一公式对 ROWS 行输入求值，逐行 VM / JIT（按槽写入变量）、Program + Context、eval_batch 与多线程 ParallelEvaluator 对比
+// functions 组：调用用户函数的公式，按调用执行（不内联）与化简时内联后的 VM 求值、Program::run（调用点已解析）对比
+// gradient 组：对 VARS 个变量求梯度，中心差分（2 * VARS 次 VM 求值）与反向模式自动微分（GradientTape）对比
+// reactive 组：CELLS 个相互依赖的公式（INPUTS 个输入各带一条链），改变一个输入后全部重新求值与响应式绑定的增量更新对比
+// store 组：VARS 个变量的共享变量表，加锁的 Evaluator（set / 求值）与 VariableStore（发布新版本 / 固定快照后求值）对比
+
+namespace {
+
+struct Corpus {
+    std::string name;
+    std::vector<std::string> lines;
+};
+
+const char* const kVars[] = { "x", "y", "z" };
+
+Corpus short_formulas() {
+    return { "short", {
+        "1 + 2 * 3",
+        "(3 + 4 * 2) / (sqrt(16) - 2) ^ 2",
+        "x * y + (x + y) ** 2",
+        "x > 5 ? x * 2 : x / 2",
+        "!(5 == 5 || 10 < 2)",
+        "2 * x + 3 * x - y",
+        "pi * z ^ 2",
+        "a = x * 2 + 1",
+    } };
+}
+
+Corpus generated_sum(size_t terms) {
+    bench::Lcg rng(42);
+    std::string s;
+    s.reserve(terms * 12);
+    for (size_t i = 0; i < terms; ++i) {
+        if (i > 0) s += rng.below(2) ? " + " : " - ";
+        s += std::to_string(rng.below(1000) + 1);
+        s += ".";
+        s += std::to_string(rng.below(100));
+        s += " * ";
+        s += kVars[rng.below(3)];
+    }
+    return { "sum10k", { s } };
+}
+
+Corpus nested_ternary(size_t depth) {
+    std::string s;
+    for (size_t i = 0; i < depth; ++i) {
+        s += "x > " + std::to_string(i) + " ? " + std::to_string(i) + " * y : (";
+    }
+    s += "z";
+    s.append(depth, ')');
+    return { "ternary", { s } };
+}
+
+Corpus trig_calls(size_t terms) {
+    static const char* const funcs[] = { "sin", "cos", "tan", "sqrt", "abs", "exp", "ln", "log" };
+    bench::Lcg rng(7);
+    std::string s;
+    for (size_t i = 0; i < terms; ++i) {
+        if (i > 0) s += " + ";
+        const char* f = funcs[rng.below(8)];
+        const char* g = funcs[rng.below(3)];
+        // 参数取 abs 后加 1，避免 ln/log/sqrt 的定义域问题
+        s += std::string(f) + "(abs(" + g + "(" + kVars[rng.below(3)] + " * 0." + std::to_string(rng.below(9) + 1) + ")) + 1)";
+    }
+    return { "trig", { s } };
+}
+
+// 机器生成的风险公式：少量子项在各处反复出现
+Corpus repeated_terms(size_t terms) {
+    static const char* const subterms[] = {
+        "sin(x * 0.5 + y)", "exp(-(z * z))", "sqrt(abs(x - y) + 1)", "(x * y + z)",
+    };
+    bench::Lcg rng(3);
+    std::string s;
+    for (size_t i = 0; i < terms; ++i) {
+        if (i > 0) s += " + ";
+        s += std::string(subterms[rng.below(4)]) + " * " + subterms[rng.below(4)] + " / (1 + " + subterms[rng.below(4)] + " ^ 2)";
+    }
+    return { "repeated", { s } };
+}
+
+// 三个变量、每个变量最高 3 次的随机单项式之和，同类项很多
+Corpus generated_polynomial(size_t terms) {
+    bench::Lcg rng(5);
+    std::string s;
+    s.reserve(terms * 16);
+    for (size_t i = 0; i < terms; ++i) {
+        if (i > 0) s += rng.below(2) ? " + " : " - ";
+        s += std::to_string(rng.below(9) + 1);
+        for (const char* var : kVars) {
+            size_t exp = rng.below(4);
+            if (exp == 0) continue;
+            s += " * ";
+            s += var;
+            if (exp > 1) s += " ^ " + std::to_string(exp);
+        }
+    }
+    return { "poly100k", { s } };
+}
+
+void bind_inputs(Evaluator& eval) {
+    eval.setVariable("x", 1.25);
+    eval.setVariable("y", -0.5);
+    eval.setVariable("z", 3.0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Options opt;
+    if (!bench::parse_options(argc, argv, opt)) return 2;
+
+    std::vector<Corpus> corpora = {
+        short_formulas(),
+        generated_sum(10000),
+        nested_ternary(200),
+        trig_calls(500),
+        repeated_terms(200),
+        generated_polynomial(100000),
+    };
+
+    std::vector<bench::Result> results;
+    bench::print_header();
+    auto record = [&](bench::Result r) {
+        bench::print_result(r);
+        results.push_back(std::move(r));
+    };
+
+    for (const auto& corpus : corpora) {
+        if (!opt.selected(corpus.name)) continue;
+        const auto& lines = corpus.lines;
+
+        record(bench::run(corpus.name, "lex", opt.min_seconds, opt.min_iters, [&] {
+            for (const auto& line : lines) {
+                Lexer lexer(line);
+                while (lexer.nextToken().type != TokenType::END) {}
+            }
+        }));
+
+        record(bench::run(corpus.name, "parse", opt.min_seconds, opt.min_iters, [&] {
+            for (const auto& line : lines) {
+                Parser parser(line);
+                auto ast = parser.parse();
+                bench::do_not_optimize(ast.get());
+            }
+        }));
+
+        std::vector<ParseResult> asts;
+        for (const auto& line : lines) asts.push_back(Parser(line).parse());
+
+        record(bench::run(corpus.name, "simplify", opt.min_seconds, opt.min_iters, [&] {
+            for (const auto& ast : asts) {
+                auto simplified = ast.simplify();
+                bench::do_not_optimize(simplified.get());
+            }
+        }));
+
+        record(bench::run(corpus.name, "in_place", opt.min_seconds, opt.min_iters, [&] {
+            for (const auto& line : lines) {
+                auto simplified = Parser(line).parse().simplify();
+                bench::do_not_optimize(simplified.get());
+            }
+        }));
+
+        ExprCache cache;
+        for (const auto& line : lines) cache.get(line);
+        record(bench::run(corpus.name, "cached", opt.min_seconds, opt.min_iters, [&] {
+            for (const auto& line : lines) {
+                auto entry = cache.get(line);
+                bench::do_not_optimize(entry->get());
+            }
+        }));
+
+        std::vector<ParseResult> simplified;
+        for (const auto& ast : asts) simplified.push_back(ast.simplify());
+
+        std::string text;
+        auto printed = bench::run(corpus.name, "print", opt.min_seconds, opt.min_iters, [&] {
+            text.clear();
+            Printer printer(text);
+            for (const auto& ast : simplified) printer.print(ast.get());
+            bench::do_not_optimize(text.data());
+        });
+        printed.input_bytes = text.size();
+        record(printed);
+
+        Evaluator evaluator;
+        bind_inputs(evaluator);
+        record(bench::run(corpus.name, "evaluate", opt.min_seconds, opt.min_iters, [&] {
+            for (const auto& ast : simplified) {
+                Value v = evaluator.evaluate(ast.get());
+                bench::do_not_optimize(v.num);
+            }
+        }));
+
+        record(bench::run(corpus.name, "compile", opt.min_seconds, opt.min_iters, [&] {
+            for (const auto& ast : simplified) {
+                CompiledExpr compiled(ast.get(), evaluator);
+                bench::do_not_optimize(compiled.size());
+            }
+        }));
+
+        std::vector<CompiledExpr> programs;
+        for (const auto& ast : simplified) programs.emplace_back(ast.get(), evaluator);
+
+        record(bench::run(corpus.name, "vm", opt.min_seconds, opt.min_iters, [&] {
+            for (const auto& program : programs) {
+                Value v = program.evaluate(evaluator);
+                bench::do_not_optimize(v.num);
+            }
+        }));
+
+        std::vector<JitExpr> jitted;
+        for (const auto& ast : simplified) jitted.emplace_back(ast.get(), evaluator);
+
+        record(bench::run(corpus.name, "jit", opt.min_seconds, opt.min_iters, [&] {
+            for (const auto& program : jitted) {
+                Value v = program.evaluate(evaluator);
+                bench::do_not_optimize(v.num);
+            }
+        }));
+    }
+
+    // 每个 tick 更新几百个输入：按名字（每次哈希）与按槽句柄
+    if (opt.selected("inputs")) {
+        constexpr size_t INPUTS = 300;
+        Evaluator evaluator;
+        std::vector<std::string> names;
+        std::vector<VarSlot> slots;
+        for (size_t i = 0; i < INPUTS; ++i) {
+            names.push_back("input_" + std::to_string(i));
+            slots.push_back(evaluator.bind(names.back()));
+        }
+        double tick = 0.0;
+        record(bench::run("inputs", "set_by_name", opt.min_seconds, opt.min_iters, [&] {
+            tick += 1.0;
+            for (size_t i = 0; i < INPUTS; ++i) evaluator.setVariable(names[i], tick + i);
+        }));
+        record(bench::run("inputs", "set_by_slot", opt.min_seconds, opt.min_iters, [&] {
+            tick += 1.0;
+            for (size_t i = 0; i < INPUTS; ++i) evaluator.set(slots[i], tick + i);
+        }));
+        bench::do_not_optimize(evaluator.get(slots[0]));
+    }
+
+    if (opt.selected("value")) {
+        // x + (x + (... probe(1)))：不化简，保留每一层
+        auto nested = [](size_t levels) {
+            std::string s;
+            for (size_t i = 0; i < levels; ++i) s += "x + (";
+            s += "probe(1)";
+            s.append(levels, ')');
+            return Parser(s).parse();
+        };
+        Evaluator evaluator;
+        bind_inputs(evaluator);
+        // 函数表只保存函数指针，探针通过静态变量带出栈地址；不是纯函数，不会被折叠
+        static uintptr_t probe_sp = 0;
+        evaluator.functions.define("probe", +[](double v) {
+            volatile char mark = 0;
+            probe_sp = reinterpret_cast<uintptr_t>(&mark);
+            return v + mark;
+        }, 0);
+
+        constexpr size_t LEVELS = 1000;
+        auto shallow = nested(0);
+        auto deep = nested(LEVELS);
+        evaluator.evaluate(shallow.get());
+        uintptr_t top = probe_sp;
+        evaluator.evaluate(deep.get());
+        double per_level = double(top - probe_sp) / LEVELS;
+
+        record(bench::run("value", "deep_eval", opt.min_seconds, opt.min_iters, [&] {
+            Value v = evaluator.evaluate(deep.get());
+            bench::do_not_optimize(v.num);
+        }));
+
+        auto symbol = Parser("undefined_input_variable").parse();
+        record(bench::run("value", "symbol", opt.min_seconds, opt.min_iters, [&] {
+            for (int i = 0; i < 100; ++i) {
+                Value v = evaluator.evaluate(symbol.get());
+                bench::do_not_optimize(v.is_symbol());
+            }
+        }));
+        constexpr size_t ERROR_ROWS = 10000;
+        auto ratio = Parser("(x + 1) / y").parse();
+        VarSlot y = evaluator.bind("y");
+        std::vector<double> divisors(ERROR_ROWS);
+        bench::Lcg rng(13);
+        for (auto& d : divisors) d = rng.below(100) < 5 ? 0.0 : rng.below(100) + 1.0;
+        record(bench::run("value", "throw_5pct", opt.min_seconds, opt.min_iters, [&] {
+            double sum = 0.0;
+            for (double d : divisors) {
+                evaluator.set(y, d);
+                try {
+                    sum += evaluator.evaluate(ratio.get()).num;
+                }
+                catch (const std::runtime_error&) {}
+            }
+            bench::do_not_optimize(sum);
+        }));
+        record(bench::run("value", "result_5pct", opt.min_seconds, opt.min_iters, [&] {
+            double sum = 0.0;
+            for (double d : divisors) {
+                evaluator.set(y, d);
+                EvalResult r = evaluator.try_evaluate(ratio.get());
+                if (r) sum += r->num;
+            }
+            bench::do_not_optimize(sum);
+        }));
+
+        std::printf("sizeof(Value): %zu bytes, tree evaluation stack: %.0f bytes per nesting level\n",
+            sizeof(Value), per_level);
+    }
+
+    if (opt.selected("rows")) {
+        constexpr size_t ROWS = 100000;
+        static const std::pair<const char*, const char*> formulas[] = {
+            { "poly", "3 * x ^ 2 + 2 * x * y - y / 4 + 1" },
+            { "cond", "x > y ? (x - y) * z : (y - x) / z" },
+            { "trig", "sin(x) * cos(y) + sqrt(abs(z))" },
+        };
+        bench::Lcg rng(11);
+        std::vector<double> xs(ROWS), ys(ROWS), zs(ROWS), out(ROWS);
+        for (size_t i = 0; i < ROWS; ++i) {
+            xs[i] = rng.below(2000) / 100.0 - 10.0;
+            ys[i] = rng.below(2000) / 100.0 - 10.0;
+            zs[i] = rng.below(1000) / 100.0 + 1.0;
+        }
+
+        ParallelEvaluator parallel;
+        for (const auto& [name, source] : formulas) {
+            std::string suite = std::string("rows/") + name;
+            auto ast = Parser(source).parse().simplify();
+            Evaluator evaluator;
+            VarSlot x = evaluator.bind("x"), y = evaluator.bind("y"), z = evaluator.bind("z");
+            CompiledExpr program(ast.get(), evaluator);
+
+            auto vm = bench::run(suite, "vm_loop", opt.min_seconds, opt.min_iters, [&] {
+                for (size_t i = 0; i < ROWS; ++i) {
+                    evaluator.set(x, xs[i]);
+                    evaluator.set(y, ys[i]);
+                    evaluator.set(z, zs[i]);
+                    out[i] = program.evaluate(evaluator).num;
+                }
+                bench::do_not_optimize(out.data());
+            });
+            vm.input_bytes = ROWS * 3 * sizeof(double);
+            record(vm);
+
+            Program shared(ast.get(), FunctionRegistry::builtins(), { "x", "y", "z" });
+            Context context(shared);
+            VarSlot px = shared.variable("x"), py = shared.variable("y"), pz = shared.variable("z");
+            auto run = bench::run(suite, "program_loop", opt.min_seconds, opt.min_iters, [&] {
+                for (size_t i = 0; i < ROWS; ++i) {
+                    context.set(px, xs[i]);
+                    context.set(py, ys[i]);
+                    context.set(pz, zs[i]);
+                    out[i] = shared.run(context).num;
+                }
+                bench::do_not_optimize(out.data());
+            });
+            run.input_bytes = ROWS * 3 * sizeof(double);
+            record(run);
+
+            JitExpr jit(ast.get(), evaluator);
+            auto native = bench::run(suite, "jit_loop", opt.min_seconds, opt.min_iters, [&] {
+                for (size_t i = 0; i < ROWS; ++i) {
+                    evaluator.set(x, xs[i]);
+                    evaluator.set(y, ys[i]);
+                    evaluator.set(z, zs[i]);
+                    out[i] = jit.evaluate(evaluator).num;
+                }
+                bench::do_not_optimize(out.data());
+            });
+            native.input_bytes = ROWS * 3 * sizeof(double);
+            record(native);
+
+            auto batch = bench::run(suite, "batch", opt.min_seconds, opt.min_iters, [&] {
+                eval_batch(program, evaluator, { { "x", xs }, { "y", ys }, { "z", zs } }, out);
+                bench::do_not_optimize(out.data());
+            });
+            batch.input_bytes = ROWS * 3 * sizeof(double);
+            record(batch);
+
+            const BatchColumn columns[] = { { "x", xs }, { "y", ys }, { "z", zs } };
+            auto threaded = bench::run(suite, "parallel", opt.min_seconds, opt.min_iters, [&] {
+                parallel.evaluate(program, evaluator, columns, out);
+                bench::do_not_optimize(out.data());
+            });
+            threaded.phase += "/" + std::to_string(parallel.threads()) + "t";
+            threaded.input_bytes = ROWS * 3 * sizeof(double);
+            record(threaded);
+        }
+    }
+
+    if (opt.selected("functions")) {
+        Evaluator evaluator;
+        evaluator.evaluate(Parser("sq(t) = t * t").parse().get());
+        evaluator.evaluate(Parser("poly(x, y) = 3 * sq(x) + 2 * x * y - y / 4 + 1").parse().get());
+        evaluator.set(evaluator.bind("a"), 1.5);
+        evaluator.set(evaluator.bind("b"), -2.0);
+
+        const char* source = "poly(a, b) + poly(b, a) * sq(a - b)";
+        auto called = Parser(source).parse().simplify();
+        auto inlined = Parser(source).parse().simplify(&evaluator.functions);
+        CompiledExpr call_program(called.get(), evaluator);
+        CompiledExpr inline_program(inlined.get(), evaluator);
+
+        record(bench::run("functions", "vm_call", opt.min_seconds, opt.min_iters, [&] {
+            bench::do_not_optimize(call_program.evaluate(evaluator));
+        }));
+        record(bench::run("functions", "vm_inlined", opt.min_seconds, opt.min_iters, [&] {
+            bench::do_not_optimize(inline_program.evaluate(evaluator));
+        }));
+        Program shared(called.get(), evaluator.functions);
+        Context context(shared);
+        context.set("a", 1.5);
+        context.set("b", -2.0);
+        record(bench::run("functions", "program_call", opt.min_seconds, opt.min_iters, [&] {
+            bench::do_not_optimize(shared.run(context));
+        }));
+        record(bench::run("functions", "evaluate", opt.min_seconds, opt.min_iters, [&] {
+            bench::do_not_optimize(evaluator.evaluate(called.get()));
+        }));
+    }
+
+    if (opt.selected("gradient")) {
+        constexpr size_t VARS = 100;
+        std::string source;
+        std::vector<std::string> names;
+        for (size_t i = 0; i < VARS; ++i) names.push_back("v" + std::to_string(i));
+        for (size_t i = 0; i < VARS; ++i) {
+            const std::string& a = names[i];
+            const std::string& b = names[(i + 1) % VARS];
+            if (i > 0) source += " + ";
+            source += "(" + a + " - " + b + ") ^ 2 + sin(" + a + ") * exp(" + b + " / 10)";
+        }
+        auto ast = Parser(source).parse().simplify();
+        Evaluator evaluator;
+        std::vector<std::string_view> vars(names.begin(), names.end());
+        std::vector<VarSlot> slots;
+        bench::Lcg rng(5);
+        for (std::string_view name : vars) {
+            slots.push_back(evaluator.bind(name));
+            evaluator.set(slots.back(), rng.below(2000) / 1000.0 - 1.0);
+        }
+        CompiledExpr program(ast.get(), evaluator);
+        GradientTape tape(ast.get(), evaluator, vars);
+        std::vector<double> grad(VARS);
+
+        record(bench::run("gradient", "central_diff", opt.min_seconds, opt.min_iters, [&] {
+            for (size_t i = 0; i < VARS; ++i) {
+                double x = evaluator.get(slots[i]);
+                double h = 1e-6 * (1.0 + std::abs(x));
+                evaluator.set(slots[i], x + h);
+                double up = program.evaluate(evaluator).num;
+                evaluator.set(slots[i], x - h);
+                double down = program.evaluate(evaluator).num;
+                evaluator.set(slots[i], x);
+                grad[i] = (up - down) / (2.0 * h);
+            }
+            bench::do_not_optimize(grad.data());
+        }));
+        record(bench::run("gradient", "tape", opt.min_seconds, opt.min_iters, [&] {
+            bench::do_not_optimize(tape.evaluate(evaluator, grad));
+        }));
+        std::printf("gradient: %zu variables, tape %zu nodes / %zu edges\n", VARS, tape.tape_nodes(), tape.tape_edges());
+    }
+
+    if (opt.selected("reactive")) {
+        constexpr size_t CELLS = 20000;
+        constexpr size_t INPUTS = 100;
+        // c_i = x_(i % INPUTS) * 2 + c_(i - INPUTS)：每个输入只影响 CELLS / INPUTS 个公式
+        auto formula = [&](size_t i) {
+            std::string s = "x" + std::to_string(i % INPUTS) + " * 2";
+            if (i >= INPUTS) s += " + c" + std::to_string(i - INPUTS);
+            return s;
+        };
+        Evaluator snapshot, reactive;
+        std::vector<VarSlot> snapshot_inputs, reactive_inputs;
+        for (size_t i = 0; i < INPUTS; ++i) {
+            std::string name = "x" + std::to_string(i);
+            snapshot_inputs.push_back(snapshot.bind(name));
+            reactive_inputs.push_back(reactive.bind(name));
+            snapshot.set(snapshot_inputs.back(), 1.0);
+            reactive.set(reactive_inputs.back(), 1.0);
+        }
+        std::vector<CompiledExpr> sheet;
+        sheet.reserve(CELLS);
+        for (size_t i = 0; i < CELLS; ++i) {
+            std::string cell = "c" + std::to_string(i);
+            auto ast = Parser(cell + " = " + formula(i)).parse();
+            sheet.emplace_back(ast.get(), snapshot);
+            auto expr = Parser(formula(i)).parse();
+            reactive.define_reactive(cell, expr.get());
+        }
+
+        size_t input = 0;
+        double value = 1.0;
+        record(bench::run("reactive", "recompute_all", opt.min_seconds, opt.min_iters, [&] {
+            snapshot.set(snapshot_inputs[input], value += 1.0);
+            input = (input + 1) % INPUTS;
+            for (const CompiledExpr& cell : sheet) bench::do_not_optimize(cell.evaluate(snapshot));
+        }));
+        uint64_t before = reactive.bindings().recomputations();
+        uint64_t updates = 0;
+        record(bench::run("reactive", "incremental", opt.min_seconds, opt.min_iters, [&] {
+            reactive.set(reactive_inputs[input], value += 1.0);
+            input = (input + 1) % INPUTS;
+            ++updates;
+        }));
+        std::printf("reactive: %zu formulas, %.0f recomputed per update\n", reactive.bindings().size(),
+            static_cast<double>(reactive.bindings().recomputations() - before) / static_cast<double>(updates));
+    }
+
+    if (opt.selected("store")) {
+        constexpr size_t VARS = 64;
+        std::vector<std::string> names;
+        for (size_t i = 0; i < VARS; ++i) names.push_back("v" + std::to_string(i));
+        const char* source = "v0 * v1 + v2 / v3 - v4";
+
+        Evaluator evaluator;
+        std::vector<VarSlot> slots;
+        for (const std::string& name : names) {
+            slots.push_back(evaluator.bind(name));
+            evaluator.set(slots.back(), 1.0);
+        }
+        auto ast = Parser(source).parse();
+        CompiledExpr compiled(ast.get(), evaluator);
+        std::mutex m;
+
+        VariableStore store(names);
+        for (const std::string& name : names) store.set(name, 1.0);
+        Program program(ast.get());
+        VariableStore::Binding binding = store.bind(program);
+        VariableStore::Reader reader(store);
+        Context context(program);
+
+        size_t next = 0;
+        double value = 1.0;
+        record(bench::run("store", "mutex_set", opt.min_seconds, opt.min_iters, [&] {
+            std::lock_guard<std::mutex> lock(m);
+            evaluator.set(slots[next], value += 1.0);
+            next = (next + 1) % VARS;
+        }));
+        record(bench::run("store", "publish", opt.min_seconds, opt.min_iters, [&] {
+            bench::do_not_optimize(store.set(VarSlot{ static_cast<uint32_t>(next) }, value += 1.0));
+            next = (next + 1) % VARS;
+        }));
+        record(bench::run("store", "mutex_eval", opt.min_seconds, opt.min_iters, [&] {
+            std::lock_guard<std::mutex> lock(m);
+            bench::do_not_optimize(compiled.evaluate(evaluator));
+        }));
+        record(bench::run("store", "pinned_eval", opt.min_seconds, opt.min_iters, [&] {
+            bench::do_not_optimize(reader.run(program, binding, context));
+        }));
+        VariableStore::Stats stats = store.stats();
+        std::printf("store: %zu variables, version %llu, %llu snapshots reclaimed, %zu awaiting\n", VARS,
+            static_cast<unsigned long long>(stats.version), static_cast<unsigned long long>(stats.reclaimed), stats.retired);
+    }
+
+    return bench::finish(opt, "expr_bench", results);
+}
@@ -0,0 +1,104 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "lexer.h"
+#include "number_scan.h"
+
+// 数值字面量密集输入上的词法分析吞吐量：
+//   stod      : 旧实现的做法（substr + std::stod + try/catch）
+//   from_chars: scan_number
+//   lexer     : 完整的 Lexer::nextToken 循环
+
+namespace {
+
+// 生成常见形态的字面量：定点小数、科学计数法、整数
+std::vector<std::string> make_literals(size_t n) {
+    bench::Lcg rng(2024);
+    std::vector<std::string> out;
+    out.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        std::string s = std::to_string(rng.below(100000));
+        switch (rng.below(4)) {
+        case 0:
+            s += '.';
+            s += std::to_string(rng.below(1000000));
+            break;
+        case 1:
+            s += '.';
+            s += std::to_string(rng.below(1000));
+            s += "e-";
+            s += std::to_string(rng.below(30));
+            break;
+        case 2:
+            s += 'e';
+            s += std::to_string(rng.below(300));
+            break;
+        default: break;
+        }
+        out.push_back(std::move(s));
+    }
+    return out;
+}
+
+double stod_scan(const std::string& src, size_t start, size_t len) {
+    std::string num_str = src.substr(start, len);
+    try {
+        return std::stod(num_str);
+    }
+    catch (...) {
+        return 0.0;
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Options opt;
+    if (!bench::parse_options(argc, argv, opt)) return 2;
+
+    auto literals = make_literals(20000);
+
+    // 拼成一条公式，并记录每个字面量的位置
+    std::string source;
+    std::vector<std::pair<size_t, size_t>> spans;
+    for (const auto& lit : literals) {
+        if (!source.empty()) source += " + ";
+        spans.emplace_back(source.size(), lit.size());
+        source += lit;
+    }
+
+    std::vector<bench::Result> results;
+    bench::print_header();
+    auto record = [&](bench::Result r) {
+        r.input_bytes = source.size();
+        bench::print_result(r);
+        results.push_back(std::move(r));
+    };
+
+    if (opt.selected("literals")) {
+        record(bench::run("literals", "stod", opt.min_seconds, opt.min_iters, [&] {
+            double sum = 0.0;
+            for (auto [start, len] : spans) sum += stod_scan(source, start, len);
+            bench::do_not_optimize(sum);
+        }));
+
+        record(bench::run("literals", "from_chars", opt.min_seconds, opt.min_iters, [&] {
+            double sum = 0.0;
+            std::string_view view = source;
+            for (auto [start, len] : spans) sum += scan_number(view.substr(start, len)).value;
+            bench::do_not_optimize(sum);
+        }));
+
+        record(bench::run("literals", "lexer", opt.min_seconds, opt.min_iters, [&] {
+            Lexer lexer(source);
+            double sum = 0.0;
+            Token tok;
+            while ((tok = lexer.nextToken()).type != TokenType::END) sum += tok.number_value;
+            bench::do_not_optimize(sum);
+        }));
+    }
+
+    return bench::finish(opt, "lexer_bench", results);
+}